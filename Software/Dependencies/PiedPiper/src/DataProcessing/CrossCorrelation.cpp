@@ -17,34 +17,54 @@ CrossCorrelation::CrossCorrelation(uint16_t sampleRate, uint16_t windowSize) {
 void CrossCorrelation::computeTemplate() {
     this->templateSqrtSumSq = 0;
 
-    uint32_t _sumSq = 0;
+    uint64_t _sumSq = 0;
     uint16_t _templateValue = 0;
     uint16_t t, f;
 
-    // computing square root of the squared sum of the template spectrogram
+    // computing square root of the squared sum of the template spectrogram (64-bit sum, so squared magnitudes don't overflow)
     for (t = 0; t < numCols; t++) {
         for (f = this->frequencyIndexLow; f < this->frequencyIndexHigh; f++) {
             _templateValue = *(this->templatePtr + f + t * this->numRows);
-            _sumSq += _templateValue * _templateValue;
+            _sumSq += uint32_t(_templateValue) * _templateValue;
         }
     }
     this->templateSqrtSumSq = sqrtl(_sumSq);
 }
 
 
+void CrossCorrelation::computeFrequencyIndices(uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
+    this->frequencyIndexLow = floor(frequencyRangeLow * frequencyWidth);
+    this->frequencyIndexHigh = ceil(frequencyRangeHigh * frequencyWidth);
+}
+
+void CrossCorrelation::setFrequencyRange(uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
+    this->computeFrequencyIndices(frequencyRangeLow, frequencyRangeHigh);
+
+    if (this->templatePtr != NULL) this->computeTemplate();
+}
+
 void CrossCorrelation::setTemplate(uint16_t *input, uint16_t numRows, uint16_t numCols, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
     this->templatePtr = input;
     this->numRows = numRows;
     this->numCols = numCols;
 
-    this->frequencyIndexLow = floor(frequencyRangeLow * frequencyWidth);
-    this->frequencyIndexHigh = ceil(frequencyRangeHigh * frequencyWidth);
+    this->computeFrequencyIndices(frequencyRangeLow, frequencyRangeHigh);
 
     this->computeTemplate();
 }
 
+void CrossCorrelation::setTemplate(uint16_t *input, uint16_t numRows, uint16_t numCols, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh, uint32_t templateSqrtSumSq) {
+    this->templatePtr = input;
+    this->numRows = numRows;
+    this->numCols = numCols;
+
+    this->computeFrequencyIndices(frequencyRangeLow, frequencyRangeHigh);
+
+    this->templateSqrtSumSq = templateSqrtSumSq;
+}
+
 float CrossCorrelation::correlate(uint16_t *input, uint16_t inputLatestWindowIndex, uint16_t inputTotalWindows) {
-    uint32_t _inputSqrtSumSq = 0;
+    uint64_t _inputSqrtSumSq = 0;
     uint16_t _inputValue, _templateValue;
 
     // cross correlation introduces a delay depending on the length of template, to solve this...
@@ -65,7 +85,7 @@ float CrossCorrelation::correlate(uint16_t *input, uint16_t inputLatestWindowInd
 
         for (f = this->frequencyIndexLow; f < this->frequencyIndexHigh; f++) {
             _inputValue = *(input + f + _tempInputWindowIndex * this->numRows);
-            _inputSqrtSumSq += _inputValue * _inputValue;
+            _inputSqrtSumSq += uint32_t(_inputValue) * _inputValue;
         }
     }
 
@@ -88,9 +108,98 @@ float CrossCorrelation::correlate(uint16_t *input, uint16_t inputLatestWindowInd
         for (f = this->frequencyIndexLow; f < this->frequencyIndexHigh; f++) {
             _inputValue = *(input + f + _tempInputWindowIndex * this->numRows);
             _templateValue = *(this->templatePtr + f + t * this->numRows);
-            _correlationCoefficient += _inputValue * _templateValue * _inverseSqrtSumSq;
+            _correlationCoefficient += uint32_t(_inputValue) * _templateValue * _inverseSqrtSumSq;
         }
     }
 
     return _correlationCoefficient;
-}
\ No newline at end of file
+}
+
+float CrossCorrelation::correlate(const CircularBufferView<uint16_t> &input) {
+    uint64_t _inputSqrtSumSq = 0;
+    uint16_t _inputValue, _templateValue;
+
+    if (input.getNumCols() < this->numCols) return 0.0;
+
+    // cross correlation introduces a delay depending on the length of template, to solve this...
+    // correlate template with the last numCols columns of input
+    uint16_t _bandSize = this->frequencyIndexHigh - this->frequencyIndexLow;
+    const uint16_t *_input = input.getColumn(input.getNumCols() - this->numCols) + this->frequencyIndexLow;
+    const uint16_t *_template = this->templatePtr + this->frequencyIndexLow;
+
+    uint16_t t, f;
+
+    float _correlationCoefficient = 0.0;
+
+    // computing square root sum squared of input
+    for (t = 0; t < this->numCols; t++) {
+        for (f = 0; f < _bandSize; f++) {
+            _inputValue = _input[f + t * input.getNumRows()];
+            _inputSqrtSumSq += uint32_t(_inputValue) * _inputValue;
+        }
+    }
+
+    // computing product of square root of sum squared of template and input
+    _inputSqrtSumSq = sqrtl(_inputSqrtSumSq) * this->templateSqrtSumSq;
+    float _inverseSqrtSumSq = 1.0;
+    
+    // computing inverse of product (to reduce use of division)
+    if (_inputSqrtSumSq > 0) _inverseSqrtSumSq = 1.0 / _inputSqrtSumSq;
+    else return _correlationCoefficient;
+
+    // computing dot product and correlation coefficient
+    for (t = 0; t < this->numCols; t++) {
+        for (f = 0; f < _bandSize; f++) {
+            _inputValue = _input[f + t * input.getNumRows()];
+            _templateValue = _template[f + t * this->numRows];
+            _correlationCoefficient += uint32_t(_inputValue) * _templateValue * _inverseSqrtSumSq;
+        }
+    }
+
+    return _correlationCoefficient;
+}
+
+float CrossCorrelation::correlate(const CircularBufferView<uint8_t> &input, uint16_t inputFirstRow) {
+    uint64_t _inputSqrtSumSq = 0;
+    uint16_t _inputValue, _templateValue;
+
+    if (input.getNumCols() < this->numCols) return 0.0;
+    if (inputFirstRow > this->frequencyIndexLow || this->frequencyIndexHigh - inputFirstRow > input.getNumRows()) return 0.0;
+
+    // cross correlation introduces a delay depending on the length of template, to solve this...
+    // correlate template with the last numCols columns of input
+    uint16_t _bandSize = this->frequencyIndexHigh - this->frequencyIndexLow;
+    const uint8_t *_input = input.getColumn(input.getNumCols() - this->numCols) + (this->frequencyIndexLow - inputFirstRow);
+    const uint16_t *_template = this->templatePtr + this->frequencyIndexLow;
+
+    uint16_t t, f;
+
+    float _correlationCoefficient = 0.0;
+
+    // computing square root sum squared of input
+    for (t = 0; t < this->numCols; t++) {
+        for (f = 0; f < _bandSize; f++) {
+            _inputValue = LogDequantize(_input[f + t * input.getNumRows()]);
+            _inputSqrtSumSq += uint32_t(_inputValue) * _inputValue;
+        }
+    }
+
+    // computing product of square root of sum squared of template and input
+    _inputSqrtSumSq = sqrtl(_inputSqrtSumSq) * this->templateSqrtSumSq;
+    float _inverseSqrtSumSq = 1.0;
+    
+    // computing inverse of product (to reduce use of division)
+    if (_inputSqrtSumSq > 0) _inverseSqrtSumSq = 1.0 / _inputSqrtSumSq;
+    else return _correlationCoefficient;
+
+    // computing dot product and correlation coefficient
+    for (t = 0; t < this->numCols; t++) {
+        for (f = 0; f < _bandSize; f++) {
+            _inputValue = LogDequantize(_input[f + t * input.getNumRows()]);
+            _templateValue = _template[f + t * this->numRows];
+            _correlationCoefficient += uint32_t(_inputValue) * _templateValue * _inverseSqrtSumSq;
+        }
+    }
+
+    return _correlationCoefficient;
+}
@@ -14,8 +14,171 @@ void DCRemoval(complex *input, uint16_t windowSize) {
     }
 }
 
+void ComputeWindow(float *output, uint16_t windowSize, WINDOW_TYPE type) {
+    int i;
+    float _phase, _sum = 0;
+    for (i = 0; i < windowSize; i++) {
+        _phase = 2.0 * PI * i / windowSize;
+        switch (type) {
+            case WINDOW_TYPE::WINDOW_HANN:
+                output[i] = 0.5 - 0.5 * cos(_phase);
+                break;
+            case WINDOW_TYPE::WINDOW_BLACKMAN:
+                output[i] = 0.42 - 0.5 * cos(_phase) + 0.08 * cos(2.0 * _phase);
+                break;
+            default:
+                output[i] = 1.0;
+                break;
+        }
+        _sum += output[i];
+    }
+
+    // coherent gain compensation
+    float _gain = windowSize / _sum;
+    for (i = 0; i < windowSize; i++) {
+        output[i] *= _gain;
+    }
+}
+
+void DCRemovalWindow(const uint16_t *samples, complex *output, const float *window, uint16_t windowSize) {
+    int i;
+    // sum of ADC values is exact in integers, so mean is the same as the one computed by DCRemoval()
+    uint32_t _sum = 0;
+    for (i = 0; i < windowSize; i++) {
+        _sum += samples[i];
+    }
+
+    float _average = float(_sum) / windowSize;
+
+    if (window == NULL) {
+        for (i = 0; i < windowSize; i++) {
+            output[i] = float(samples[i]) - _average;
+        }
+    } else {
+        for (i = 0; i < windowSize; i++) {
+            output[i] = (float(samples[i]) - _average) * window[i];
+        }
+    }
+}
+
+void ApplyWindow(complex *input, const float *window, uint16_t windowSize) {
+    for (int i = 0; i < windowSize; i++) {
+        input[i] = input[i].re() * window[i];
+    }
+}
+
 void ComplexToMagnitude(complex *input, uint16_t windowSize) {
     for (int i = 0; i < windowSize; i++) {
         input[i] = sqrt(sq(input[i].re()) + sq(input[i].im()));
     }
-}
\ No newline at end of file
+}
+
+const float log2MantissaTable[(1 << LOG2_MANTISSA_TABLE_BITS) + 1] = {
+    0.0000000, 0.0223678, 0.0443941, 0.0660892, 0.0874628, 0.1085245, 0.1292830, 0.1497471,
+    0.1699250, 0.1898246, 0.2094534, 0.2288187, 0.2479275, 0.2667865, 0.2854022, 0.3037807,
+    0.3219281, 0.3398500, 0.3575520, 0.3750394, 0.3923174, 0.4093909, 0.4262648, 0.4429435,
+    0.4594316, 0.4757334, 0.4918531, 0.5077946, 0.5235620, 0.5391588, 0.5545889, 0.5698556,
+    0.5849625, 0.5999128, 0.6147098, 0.6293566, 0.6438562, 0.6582115, 0.6724253, 0.6865005,
+    0.7004397, 0.7142455, 0.7279205, 0.7414670, 0.7548875, 0.7681843, 0.7813597, 0.7944159,
+    0.8073549, 0.8201790, 0.8328900, 0.8454901, 0.8579810, 0.8703647, 0.8826430, 0.8948178,
+    0.9068906, 0.9188632, 0.9307373, 0.9425145, 0.9541963, 0.9657843, 0.9772799, 0.9886847,
+    1.0000000
+};
+
+/**
+ * log2 of a positive float from its exponent and log2MantissaTable
+ * @param value positive value
+ * @return log2(value)
+ */
+static inline float log2FromTable(float value) {
+    uint32_t _bits;
+    memcpy(&_bits, &value, sizeof(_bits));
+
+    // value = 2^exponent * (1 + mantissa / 2^23), table is indexed by the top mantissa bits, the remaining bits interpolate
+    int32_t _exponent = int32_t((_bits >> 23) & 0xFF) - 127;
+    uint32_t _index = (_bits >> (23 - LOG2_MANTISSA_TABLE_BITS)) & ((1 << LOG2_MANTISSA_TABLE_BITS) - 1);
+    float _fraction = float(_bits & ((1 << (23 - LOG2_MANTISSA_TABLE_BITS)) - 1)) * (1.0f / (1 << (23 - LOG2_MANTISSA_TABLE_BITS)));
+
+    return _exponent + log2MantissaTable[_index] + _fraction * (log2MantissaTable[_index + 1] - log2MantissaTable[_index]);
+}
+
+void ComplexToMagnitude(const complex *input, float *output, uint16_t windowSize, MAGNITUDE_MODE mode, float scale) {
+    float _re, _im, _sum, _difference, _power;
+    int i;
+
+    switch (mode) {
+        case MAGNITUDE_MODE::MAGNITUDE_ALPHA_MAX_BETA_MIN:
+            // alpha = 0.96043387 and beta = 0.39782473 minimize largest error (3.96%), max and min are replaced by
+            // (|re| + |im| +- ||re| - |im||) / 2, so there is no branch per bin
+            _sum = 0.67912930f * scale;
+            _difference = 0.28130457f * scale;
+            for (i = 0; i < windowSize; i++) {
+                _re = fabs(input[i].re());
+                _im = fabs(input[i].im());
+                output[i] = _sum * (_re + _im) + _difference * fabs(_re - _im);
+            }
+            break;
+        case MAGNITUDE_MODE::MAGNITUDE_POWER:
+            scale *= scale / MAGNITUDE_POWER_SCALE;
+            for (i = 0; i < windowSize; i++) {
+                output[i] = (sq(input[i].re()) + sq(input[i].im())) * scale;
+            }
+            break;
+        case MAGNITUDE_MODE::MAGNITUDE_LOG2:
+            // log2(magnitude) = log2(power) / 2, magnitudes below 1 are limited to 0
+            scale *= scale;
+            for (i = 0; i < windowSize; i++) {
+                _power = (sq(input[i].re()) + sq(input[i].im())) * scale;
+                output[i] = _power > 1.0f ? (LOG2_MAGNITUDE_SCALE / 2) * log2FromTable(_power) : 0.0f;
+            }
+            break;
+        default:
+            for (i = 0; i < windowSize; i++) {
+                _power = sqrt(sq(input[i].re()) + sq(input[i].im()));
+                output[i] = _power * scale;
+            }
+    }
+}
+
+float MagnitudeToMode(float magnitude, MAGNITUDE_MODE mode) {
+    switch (mode) {
+        case MAGNITUDE_MODE::MAGNITUDE_POWER:
+            return sq(magnitude) / MAGNITUDE_POWER_SCALE;
+        case MAGNITUDE_MODE::MAGNITUDE_LOG2:
+            return magnitude > 1.0f ? LOG2_MAGNITUDE_SCALE * log2(magnitude) : 0.0f;
+        default:
+            return magnitude;
+    }
+}
+
+const uint16_t logDequantizeTable[256] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62,
+    64, 68, 72, 76, 80, 84, 88, 92, 96, 100, 104, 108, 112, 116, 120, 124,
+    128, 136, 144, 152, 160, 168, 176, 184, 192, 200, 208, 216, 224, 232, 240, 248,
+    256, 272, 288, 304, 320, 336, 352, 368, 384, 400, 416, 432, 448, 464, 480, 496,
+    512, 544, 576, 608, 640, 672, 704, 736, 768, 800, 832, 864, 896, 928, 960, 992,
+    1024, 1088, 1152, 1216, 1280, 1344, 1408, 1472, 1536, 1600, 1664, 1728, 1792, 1856, 1920, 1984,
+    2048, 2176, 2304, 2432, 2560, 2688, 2816, 2944, 3072, 3200, 3328, 3456, 3584, 3712, 3840, 3968,
+    4096, 4352, 4608, 4864, 5120, 5376, 5632, 5888, 6144, 6400, 6656, 6912, 7168, 7424, 7680, 7936,
+    8192, 8704, 9216, 9728, 10240, 10752, 11264, 11776, 12288, 12800, 13312, 13824, 14336, 14848, 15360, 15872,
+    16384, 17408, 18432, 19456, 20480, 21504, 22528, 23552, 24576, 25600, 26624, 27648, 28672, 29696, 30720, 31744,
+    32768, 34816, 36864, 38912, 40960, 43008, 45056, 47104, 49152, 51200, 53248, 55296, 57344, 59392, 61440, 63488,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535
+};
+
+uint8_t LogQuantize(uint16_t value) {
+    if (value < 16) return value;
+
+    // exponent is found from position of most significant bit, the 4 bits below it are stored as mantissa
+    uint8_t _exponent = (31 - __builtin_clz(value)) - 3;
+    uint8_t _code = (_exponent << 4) | ((value >> (_exponent - 1)) & 0xF);
+
+    // rounding to nearest code
+    if (int32_t(logDequantizeTable[_code + 1]) - value < int32_t(value) - logDequantizeTable[_code]) _code += 1;
+
+    return _code;
+}
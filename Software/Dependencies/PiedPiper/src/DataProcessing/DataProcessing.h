@@ -10,6 +10,44 @@
  */
 void DCRemoval(complex *input, uint16_t windowSize);
 
+/**
+ * Window functions applied to time domain samples before FFT (see ComputeWindow())
+ */
+enum WINDOW_TYPE {
+    WINDOW_RECTANGULAR = 0,     ///< no window, narrowest main lobe but highest leakage into distant bins
+    WINDOW_HANN,                ///< 0.5 - 0.5 * cos(2 * PI * i / windowSize), sidelobes at -31 dB
+    WINDOW_BLACKMAN             ///< 0.42 - 0.5 * cos(2 * PI * i / windowSize) + 0.08 * cos(4 * PI * i / windowSize), sidelobes at -58 dB
+};
+
+/**
+ * computes coefficients of a window function (periodic form, as used for spectral analysis), so they are computed once instead of
+ * once per window. Coefficients are divided by their mean (coherent gain), so a tone centred on a bin has the same magnitude as
+ * without window
+ * @param output array for windowSize coefficients
+ * @param windowSize number of samples per window
+ * @param type WINDOW_TYPE
+ */
+void ComputeWindow(float *output, uint16_t windowSize, WINDOW_TYPE type);
+
+/**
+ * converts ADC values to complex values, removes their mean (like DCRemoval()) and applies a window, in a single pass over output.
+ * Output is the same as copying samples to output and calling DCRemoval() if window is NULL
+ * @param samples ADC values
+ * @param output a pointer to complex array for windowed samples
+ * @param window coefficients computed by ComputeWindow(), NULL for rectangular window
+ * @param windowSize length of samples, output and window arrays
+ */
+void DCRemovalWindow(const uint16_t *samples, complex *output, const float *window, uint16_t windowSize);
+
+/**
+ * applies a window to a time domain signal whose mean was already removed (i.e. after echo cancelling the output of
+ * DCRemovalWindow() without window)
+ * @param input a pointer to complex array
+ * @param window coefficients computed by ComputeWindow()
+ * @param windowSize length of input and window arrays
+ */
+void ApplyWindow(complex *input, const float *window, uint16_t windowSize);
+
 
 /**
  * converts an array of complex values to magnitudes
@@ -19,6 +57,64 @@ void DCRemoval(complex *input, uint16_t windowSize);
  */
 void ComplexToMagnitude(complex *input, uint16_t windowSize);
 
+/**
+ * Measures of magnitude computed by ComplexToMagnitude(const complex *, float *, ...), all stages after it work on the chosen measure
+ */
+enum MAGNITUDE_MODE {
+    MAGNITUDE_EXACT = 0,            ///< sqrt(re^2 + im^2)
+    MAGNITUDE_ALPHA_MAX_BETA_MIN,   ///< alpha * max(|re|, |im|) + beta * min(|re|, |im|), no sqrt, error within 4% of exact magnitude
+    MAGNITUDE_POWER,                ///< (re^2 + im^2) / MAGNITUDE_POWER_SCALE (squared magnitude), no sqrt
+    MAGNITUDE_LOG2                  ///< LOG2_MAGNITUDE_SCALE * log2(magnitude), limited to values >= 0, log2 is read from log2MantissaTable
+};
+
+#define MAGNITUDE_POWER_SCALE 64.0      ///< divisor of MAGNITUDE_POWER values, so squared magnitudes up to 2048 fit in uint16_t
+#define LOG2_MAGNITUDE_SCALE 256.0      ///< MAGNITUDE_LOG2 values per octave of magnitude
+#define LOG2_MANTISSA_TABLE_BITS 6      ///< number of mantissa bits indexing log2MantissaTable (values in between are interpolated)
+
+/**
+ * log2(1 + i / 2^LOG2_MANTISSA_TABLE_BITS) for i = 0 to 2^LOG2_MANTISSA_TABLE_BITS
+ */
+extern const float log2MantissaTable[(1 << LOG2_MANTISSA_TABLE_BITS) + 1];
+
+/**
+ * converts an array of complex values to a measure of magnitude (see MAGNITUDE_MODE), input is kept
+ * @param input a pointer to a complex array
+ * @param output a pointer to an array for the output data
+ * @param windowSize length of input and output arrays
+ * @param mode MAGNITUDE_MODE
+ * @param scale multiplier applied to magnitudes before conversion (i.e. FREQ_WIDTH), MAGNITUDE_EXACT output is the same as scaling output
+ *      of ComplexToMagnitude(complex *, uint16_t)
+ */
+void ComplexToMagnitude(const complex *input, float *output, uint16_t windowSize, MAGNITUDE_MODE mode, float scale = 1.0);
+
+/**
+ * converts an exact magnitude to the measure of a MAGNITUDE_MODE (i.e. values of a correlation template made from exact magnitudes)
+ * @param magnitude exact magnitude (scaled like input of ComplexToMagnitude())
+ * @param mode MAGNITUDE_MODE
+ * @return magnitude measured like ComplexToMagnitude() output of mode
+ */
+float MagnitudeToMode(float magnitude, MAGNITUDE_MODE mode);
+
+
+/**
+ * decoding table of LogQuantize(), code (4-bit exponent e, 4-bit mantissa m) decodes to m if e == 0, otherwise to (16 + m) << (e - 1)
+ */
+extern const uint16_t logDequantizeTable[256];
+
+/**
+ * quantizes a magnitude to an 8-bit code on a logarithmic scale (relative error below 1/32), values below 32 are stored exactly
+ * @param value magnitude to quantize
+ * @return 8-bit code of nearest representable magnitude
+ */
+uint8_t LogQuantize(uint16_t value);
+
+/**
+ * decodes a magnitude quantized by LogQuantize()
+ * @param code 8-bit code
+ * @return magnitude
+ */
+inline uint16_t LogDequantize(uint8_t code) { return logDequantizeTable[code]; }
+
 
 /**
  * smoothes a spectrogram by averaging through time
@@ -166,8 +262,157 @@ void NoiseRemoval_ATM(T *input, T *output, uint16_t numRows, uint16_t smoothingS
 };
 
 
+/**
+ * Method used by NoiseFloorTracker for estimating the noise floor of each frequency bin
+ */
+enum NOISE_FLOOR_MODE {
+    NOISE_FLOOR_EWMA = 0,   ///< exponentially weighted moving average of magnitudes
+    NOISE_FLOOR_MIN_STATS   ///< minimum of smoothed magnitudes over the last two sub-windows (minimum statistics)
+};
+
+/**
+ * class for tracking the noise floor of each frequency bin across windows and removing it by spectral subtraction. NoiseRemoval_ATM()
+ * and NoiseRemoval_CFAR() estimate noise from neighbouring bins of a single window, so persistent tonal noise (i.e. pumps, hum) which
+ * occupies the same bins in every window is kept, the noise floor tracker learns it over time instead. Each window takes O(numBins).
+ */
+class NoiseFloorTracker
+{
+    private:
+        NOISE_FLOOR_MODE mode;      ///< method used for estimating noise floor
+        float smoothing;            ///< weight of newest window in moving average (EWMA) or in smoothed magnitudes (MIN_STATS) (0, 1]
+        float overSubtraction;      ///< multiplier of noise floor subtracted from magnitudes
+        uint16_t subWindowLength;   ///< number of windows per sub-window searched for minimum (MIN_STATS)
+        bool adapting;              ///< false while noise floor is frozen
+
+        uint16_t numBins;           ///< number of frequency bins
+        float *noiseFloor;          ///< noise floor of each bin (numBins)
+        float *smoothed;            ///< smoothed magnitudes (numBins, MIN_STATS)
+        float *currentMinimum;      ///< minimum of smoothed magnitudes in current sub-window (numBins, MIN_STATS)
+        float *previousMinimum;     ///< minimum of smoothed magnitudes in previous sub-window (numBins, MIN_STATS)
+
+        uint16_t subWindowCount;    ///< number of windows in current sub-window
+        uint32_t windowCount;       ///< number of windows since reset
+
+        /**
+         * updates noise floor with magnitudes of a window
+         * @param input magnitudes (numBins)
+         */
+        void update(const float *input);
+
+    public:
+        /**
+         * constructor for NoiseFloorTracker
+         * @param mode NOISE_FLOOR_MODE
+         * @param smoothing weight of newest window (0, 1], smaller values track slower but are less affected by short sounds
+         * @param overSubtraction multiplier of noise floor subtracted from magnitudes (i.e. > 1 to remove fluctuations around noise floor)
+         * @param subWindowLength number of windows per sub-window (MIN_STATS), sounds longer than this are taken as noise
+         */
+        NoiseFloorTracker(NOISE_FLOOR_MODE mode, float smoothing, float overSubtraction, uint16_t subWindowLength);
+
+        /**
+         * get number of float elements needed by setBuffer()
+         * @param numBins number of frequency bins
+         * @return number of float elements
+         */
+        static uint32_t floatElementsRequired(uint16_t numBins) { return uint32_t(numBins) * 4; };
+
+        /**
+         * set buffer used by noise floor tracker, noise floor is reset
+         * @param buffer buffer of at least floatElementsRequired(numBins) elements
+         * @param numBins number of frequency bins
+         */
+        void setBuffer(float *buffer, uint16_t numBins);
+
+        /**
+         * clears noise floor, it is learned again from the next window
+         */
+        void reset(void);
+
+        /**
+         * freezes or resumes tracking, tracking should be frozen while other sounds are expected (i.e. during a positive correlation)
+         * @param enabled false to freeze noise floor
+         */
+        void setAdaptation(bool enabled);
+
+        /**
+         * updates noise floor with magnitudes of a window and subtracts it from them (spectral subtraction)
+         * @param input magnitudes of window (numBins)
+         * @param output magnitudes above noise floor (numBins), negative values are set to zero, may be the same array as input
+         */
+        void process(const float *input, float *output);
+
+        /**
+         * get noise floor of a frequency bin
+         * @param bin frequency bin
+         * @return noise floor, 0 if no window was processed
+         */
+        float getNoiseFloor(uint16_t bin);
+};
+
+
+/*
+ * templated class for a read only view of consecutive columns of a circular buffer, columns are stored contiguously (oldest first) so they
+ * can be read without wrapping indices
+ */
+template <typename T>
+class CircularBufferView
+{
+    private:
+        const T *dataPtr;       ///< pointer to first (oldest) column of view
+
+        uint16_t numRows;       ///< number of rows per column
+        uint16_t numCols;       ///< number of columns in view
+
+    public:
+
+        /**
+         * constructor for CircularBufferView
+         * @param dataPtr pointer to first (oldest) column, NULL for an empty view
+         * @param numRows number of rows per column
+         * @param numCols number of columns in view
+         */
+        CircularBufferView(const T *dataPtr, uint16_t numRows, uint16_t numCols) {
+            this->dataPtr = dataPtr;
+            this->numRows = numRows;
+            this->numCols = dataPtr == NULL ? 0 : numCols;
+        };
+
+        /**
+         * get number of rows per column
+         * @return number of rows
+         */
+        uint16_t getNumRows(void) const { return this->numRows; };
+
+        /**
+         * get number of columns in view
+         * @return number of columns, 0 if view is empty
+         */
+        uint16_t getNumCols(void) const { return this->numCols; };
+
+        /**
+         * get total number of values in view
+         * @return number of rows times number of columns
+         */
+        uint32_t getSize(void) const { return uint32_t(this->numRows) * this->numCols; };
+
+        /**
+         * get pointer to all values of view, column after column
+         * @return pointer to first (oldest) column
+         */
+        const T *getData(void) const { return this->dataPtr; };
+
+        /**
+         * get a column of view
+         * @param index index of column, 0 is the oldest column
+         * @return pointer to column
+         */
+        const T *getColumn(uint16_t index) const { return this->dataPtr + uint32_t(index) * this->numRows; };
+};
+
+
 /*
- * templated class for circular buffer
+ * templated class for circular buffer. In mirrored mode every column is written twice (at its index and numCols columns later), so any
+ * numCols consecutive columns are contiguous in memory and can be read through a CircularBufferView (see getLatest())
  */
 template <typename T>
 class CircularBuffer
@@ -180,6 +425,8 @@ class CircularBuffer
         uint16_t numRows;       ///< number of rows in buffer
         uint16_t numCols;       ///< number of columns in buffer
 
+        bool mirrored;          ///< true if columns are written twice (buffer holds 2 * numCols columns)
+
     public:
 
         /**
@@ -190,21 +437,42 @@ class CircularBuffer
             this->bufferIndex = 0;
             this->numRows = 0;
             this->numCols = 0;
+            this->mirrored = false;
+        };
+
+        /**
+         * get number of elements a buffer needs to hold for some number of rows and columns
+         * @param numRows number of rows in buffer
+         * @param numCols number of columns in buffer
+         * @param mirrored true if buffer is used in mirrored mode
+         * @return number of elements of type T
+         */
+        static uint32_t elementsRequired(uint16_t numRows, uint16_t numCols, bool mirrored = false) {
+            return uint32_t(numRows) * numCols * (mirrored ? 2 : 1);
         };
 
         /**
          * set some buffer/array to be used as a circular buffer
-         * @param bufferPtr pointer to buffer
+         * @param bufferPtr pointer to buffer of at least elementsRequired(numRows, numCols, mirrored) elements
          * @param numRows number of rows in buffer
          * @param numCols number of columns in buffer
+         * @param mirrored true if columns should be written twice, so getLatest() can return any number of columns
          */
-        void setBuffer(T *bufferPtr, uint16_t numRows, uint16_t numCols) {
+        void setBuffer(T *bufferPtr, uint16_t numRows, uint16_t numCols, bool mirrored = false) {
             this->bufferPtr = bufferPtr;
 
             this->numRows = numRows;
             this->numCols = numCols;
+
+            this->mirrored = mirrored;
         };
 
+        /**
+         * check if buffer is used in mirrored mode
+         * @return true if columns are written twice
+         */
+        bool isMirrored(void) const { return this->mirrored; };
+
         /**
          * get number of rows in buffer
          * @return number of rows
@@ -225,8 +493,16 @@ class CircularBuffer
             this->bufferIndex += 1;
             if (this->bufferIndex == this->numCols) this->bufferIndex = 0;
 
+            T *_column = this->bufferPtr + this->numRows * this->bufferIndex;
             for (int i = 0; i < this->numRows; i++) {
-                *(this->bufferPtr + i + this->numRows * this->bufferIndex) = data[i];
+                _column[i] = data[i];
+            }
+
+            if (!this->mirrored) return;
+
+            _column += uint32_t(this->numRows) * this->numCols;
+            for (int i = 0; i < this->numRows; i++) {
+                _column[i] = data[i];
             }
         };
         
@@ -258,11 +534,26 @@ class CircularBuffer
          */
         T *getBuffer(void) { return this->bufferPtr; };
 
+        /**
+         * get a contiguous view of the latest columns of circular buffer, ordered from oldest to current column
+         * @param numWindows number of columns in view (at most numCols)
+         * @return view of columns, empty if the columns wrap around the end of a buffer which is not mirrored
+         */
+        CircularBufferView<T> getLatest(uint16_t numWindows) const {
+            if (numWindows > this->numCols) return CircularBufferView<T>(NULL, this->numRows, 0);
+
+            // first column of view, columns past the end of buffer are read from the mirrored copy
+            uint16_t _index = (this->bufferIndex + this->numCols + 1 - numWindows) % this->numCols;
+            if (!this->mirrored && _index + numWindows > this->numCols) return CircularBufferView<T>(NULL, this->numRows, 0);
+
+            return CircularBufferView<T>(this->bufferPtr + uint32_t(_index) * this->numRows, this->numRows, numWindows);
+        };
+
         /**
          * zeroes out entire buffer
          */
         void clearBuffer(void) {
-            for (int t = 0; t < this->numCols; t++) {
+            for (int t = 0; t < this->numCols * (this->mirrored ? 2 : 1); t++) {
                 for (int f = 0; f < this->numRows; f++) {
                     *(this->bufferPtr + f + t * this->numRows) = 0;
                 }
@@ -272,6 +563,148 @@ class CircularBuffer
 
 };
 
+/*
+ * circular buffer for 12-bit samples (i.e. raw ADC samples), two samples are packed in three bytes so a column of numRows samples takes
+ * numRows * 3 / 2 bytes instead of numRows * 2 bytes. Columns are unpacked when read.
+ */
+class PackedCircularBuffer
+{
+    private:
+        uint8_t *bufferPtr;     ///< pointer to some buffer of at least bytesRequired(numRows, numCols) bytes
+
+        uint16_t bufferIndex;   ///< current index in buffer
+
+        uint16_t numRows;       ///< number of samples per column (must be even)
+        uint16_t numCols;       ///< number of columns in buffer
+
+        uint16_t columnSize;    ///< size of a packed column in bytes
+
+    public:
+
+        /**
+         * constructor for PackedCircularBuffer
+         */
+        PackedCircularBuffer(void) {
+            this->bufferPtr = NULL;
+            this->bufferIndex = 0;
+            this->numRows = 0;
+            this->numCols = 0;
+            this->columnSize = 0;
+        };
+
+        /**
+         * get size of buffer needed for storing some number of packed samples
+         * @param numRows number of samples per column (must be even)
+         * @param numCols number of columns
+         * @return size of buffer in bytes
+         */
+        static uint32_t bytesRequired(uint16_t numRows, uint16_t numCols) { return uint32_t(numRows) * numCols * 3 / 2; };
+
+        /**
+         * packs two 12-bit samples in three bytes, samples above 12 bits are limited to 0xFFF
+         * @param packed pointer to three bytes
+         * @param a first sample
+         * @param b second sample
+         */
+        static void pack(uint8_t *packed, uint16_t a, uint16_t b) {
+            a = a > 0xFFF ? 0xFFF : a;
+            b = b > 0xFFF ? 0xFFF : b;
+            packed[0] = a & 0xFF;
+            packed[1] = (a >> 8) | ((b & 0xF) << 4);
+            packed[2] = b >> 4;
+        };
+
+        /**
+         * unpacks two 12-bit samples from three bytes
+         * @param packed pointer to three bytes
+         * @param a reference for first sample
+         * @param b reference for second sample
+         */
+        static void unpack(const uint8_t *packed, uint16_t &a, uint16_t &b) {
+            a = packed[0] | ((packed[1] & 0xF) << 8);
+            b = (packed[1] >> 4) | (packed[2] << 4);
+        };
+
+        /**
+         * set some buffer/array to be used as a packed circular buffer
+         * @param bufferPtr pointer to buffer of at least bytesRequired(numRows, numCols) bytes
+         * @param numRows number of samples per column (must be even)
+         * @param numCols number of columns in buffer
+         */
+        void setBuffer(uint8_t *bufferPtr, uint16_t numRows, uint16_t numCols) {
+            this->bufferPtr = bufferPtr;
+
+            this->numRows = numRows;
+            this->numCols = numCols;
+            this->columnSize = numRows * 3 / 2;
+        };
+
+        /**
+         * get number of rows in buffer
+         * @return number of rows
+         */
+        uint16_t getNumRows(void) const { return this->numRows; };
+
+        /**
+         * get number of columns in buffer
+         * @return number of columns
+         */
+        uint16_t getNumCols(void) const { return this->numCols; };
+
+        /**
+         * packs and pushes a column of samples to circular buffer
+         * @param data numRows samples to push onto buffer
+         */
+        void pushData(const uint16_t *data) {
+            this->bufferIndex += 1;
+            if (this->bufferIndex == this->numCols) this->bufferIndex = 0;
+
+            uint8_t *_packed = this->bufferPtr + this->columnSize * this->bufferIndex;
+            for (int i = 0; i < this->numRows; i += 2, _packed += 3) {
+                pack(_packed, data[i], data[i + 1]);
+            }
+        };
+
+        /**
+         * get the current column in circular buffer
+         * @return current column in circular buffer
+         */
+        uint16_t getCurrentIndex(void) const { return this->bufferIndex; };
+
+        /**
+         * get packed data at some index relative to the current index of circular buffer, see unpack()
+         * @param relativeIndex a positive or negative value
+         * @return pointer to packed column (numRows * 3 / 2 bytes)
+         */
+        const uint8_t *getPackedData(int relativeIndex) const {
+            uint16_t _index = (this->bufferIndex + this->numCols + relativeIndex) % this->numCols;
+            return this->bufferPtr + _index * this->columnSize;
+        };
+
+        /**
+         * unpacks column at some index relative to the current index of circular buffer
+         * @param relativeIndex a positive or negative value
+         * @param output array of at least numRows values for storing unpacked samples
+         */
+        void getData(int relativeIndex, uint16_t *output) const {
+            const uint8_t *_packed = this->getPackedData(relativeIndex);
+            for (int i = 0; i < this->numRows; i += 2, _packed += 3) {
+                unpack(_packed, output[i], output[i + 1]);
+            }
+        };
+
+        /**
+         * zeroes out entire buffer
+         */
+        void clearBuffer(void) {
+            for (uint32_t i = 0; i < uint32_t(this->columnSize) * this->numCols; i++) {
+                this->bufferPtr[i] = 0;
+            }
+            this->bufferIndex = 0;
+        };
+
+};
+
 /*
  * class for computing correlation coefficient between two signals
  */
@@ -295,6 +728,13 @@ class CrossCorrelation
          * preliminary computations of template data for correlation
          */
         void computeTemplate(void);
+
+        /**
+         * computes bin indices of frequency range used for correlation
+         * @param frequencyRangeLow start frequency for correlation
+         * @param frequencyRangeHigh end frequency for correlation
+         */
+        void computeFrequencyIndices(uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
     
     public:
         /**
@@ -304,6 +744,15 @@ class CrossCorrelation
          */
         CrossCorrelation(uint16_t sampleRate, uint16_t windowSize);
 
+        /**
+         * set frequency range used for correlation (also set by setTemplate()), so users of correlation input can store only the bins
+         * between getFrequencyIndexLow() and getFrequencyIndexHigh() before a template is loaded. A template which is already set is
+         * recomputed
+         * @param frequencyRangeLow start frequency for correlation
+         * @param frequencyRangeHigh end frequency for correlation
+         */
+        void setFrequencyRange(uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
+
         /**
          * set some buffer as template for cross correlation
          * @param input a pointer to some buffer containing template data
@@ -314,6 +763,47 @@ class CrossCorrelation
          */
         void setTemplate(uint16_t *input, uint16_t numRows, uint16_t numCols, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
 
+        /**
+         * set some buffer as template for cross correlation without recomputing the template, used for templates loaded from a binary template file
+         * @param input a pointer to some buffer containing template data
+         * @param numRows number of rows in data
+         * @param numCols number of columns in data
+         * @param frequencyRangeLow start frequency for correlation
+         * @param frequencyRangeHigh end frequency for correlation
+         * @param templateSqrtSumSq precomputed square root of the sum squared of template data
+         */
+        void setTemplate(uint16_t *input, uint16_t numRows, uint16_t numCols, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh, uint32_t templateSqrtSumSq);
+
+        /**
+         * get the square root of the sum squared of the current template
+         * @return square root of the sum squared of template
+         */
+        uint32_t getTemplateSqrtSumSq(void) const { return this->templateSqrtSumSq; };
+
+        /**
+         * get the sample rate of template
+         * @return sample rate
+         */
+        uint16_t getSampleRate(void) const { return this->sampleRate; };
+
+        /**
+         * get the window size of template
+         * @return window size
+         */
+        uint16_t getWindowSize(void) const { return this->windowSize; };
+
+        /**
+         * get index of first frequency bin used for correlation
+         * @return bin index corresponding to lowest frequency
+         */
+        uint16_t getFrequencyIndexLow(void) const { return this->frequencyIndexLow; };
+
+        /**
+         * get index after last frequency bin used for correlation
+         * @return bin index corresponding to highest frequency
+         */
+        uint16_t getFrequencyIndexHigh(void) const { return this->frequencyIndexHigh; };
+
         /**
          * computes correlation coefficient between template and input signal
          * @param input a pointer to buffer containing data
@@ -321,6 +811,116 @@ class CrossCorrelation
          * @param inputTotalWindows total columns in input signal
          */
         float correlate(uint16_t *input, uint16_t inputLatestWindowIndex, uint16_t inputTotalWindows);
+
+        /**
+         * computes correlation coefficient between template and the latest columns of an input signal
+         * @param input contiguous view of input data (see CircularBuffer::getLatest()), the last numCols columns are correlated
+         * @return correlation coefficient, 0 if input has less columns than template
+         */
+        float correlate(const CircularBufferView<uint16_t> &input);
+
+        /**
+         * computes correlation coefficient between template and the latest columns of an input signal quantized with LogQuantize(). The
+         * input may only store some of the frequency bins (i.e. only the bins used for correlation, getFrequencyIndexLow() to getFrequencyIndexHigh())
+         * @param input contiguous view of quantized input data (see CircularBuffer::getLatest()), the last numCols columns are correlated
+         * @param inputFirstRow frequency bin index of first row stored in input
+         * @return correlation coefficient, 0 if input has less columns than template or does not store all bins used for correlation
+         */
+        float correlate(const CircularBufferView<uint8_t> &input, uint16_t inputFirstRow);
+};
+
+/**
+ * class for removing a known playback signal (echo) from audio input, so the detection loop can keep running while a sound is played.
+ * An adaptive filter (normalized LMS in the frequency domain, constrained overlap-save) models the path from playback signal (reference)
+ * to audio input, the filtered reference is subtracted from input. Input and reference are processed in blocks of blockSize samples,
+ * the filter has blockSize taps (i.e. FFT_WINDOW_SIZE taps model an echo path of one window), each block takes 5 FFTs of 2 * blockSize.
+ */
+class EchoCanceller
+{
+    private:
+        uint16_t blockSize;         ///< number of samples per block (power of 2)
+        uint16_t fftSize;           ///< 2 * blockSize
+
+        complex *weights;           ///< frequency domain filter (fftSize)
+        complex *seedWeights;       ///< frequency domain filter restored by reset() (fftSize)
+        complex *referenceSpectrum; ///< spectrum of previous and current reference block (fftSize)
+        complex *scratch;           ///< scratch pad (fftSize)
+        float *previousReference;   ///< previous reference block (blockSize)
+        float *referencePower;      ///< smoothed power of reference per bin (fftSize)
+
+        float stepSize;             ///< normalized step size of adaptation (0, 1]
+        float powerSmoothing;       ///< smoothing factor of reference power (0, 1]
+        bool adapting;              ///< false while adaptation is frozen
+
+        float inputEnergy;          ///< energy of input since last reset
+        float outputEnergy;         ///< energy of input after echo removal since last reset
+
+    public:
+        /**
+         * constructor for EchoCanceller
+         * @param stepSize normalized step size of adaptation (0, 1], larger values converge faster but are more sensitive to other sounds
+         * @param powerSmoothing smoothing factor of reference power used for normalizing step size (0, 1]
+         */
+        EchoCanceller(float stepSize, float powerSmoothing);
+
+        /**
+         * get number of complex elements needed by setBuffers()
+         * @param blockSize number of samples per block
+         * @return number of complex elements
+         */
+        static uint32_t complexElementsRequired(uint16_t blockSize) { return uint32_t(blockSize) * 8; };
+
+        /**
+         * get number of float elements needed by setBuffers()
+         * @param blockSize number of samples per block
+         * @return number of float elements
+         */
+        static uint32_t floatElementsRequired(uint16_t blockSize) { return uint32_t(blockSize) * 3; };
+
+        /**
+         * set buffers used by echo canceller, filter is reset to zero
+         * @param complexBuffer buffer of at least complexElementsRequired(blockSize) elements
+         * @param floatBuffer buffer of at least floatElementsRequired(blockSize) elements
+         * @param blockSize number of samples per block (power of 2)
+         */
+        void setBuffers(complex *complexBuffer, float *floatBuffer, uint16_t blockSize);
+
+        /**
+         * sets initial filter from a measured impulse response of the echo path (i.e. from impulse response calibration), adaptation starts
+         * from this filter instead of zero and after every reset()
+         * @param impulseResponse echo path response to a unit impulse of reference, at sample rate of blocks
+         * @param length number of values of impulseResponse (at most blockSize are used)
+         */
+        void setEchoPath(const float *impulseResponse, uint16_t length);
+
+        /**
+         * resets filter to echo path set by setEchoPath() (or zero) and clears reference history and statistics
+         */
+        void reset(void);
+
+        /**
+         * freezes or resumes adaptation, adaptation should be frozen while other sounds are expected (i.e. during a positive correlation)
+         * @param enabled false to freeze filter
+         */
+        void setAdaptation(bool enabled);
+
+        /**
+         * removes echo of a block of reference from a block of input and adapts filter
+         * @param reference block of reference signal (blockSize samples, without DC offset)
+         * @param input block of input signal (real part of blockSize complex values), echo is subtracted in place
+         */
+        void process(const int16_t *reference, complex *input);
+
+        /**
+         * get echo return loss enhancement (ratio of input energy to energy after echo removal) since last reset or resetStats()
+         * @return echo return loss enhancement in dB, 0 if no block was processed
+         */
+        float getAttenuation(void);
+
+        /**
+         * clears statistics used by getAttenuation() without resetting filter
+         */
+        void resetStats(void);
 };
 
 #endif
\ No newline at end of file
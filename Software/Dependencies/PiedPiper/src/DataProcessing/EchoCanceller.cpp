@@ -0,0 +1,142 @@
+#include "DataProcessing.h"
+
+EchoCanceller::EchoCanceller(float stepSize, float powerSmoothing) {
+    this->blockSize = 0;
+    this->fftSize = 0;
+
+    this->weights = NULL;
+    this->seedWeights = NULL;
+    this->referenceSpectrum = NULL;
+    this->scratch = NULL;
+    this->previousReference = NULL;
+    this->referencePower = NULL;
+
+    this->stepSize = stepSize;
+    this->powerSmoothing = powerSmoothing;
+    this->adapting = true;
+
+    this->inputEnergy = 0;
+    this->outputEnergy = 0;
+}
+
+void EchoCanceller::setBuffers(complex *complexBuffer, float *floatBuffer, uint16_t blockSize) {
+    this->blockSize = blockSize;
+    this->fftSize = blockSize * 2;
+
+    this->weights = complexBuffer;
+    this->seedWeights = complexBuffer + this->fftSize;
+    this->referenceSpectrum = complexBuffer + this->fftSize * 2;
+    this->scratch = complexBuffer + this->fftSize * 3;
+    this->previousReference = floatBuffer;
+    this->referencePower = floatBuffer + this->blockSize;
+
+    for (uint16_t i = 0; i < this->fftSize; i++) {
+        this->seedWeights[i] = 0.0;
+    }
+
+    this->reset();
+}
+
+void EchoCanceller::setEchoPath(const float *impulseResponse, uint16_t length) {
+    if (this->seedWeights == NULL) return;
+
+    // filter taps are stored in first half of FFT input, second half is zero (overlap-save)
+    for (uint16_t i = 0; i < this->fftSize; i++) {
+        this->seedWeights[i] = (i < this->blockSize && i < length) ? impulseResponse[i] : 0.0;
+    }
+    Fast4::FFT(this->seedWeights, this->fftSize);
+
+    this->reset();
+}
+
+void EchoCanceller::reset() {
+    if (this->weights == NULL) return;
+
+    for (uint16_t i = 0; i < this->fftSize; i++) {
+        this->weights[i] = this->seedWeights[i];
+        this->referencePower[i] = 0;
+    }
+    for (uint16_t i = 0; i < this->blockSize; i++) {
+        this->previousReference[i] = 0;
+    }
+
+    this->resetStats();
+}
+
+void EchoCanceller::setAdaptation(bool enabled) {
+    this->adapting = enabled;
+}
+
+void EchoCanceller::process(const int16_t *reference, complex *input) {
+    if (this->weights == NULL) return;
+
+    uint16_t i;
+
+    // spectrum of previous and current reference block
+    for (i = 0; i < this->blockSize; i++) {
+        this->referenceSpectrum[i] = this->previousReference[i];
+        this->referenceSpectrum[i + this->blockSize] = float(reference[i]);
+        this->previousReference[i] = reference[i];
+    }
+    Fast4::FFT(this->referenceSpectrum, this->fftSize);
+
+    float _meanPower = 0;
+    for (i = 0; i < this->fftSize; i++) {
+        this->referencePower[i] += this->powerSmoothing * (this->referenceSpectrum[i].norm() - this->referencePower[i]);
+        _meanPower += this->referencePower[i];
+    }
+    _meanPower /= this->fftSize;
+
+    // echo estimate is the second half of the filtered reference (first half is circular wrap around)
+    for (i = 0; i < this->fftSize; i++) {
+        this->scratch[i] = this->weights[i] * this->referenceSpectrum[i];
+    }
+    Fast4::IFFT(this->scratch, this->fftSize);
+
+    float _error;
+    for (i = 0; i < this->blockSize; i++) {
+        _error = input[i].re() - this->scratch[i + this->blockSize].re();
+        this->inputEnergy += input[i].re() * input[i].re();
+        this->outputEnergy += _error * _error;
+        input[i] = _error;
+    }
+
+    // no adaptation without reference
+    if (!this->adapting || _meanPower <= 0) return;
+
+    for (i = 0; i < this->blockSize; i++) {
+        this->scratch[i] = 0.0;
+        this->scratch[i + this->blockSize] = input[i];
+    }
+    Fast4::FFT(this->scratch, this->fftSize);
+
+    // step size is normalized per bin by the larger of smoothed and current reference power, regularization keeps bins with little
+    // reference power (in between tones of playback sound) from diverging
+    float _regularization = 0.5 * _meanPower;
+    float _power;
+    for (i = 0; i < this->fftSize; i++) {
+        _power = max(this->referencePower[i], this->referenceSpectrum[i].norm());
+        this->scratch[i] = this->referenceSpectrum[i].conjugate() * this->scratch[i] * (this->stepSize / (_power + _regularization));
+    }
+
+    // gradient constraint, taps past blockSize would model circular (not linear) convolution
+    Fast4::IFFT(this->scratch, this->fftSize);
+    for (i = this->blockSize; i < this->fftSize; i++) {
+        this->scratch[i] = 0.0;
+    }
+    Fast4::FFT(this->scratch, this->fftSize);
+
+    for (i = 0; i < this->fftSize; i++) {
+        this->weights[i] += this->scratch[i];
+    }
+}
+
+float EchoCanceller::getAttenuation() {
+    if (this->inputEnergy <= 0 || this->outputEnergy <= 0) return 0;
+    return 10.0 * log10(this->inputEnergy / this->outputEnergy);
+}
+
+void EchoCanceller::resetStats() {
+    this->inputEnergy = 0;
+    this->outputEnergy = 0;
+}
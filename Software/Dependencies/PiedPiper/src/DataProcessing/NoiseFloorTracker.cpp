@@ -0,0 +1,96 @@
+#include "DataProcessing.h"
+
+NoiseFloorTracker::NoiseFloorTracker(NOISE_FLOOR_MODE mode, float smoothing, float overSubtraction, uint16_t subWindowLength) {
+    this->mode = mode;
+    this->smoothing = smoothing;
+    this->overSubtraction = overSubtraction;
+    this->subWindowLength = max(uint16_t(1), subWindowLength);
+    this->adapting = true;
+
+    this->numBins = 0;
+    this->noiseFloor = NULL;
+    this->smoothed = NULL;
+    this->currentMinimum = NULL;
+    this->previousMinimum = NULL;
+
+    this->subWindowCount = 0;
+    this->windowCount = 0;
+}
+
+void NoiseFloorTracker::setBuffer(float *buffer, uint16_t numBins) {
+    this->numBins = numBins;
+
+    this->noiseFloor = buffer;
+    this->smoothed = buffer + numBins;
+    this->currentMinimum = buffer + numBins * 2;
+    this->previousMinimum = buffer + numBins * 3;
+
+    this->reset();
+}
+
+void NoiseFloorTracker::reset() {
+    for (uint16_t i = 0; i < this->numBins; i++) {
+        this->noiseFloor[i] = 0;
+    }
+    this->subWindowCount = 0;
+    this->windowCount = 0;
+}
+
+void NoiseFloorTracker::setAdaptation(bool enabled) {
+    this->adapting = enabled;
+}
+
+void NoiseFloorTracker::update(const float *input) {
+    uint16_t i;
+
+    // noise floor starts from first window
+    if (this->windowCount == 0) {
+        for (i = 0; i < this->numBins; i++) {
+            this->noiseFloor[i] = input[i];
+            this->smoothed[i] = input[i];
+            this->currentMinimum[i] = input[i];
+            this->previousMinimum[i] = input[i];
+        }
+        this->subWindowCount = 1;
+        this->windowCount = 1;
+        return;
+    }
+
+    if (this->mode == NOISE_FLOOR_MODE::NOISE_FLOOR_EWMA) {
+        for (i = 0; i < this->numBins; i++) {
+            this->noiseFloor[i] += this->smoothing * (input[i] - this->noiseFloor[i]);
+        }
+    } else {
+        // minimum of two sub-windows is used, so noise floor never depends on a sub-window which just started
+        for (i = 0; i < this->numBins; i++) {
+            this->smoothed[i] += this->smoothing * (input[i] - this->smoothed[i]);
+            if (this->smoothed[i] < this->currentMinimum[i]) this->currentMinimum[i] = this->smoothed[i];
+            this->noiseFloor[i] = min(this->currentMinimum[i], this->previousMinimum[i]);
+        }
+
+        if (++this->subWindowCount >= this->subWindowLength) {
+            for (i = 0; i < this->numBins; i++) {
+                this->previousMinimum[i] = this->currentMinimum[i];
+                this->currentMinimum[i] = this->smoothed[i];
+            }
+            this->subWindowCount = 0;
+        }
+    }
+
+    this->windowCount += 1;
+}
+
+void NoiseFloorTracker::process(const float *input, float *output) {
+    if (this->noiseFloor == NULL) return;
+
+    if (this->adapting || this->windowCount == 0) this->update(input);
+
+    for (uint16_t i = 0; i < this->numBins; i++) {
+        output[i] = max(0.0f, input[i] - this->overSubtraction * this->noiseFloor[i]);
+    }
+}
+
+float NoiseFloorTracker::getNoiseFloor(uint16_t bin) {
+    if (bin >= this->numBins) return 0;
+    return this->noiseFloor[bin];
+}
@@ -0,0 +1,168 @@
+#ifndef RESAMPLER_h
+#define RESAMPLER_h
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "SincFilter.h"
+
+// Stateful block resampling with windowed sinc tables (see SincFilter.h), used for audio input and output of the trap as well as by host
+// utilities replaying or converting recordings, so every path resamples exactly like the trap does.
+// Note: this header is shared with host utilities, do not include Arduino headers here
+
+/**
+ * Direction of resampling done by Resampler
+ */
+enum RESAMPLER_MODE {
+    RESAMPLER_DOWNSAMPLE = 0,   ///< low pass filter and keep every ratio-th sample, filter is a sinc table (i.e. SincFilterTable::values)
+    RESAMPLER_UPSAMPLE          ///< zero pad and low pass filter, filter is a polyphase sinc table (i.e. SincPolyphaseTable::values)
+};
+
+/**
+ * templated class for resampling blocks of samples by an integer ratio. Filter input is kept in a linear buffer (history of numTaps - 1
+ * samples followed by room for new samples), so each output sample is a dot product over contiguous memory, the history is only moved to
+ * the front of the buffer once it is full. Blocks may have any length, state carries over between calls of process()
+ */
+template <typename T>
+class Resampler
+{
+    private:
+        RESAMPLER_MODE mode;    ///< direction of resampling
+        const float *filter;    ///< sinc table (downsampling) or polyphase sinc table (upsampling)
+        uint16_t numTaps;       ///< number of input samples used per output sample
+        uint8_t ratio;          ///< resampling ratio
+
+        T *buffer;              ///< filter input, oldest sample first
+        uint16_t bufferSize;    ///< number of samples which fit in buffer
+        uint16_t bufferIdx;     ///< index of next sample written to buffer
+        uint8_t phase;          ///< number of input samples since last output sample (downsampling)
+
+        T minValue;             ///< output samples are limited to [minValue, maxValue]
+        T maxValue;
+
+        /**
+         * rounds and limits a filtered value
+         * @param value filtered value
+         * @return output sample
+         */
+        T toSample(float value) {
+            int32_t _value = int32_t(round(value));
+            if (_value < int32_t(this->minValue)) return this->minValue;
+            if (_value > int32_t(this->maxValue)) return this->maxValue;
+            return T(_value);
+        };
+
+        /**
+         * appends a sample to buffer, moving history to the front of buffer once it is full
+         * @param sample input sample
+         */
+        void push(T sample) {
+            if (this->bufferIdx >= this->bufferSize) {
+                memmove(this->buffer, this->buffer + this->bufferSize - (this->numTaps - 1), (this->numTaps - 1) * sizeof(T));
+                this->bufferIdx = this->numTaps - 1;
+            }
+            this->buffer[this->bufferIdx++] = sample;
+        };
+
+    public:
+
+        /**
+         * constructor for Resampler
+         * @param mode RESAMPLER_MODE
+         * @param filter sinc table of numTaps values (downsampling) or polyphase sinc table of ratio * numTaps values (upsampling)
+         * @param numTaps number of input samples used per output sample, SIZE of SincFilterTable or NUM_TAPS of SincPolyphaseTable
+         * @param ratio resampling ratio
+         * @param buffer filter input, more than numTaps samples (numTaps - 1 + block size avoids moving history more than once per block)
+         * @param bufferSize number of samples which fit in buffer
+         * @param minValue smallest output sample
+         * @param maxValue largest output sample
+         */
+        Resampler(RESAMPLER_MODE mode, const float *filter, uint16_t numTaps, uint8_t ratio, T *buffer, uint16_t bufferSize, T minValue, T maxValue) {
+            this->mode = mode;
+            this->filter = filter;
+            this->numTaps = numTaps;
+            this->ratio = ratio;
+            this->buffer = buffer;
+            this->bufferSize = bufferSize;
+            this->minValue = minValue;
+            this->maxValue = maxValue;
+
+            this->reset(0);
+        };
+
+        /**
+         * clears filter input
+         * @param value value of all samples before the first input sample (i.e. ADC_MID)
+         */
+        void reset(T value) {
+            for (uint16_t i = 0; i < this->numTaps - 1; i++) {
+                this->buffer[i] = value;
+            }
+            this->bufferIdx = this->numTaps - 1;
+            this->phase = 0;
+        };
+
+        /**
+         * resamples a block of samples
+         * @param input input samples
+         * @param count number of input samples
+         * @param output output samples, count / ratio (downsampling) or count * ratio (upsampling) samples are produced
+         * @param space number of samples which fit in output, samples past it are discarded (input is still kept as filter history)
+         * @return number of samples written to output
+         */
+        uint16_t process(const T *input, uint16_t count, T *output, uint16_t space) {
+            uint16_t _outputCount = 0;
+            const T *_input;
+            float _filteredValue;
+            uint16_t i, j;
+            uint8_t _phase;
+
+            for (i = 0; i < count; i++) {
+                this->push(input[i]);
+
+                if (this->mode == RESAMPLER_MODE::RESAMPLER_DOWNSAMPLE) {
+                    if (++this->phase < this->ratio) continue;
+                    this->phase = 0;
+                    if (_outputCount >= space) continue;
+
+                    // numTaps samples up to the newest, the newest is weighted by the first value of the table (zero for Hann windowed
+                    // tables) and the others (oldest first) by the rest of the table
+                    _input = this->buffer + this->bufferIdx - this->numTaps;
+                    _filteredValue = _input[this->numTaps - 1] * this->filter[0];
+                    for (j = 1; j < this->numTaps; j++) {
+                        _filteredValue += _input[j - 1] * this->filter[j];
+                    }
+                    output[_outputCount++] = this->toSample(_filteredValue);
+                } else {
+                    // phase selects which taps of sinc function line up with input samples, zero padded samples are skipped
+                    _input = this->buffer + this->bufferIdx - 1;
+                    for (_phase = 0; _phase < this->ratio && _outputCount < space; _phase++) {
+                        const float *_phaseTable = this->filter + _phase * this->numTaps;
+
+                        // convolute filter input (newest to oldest) with sinc function
+                        _filteredValue = 0.0;
+                        for (j = 0; j < this->numTaps; j++) {
+                            _filteredValue += *(_input - j) * _phaseTable[j];
+                        }
+                        output[_outputCount++] = this->toSample(_filteredValue);
+                    }
+                }
+            }
+
+            return _outputCount;
+        };
+
+        /**
+         * get newest input sample
+         * @return last sample passed to process()
+         */
+        T getNewest(void) const { return this->buffer[this->bufferIdx - 1]; };
+
+        /**
+         * get resampling ratio
+         * @return ratio
+         */
+        uint8_t getRatio(void) const { return this->ratio; };
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef SINC_FILTER_h
+#define SINC_FILTER_h
+
+#include <stdint.h>
+
+// Windowed sinc tables used for band limited resampling of audio input and output. Tables only depend on the resampling ratio and the
+// number of zero crossings, so they are generated by the compiler (C++11 constexpr) and placed in flash.
+// Note: this header is shared with host utilities, do not include Arduino headers here
+
+/**
+ * pi used for generating sinc tables, PI from Arduino.h is not available on host
+ */
+constexpr double SINC_PI = 3.14159265358979323846;
+
+/**
+ * wraps an angle to [-pi, pi]
+ * @param x angle in radians
+ * @return wrapped angle
+ */
+constexpr double sincWrapAngle(double x) {
+    return x > SINC_PI ? sincWrapAngle(x - 2.0 * SINC_PI) : (x < -SINC_PI ? sincWrapAngle(x + 2.0 * SINC_PI) : x);
+}
+
+/**
+ * Taylor series of sine, accurate to double precision for x in [-pi, pi]
+ * @param x angle in radians
+ * @param term current term of series
+ * @param n power of current term
+ * @param sum sum of previous terms
+ * @return sine of x
+ */
+constexpr double sincSineSeries(double x, double term, uint8_t n, double sum) {
+    return n > 33 ? sum : sincSineSeries(x, -term * x * x / ((n + 1) * (n + 2)), n + 2, sum + term);
+}
+
+/**
+ * constexpr sine, std::sin() can't be used in constant expressions
+ * @param x angle in radians
+ * @return sine of x
+ */
+constexpr double sincSine(double x) {
+    return sincSineSeries(sincWrapAngle(x), sincWrapAngle(x), 1, 0.0);
+}
+
+/**
+ * constexpr cosine
+ * @param x angle in radians
+ * @return cosine of x
+ */
+constexpr double sincCosine(double x) {
+    return sincSine(x + 0.5 * SINC_PI);
+}
+
+/**
+ * computes a single value of a sinc function windowed with a cosine (Hann) window, with zero crossings every ratio samples.
+ * @param ratio resampling ratio
+ * @param zeroX number of zero crossings on each side of the center of the table
+ * @param gainDivisor divides all values, ratio for downsampling (low pass filter with unity gain), 1 for upsampling (zero padded input)
+ * @param i index of value [0, 2 * zeroX * ratio]
+ * @return value of windowed sinc function
+ */
+constexpr double sincFilterValue(uint8_t ratio, uint8_t zeroX, uint8_t gainDivisor, uint16_t i) {
+    return (i == uint16_t(zeroX) * ratio ? 1.0 : sincSine(SINC_PI * (int32_t(i) - zeroX * ratio) / ratio) / (SINC_PI * (int32_t(i) - zeroX * ratio) / ratio))
+        * 0.5 * (1.0 - sincCosine(2.0 * SINC_PI * i / (2 * zeroX * ratio))) / gainDivisor;
+}
+
+/**
+ * list of table indices, used for expanding table initializers (std::index_sequence is C++14)
+ */
+template <uint16_t... I>
+struct SincIndexSequence {};
+
+/**
+ * generates SincIndexSequence<0, 1, ..., N - 1>
+ */
+template <uint16_t N, uint16_t... I>
+struct MakeSincIndexSequence : MakeSincIndexSequence<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct MakeSincIndexSequence<0, I...> {
+    typedef SincIndexSequence<I...> type;
+};
+
+template <uint8_t RATIO, uint8_t ZERO_X, uint8_t GAIN_DIVISOR, typename Indices>
+struct SincFilterTableValues;
+
+template <uint8_t RATIO, uint8_t ZERO_X, uint8_t GAIN_DIVISOR, uint16_t... I>
+struct SincFilterTableValues<RATIO, ZERO_X, GAIN_DIVISOR, SincIndexSequence<I...> > {
+    static constexpr float values[sizeof...(I)] = { float(sincFilterValue(RATIO, ZERO_X, GAIN_DIVISOR, I))... };
+};
+
+template <uint8_t RATIO, uint8_t ZERO_X, uint8_t GAIN_DIVISOR, uint16_t... I>
+constexpr float SincFilterTableValues<RATIO, ZERO_X, GAIN_DIVISOR, SincIndexSequence<I...> >::values[sizeof...(I)];
+
+/**
+ * windowed sinc table of 2 * ZERO_X * RATIO + 1 values, generated at compile time
+ * @param RATIO resampling ratio
+ * @param ZERO_X number of zero crossings on each side of the center of the table
+ * @param GAIN_DIVISOR divides all values (see sincFilterValue())
+ */
+template <uint8_t RATIO, uint8_t ZERO_X, uint8_t GAIN_DIVISOR = 1>
+struct SincFilterTable : SincFilterTableValues<RATIO, ZERO_X, GAIN_DIVISOR, typename MakeSincIndexSequence<2 * ZERO_X * RATIO + 1>::type> {
+    static constexpr uint16_t SIZE = 2 * ZERO_X * RATIO + 1;   ///< number of values in table
+};
+
+/**
+ * computes a single value of a polyphase sinc table. The zero padded input sample written age output samples ago is multiplied by
+ * sinc table value (SIZE - age) % SIZE. Phase q is the number of output samples since the last input sample, so tap j is applied to
+ * the j-th newest input sample (age q + j * ratio)
+ * @param ratio upsampling ratio
+ * @param zeroX number of zero crossings on each side of the center of the sinc table
+ * @param k flat index of value, q * (2 * zeroX + 1) + j
+ * @return value of polyphase table
+ */
+constexpr double sincPolyphaseValue(uint8_t ratio, uint8_t zeroX, uint16_t k) {
+    return (k / (2 * zeroX + 1)) + (k % (2 * zeroX + 1)) * ratio > 2 * zeroX * ratio ? 0.0 :
+        sincFilterValue(ratio, zeroX, 1, (2 * zeroX * ratio + 1 - ((k / (2 * zeroX + 1)) + (k % (2 * zeroX + 1)) * ratio)) % (2 * zeroX * ratio + 1));
+}
+
+template <uint8_t RATIO, uint8_t ZERO_X, typename Indices>
+struct SincPolyphaseTableValues;
+
+template <uint8_t RATIO, uint8_t ZERO_X, uint16_t... I>
+struct SincPolyphaseTableValues<RATIO, ZERO_X, SincIndexSequence<I...> > {
+    static constexpr float values[sizeof...(I)] = { float(sincPolyphaseValue(RATIO, ZERO_X, I))... };
+};
+
+template <uint8_t RATIO, uint8_t ZERO_X, uint16_t... I>
+constexpr float SincPolyphaseTableValues<RATIO, ZERO_X, SincIndexSequence<I...> >::values[sizeof...(I)];
+
+/**
+ * polyphase layout of an upsampling sinc table (RATIO phases of NUM_TAPS values each), generated at compile time. Zero padded input
+ * samples are never multiplied, so each output sample takes NUM_TAPS multiplications instead of 2 * ZERO_X * RATIO + 1
+ * @param RATIO upsampling ratio
+ * @param ZERO_X number of zero crossings on each side of the center of the sinc table
+ */
+template <uint8_t RATIO, uint8_t ZERO_X>
+struct SincPolyphaseTable : SincPolyphaseTableValues<RATIO, ZERO_X, typename MakeSincIndexSequence<RATIO * (2 * ZERO_X + 1)>::type> {
+    static constexpr uint16_t NUM_TAPS = 2 * ZERO_X + 1;   ///< number of input samples used per output sample
+    static constexpr uint8_t NUM_PHASES = RATIO;            ///< number of output samples per input sample
+};
+
+#endif
@@ -7,41 +7,7 @@
 #include "RTClib.h"
 #include <Adafruit_VC0706.h>
 #include <DFRobot_SHT3x.h>
-
-/**
- * object for controlling hardware timer interrupt
- */
-class TimerInterruptController
-{
-    private:
-
-        /**
-         * empty function for initializing timer
-         */
-        static void blankFunction(void);
-        
-    public:
-
-        /**
-         * constructor for TimerInterruptController
-         */
-        TimerInterruptController();
-
-        /**
-         * initialize timer interrupt
-         */
-        static void initialize(void);
-        /**
-         * attach callback function for timer to call at specified interval
-         * @param interval_us microseconds between each alarm
-         * @param fnPtr function pointer
-         */
-        static void attachTimerInterrupt(const unsigned long interval_us, void(*fnPtr)());
-        /**
-         * detach callback function from timer alarm
-         */
-        static void detachTimerInterrupt(void);
-};
+#include "../PiedPiperSettings.h"
 
 /**
  * object for controlling WatchDog Timer
@@ -73,8 +39,8 @@ class WDTController
  */
 enum SLEEPMODES
 {
-    IDLE0 = 0x0,      ///< IDLE0
-    IDLE1 = 0x1,      ///< IDLE1
+    IDLE0 = 0x0,      ///< IDLE0 (reserved on SAMD51, do not use)
+    IDLE1 = 0x1,      ///< IDLE1 (reserved on SAMD51, do not use)
     IDLE2 = 0x2,      ///< IDLE2
     STANDBY = 0x4,    ///< STANDBY sleep mode can exited with a interrupt (this sleep mode is good, but draws ~20mA by default)
     HIBERNATE = 0x5,  ///< HIBERNATE sleep mode can only be exited with a device reset
@@ -88,6 +54,16 @@ enum SLEEPMODES
 class SleepController
 {
     private:
+        uint64_t idleTime;          ///< time spent in idleMode since beginDutyCycle() (microseconds)
+        uint64_t elapsedTime;       ///< time since beginDutyCycle() (microseconds)
+        uint32_t lastTime;          ///< micros() when elapsedTime was last updated
+        uint32_t wakeups;           ///< number of times CPU was woken by an interrupt since beginDutyCycle()
+
+        /**
+         * adds time since last update to elapsedTime. Only a single wrap of micros() (~71.6 minutes) between updates is accounted for,
+         * idleUntil() calls this on every wakeup so elapsedTime keeps counting while no duty cycle is read
+         */
+        void updateElapsedTime(void);
 
     public:
 
@@ -101,6 +77,32 @@ class SleepController
          * @see SLEEPMODES
          */
         void goToSleep(SLEEPMODES sleepMode);
+        /**
+         * puts CPU in idle sleep mode (IDLE_SLEEP_MODE) until condition is true (i.e. until the sampling ISR filled the audio input buffer), the condition
+         * is checked every time an interrupt woke the CPU. Unlike goToSleep() timers, USB and all other peripherals keep running.
+         * @param condition function returning true once waiting is done, called with interrupts disabled
+         */
+        void idleUntil(bool (*condition)(void));
+        /**
+         * starts a new duty cycle measurement
+         */
+        void beginDutyCycle(void);
+        /**
+         * get fraction of time CPU was awake since beginDutyCycle() (including time spent in ISRs)
+         * @return duty cycle in permille
+         */
+        uint16_t getDutyCycle(void);
+        /**
+         * estimates average current draw since beginDutyCycle() from duty cycle, IDLE_CURRENT_ACTIVE and IDLE_CURRENT_SLEEP (which are
+         * unmeasured estimates, so the result is only useful for comparing duty cycles)
+         * @return estimated current draw in microamps
+         */
+        uint32_t getEstimatedCurrent(void);
+        /**
+         * prints duty cycle, estimated current draw and number of wakeups since beginDutyCycle()
+         * @param output where to print to (i.e. Serial or SD file)
+         */
+        void printDutyCycle(Print &output);
 
 };
 
@@ -161,6 +163,7 @@ class SDWrapper
 class TTLCamera
 {
     private:
+        uint32_t photoBytesRemaining = 0;   ///< number of bytes of current photo which were not yet read from camera
 
     public:
         
@@ -178,12 +181,27 @@ class TTLCamera
         bool initialize(void);
 
         /**
-         * takes a photo and saves it to a file on SD card
+         * takes a photo and saves it to a file on SD card, camera must be initialized with initialize()
          * @param file pointer to file descriptor
          * @return true on success
          */
         bool takePhoto(File *file);
 
+        /**
+         * takes a photo which is then read from camera in parts with readPhoto(), so photo can be saved in between windows of audio input.
+         * Camera must be initialized with initialize() (which can be called in an earlier window)
+         * @return true on success
+         */
+        bool beginPhoto(void);
+
+        /**
+         * reads a part of the photo taken by beginPhoto() and appends it to a file on SD card, the camera is reset once all bytes were read
+         * @param file pointer to file descriptor
+         * @param maxBytes maximum number of bytes read (reading 64 bytes takes about 17 ms at 38400 baud)
+         * @return number of bytes left to read, -1 on error
+         */
+        int32_t readPhoto(File *file, uint32_t maxBytes);
+
 };
 
 /**
@@ -1,7 +1,11 @@
 #include "Peripherals.h"
 
-SleepController::SleepController() {
+// IDLE2 is the only idle sleep mode of SAMD51 (SLEEPCFG values 0x0, 0x1 and 0x3 are reserved), other modes need a reset or stop the
+// clocks of audio input
+static_assert(IDLE_SLEEP_MODE == SLEEPMODES::IDLE2, "IDLE_SLEEP_MODE must be IDLE2");
 
+SleepController::SleepController() {
+    this->beginDutyCycle();
 }
 
 void SleepController::goToSleep(SLEEPMODES mode) {
@@ -16,4 +20,60 @@ void SleepController::goToSleep(SLEEPMODES mode) {
     // go to sleep by ensuring all memory accesses are complete with (__DSB) and calling wait for interrupt (__WFI)
     __DSB();
     __WFI();
-}
\ No newline at end of file
+}
+
+void SleepController::idleUntil(bool (*condition)(void)) {
+    PM->SLEEPCFG.bit.SLEEPMODE = IDLE_SLEEP_MODE;
+    while(PM->SLEEPCFG.bit.SLEEPMODE != IDLE_SLEEP_MODE);
+
+    // a pending interrupt wakes the CPU from __WFI() even while interrupts are disabled and is handled once they are enabled again, so an
+    // ISR can't set the condition between checking it and __WFI() (which would sleep until the next interrupt), and ISRs are not counted as
+    // idle time. Interrupts wake the CPU at least every millisecond (SysTick), so micros() stays correct while interrupts are disabled
+    noInterrupts();
+    while (!condition()) {
+        uint32_t _sleepStart = micros();
+
+        __DSB();
+        __WFI();
+
+        this->idleTime += micros() - _sleepStart;
+        this->wakeups += 1;
+
+        // idleUntil() runs every window, so elapsedTime is updated long before micros() wraps (~71.6 minutes)
+        this->updateElapsedTime();
+
+        interrupts();
+        noInterrupts();
+    }
+    interrupts();
+}
+
+void SleepController::updateElapsedTime(void) {
+    uint32_t _now = micros();
+    this->elapsedTime += _now - this->lastTime;
+    this->lastTime = _now;
+}
+
+void SleepController::beginDutyCycle(void) {
+    this->idleTime = 0;
+    this->elapsedTime = 0;
+    this->lastTime = micros();
+    this->wakeups = 0;
+}
+
+uint16_t SleepController::getDutyCycle(void) {
+    this->updateElapsedTime();
+    if (this->elapsedTime == 0 || this->idleTime >= this->elapsedTime) return 0;
+
+    return 1000 - (this->idleTime * 1000) / this->elapsedTime;
+}
+
+uint32_t SleepController::getEstimatedCurrent(void) {
+    return IDLE_CURRENT_SLEEP + (uint32_t(IDLE_CURRENT_ACTIVE - IDLE_CURRENT_SLEEP) * this->getDutyCycle()) / 1000;
+}
+
+void SleepController::printDutyCycle(Print &output) {
+    uint16_t _dutyCycle = this->getDutyCycle();
+    output.printf("duty_cycle: %d.%d%% est_current: %d uA (unmeasured estimate) wakeups: %d elapsed: %d s\n", int(_dutyCycle / 10), int(_dutyCycle % 10),
+        int(this->getEstimatedCurrent()), int(this->wakeups), int(this->elapsedTime / 1000000));
+}
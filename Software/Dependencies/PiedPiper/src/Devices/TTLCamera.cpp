@@ -19,26 +19,49 @@ bool TTLCamera::initialize() {
 bool TTLCamera::takePhoto(File *file) {
     if (!file) return false;
 
-    if (!cam->begin()) return false;
+    if (!this->beginPhoto()) return false;
+
+    int32_t _bytesRemaining;
+    do {
+        _bytesRemaining = this->readPhoto(file, 64);
+    } while (_bytesRemaining > 0);
+
+    return _bytesRemaining == 0;
+}
+
+bool TTLCamera::beginPhoto() {
+    this->photoBytesRemaining = 0;
 
     if (!cam->setImageSize(VC0706_640x480)) return false;
 
     if (!cam->takePicture()) return false;
 
-    uint32_t frameLength = cam->frameLength();
+    this->photoBytesRemaining = cam->frameLength();
+
+    return true;
+}
+
+int32_t TTLCamera::readPhoto(File *file, uint32_t maxBytes) {
+    if (!file) return -1;
 
     uint8_t *buffer;
-    uint8_t bytesToRead = 64;
+    uint8_t bytesToRead;
 
-    while (frameLength > 0) {
-        bytesToRead = min(64, frameLength);
+    while (this->photoBytesRemaining > 0 && maxBytes > 0) {
+        bytesToRead = min(uint32_t(64), min(maxBytes, this->photoBytesRemaining));
         buffer = cam->readPicture(bytesToRead);
+        if (buffer == NULL) {
+            this->photoBytesRemaining = 0;
+            cam->reset();
+            return -1;
+        }
         file->write(buffer, bytesToRead);
 
-        frameLength -= bytesToRead;
+        this->photoBytesRemaining -= bytesToRead;
+        maxBytes -= bytesToRead;
     }
 
-    cam->reset();
+    if (this->photoBytesRemaining == 0) cam->reset();
 
-    return true;
-}
\ No newline at end of file
+    return this->photoBytesRemaining;
+}
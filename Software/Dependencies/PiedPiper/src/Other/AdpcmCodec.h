@@ -0,0 +1,126 @@
+#ifndef ADPCM_CODEC_h
+#define ADPCM_CODEC_h
+
+#include <stdint.h>
+
+#define ADPCM_SOUND_MAGIC 0x41444150UL  ///< "PADA" stored little-endian at the start of an IMA-ADPCM playback file
+#define ADPCM_SOUND_VERSION 1           ///< incremented whenever the layout of adpcmSoundHeader changes
+
+/**
+ * header of an IMA-ADPCM playback file (.PAD). Raw playback files have no header and start with a 12-bit sample, which can never be equal
+ * to the magic value, so both formats can share the .PAD extension. The header is followed by (sampleCount + 1) / 2 bytes, each holding two
+ * 4-bit codes (first sample in the low nibble)
+ * @note this header is shared with the host audio file converter (see Utilities/AudioFileConverter.cpp), do not include Arduino headers here
+ */
+struct adpcmSoundHeader {
+    uint32_t magic;             ///< must be equal to ADPCM_SOUND_MAGIC
+    uint16_t version;           ///< must be equal to ADPCM_SOUND_VERSION
+    uint16_t headerSize;        ///< size of this header in bytes
+    uint32_t sampleCount;       ///< number of samples after decoding
+    int16_t predictor;          ///< initial predictor of decoder
+    uint8_t stepIndex;          ///< initial step index of decoder
+    uint8_t reserved;           ///< unused, set to 0
+};
+
+/**
+ * state of an IMA-ADPCM encoder or decoder
+ */
+struct adpcmState {
+    int16_t predictor;          ///< last predicted sample
+    uint8_t stepIndex;          ///< index into step size table
+};
+
+/**
+ * get IMA-ADPCM quantizer step size
+ * @param stepIndex index into step size table [0, 88]
+ * @return step size
+ */
+inline int16_t adpcmStepSize(uint8_t stepIndex) {
+    static const int16_t _stepSizeTable[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+        157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+        1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+        12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+    };
+    return _stepSizeTable[stepIndex];
+}
+
+/**
+ * updates step index of IMA-ADPCM state after a code was encoded or decoded
+ * @param state encoder or decoder state
+ * @param code 4-bit code
+ */
+inline void adpcmUpdateStepIndex(adpcmState &state, uint8_t code) {
+    static const int8_t _indexTable[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+    int16_t _stepIndex = state.stepIndex + _indexTable[code & 0x7];
+    state.stepIndex = _stepIndex < 0 ? 0 : (_stepIndex > 88 ? 88 : _stepIndex);
+}
+
+/**
+ * decodes a single IMA-ADPCM code
+ * @param state decoder state
+ * @param code 4-bit code
+ * @return decoded 16-bit sample
+ */
+inline int16_t adpcmDecode(adpcmState &state, uint8_t code) {
+    int32_t _step = adpcmStepSize(state.stepIndex);
+
+    // difference is computed as (code + 0.5) * step / 4 using shifts only
+    int32_t _difference = _step >> 3;
+    if (code & 0x4) _difference += _step;
+    if (code & 0x2) _difference += _step >> 1;
+    if (code & 0x1) _difference += _step >> 2;
+
+    int32_t _predictor = state.predictor + ((code & 0x8) ? -_difference : _difference);
+    state.predictor = _predictor < -32768 ? -32768 : (_predictor > 32767 ? 32767 : _predictor);
+
+    adpcmUpdateStepIndex(state, code);
+
+    return state.predictor;
+}
+
+/**
+ * encodes a single sample to an IMA-ADPCM code, encoder state follows decoder state exactly
+ * @param state encoder state
+ * @param sample 16-bit sample
+ * @return 4-bit code
+ */
+inline uint8_t adpcmEncode(adpcmState &state, int16_t sample) {
+    int32_t _step = adpcmStepSize(state.stepIndex);
+    int32_t _difference = int32_t(sample) - state.predictor;
+
+    uint8_t _code = 0;
+    if (_difference < 0) {
+        _code = 0x8;
+        _difference = -_difference;
+    }
+    if (_difference >= _step) {
+        _code |= 0x4;
+        _difference -= _step;
+    }
+    if (_difference >= (_step >> 1)) {
+        _code |= 0x2;
+        _difference -= _step >> 1;
+    }
+    if (_difference >= (_step >> 2)) _code |= 0x1;
+
+    // running decoder so that predictor matches what will be decoded
+    adpcmDecode(state, _code);
+
+    return _code;
+}
+
+/**
+ * converts a decoded 16-bit signed sample to the unsigned value written to a DAC (same conversion as AudioFileConverter)
+ * @param sample decoded sample
+ * @param dacResolution resolution of DAC in bits
+ * @return DAC value
+ */
+inline uint16_t adpcmSampleToDAC(int16_t sample, uint8_t dacResolution) {
+    uint8_t _shift = 16 - dacResolution;
+    int32_t _value = ((int32_t(sample) + (1 << (_shift - 1))) >> _shift) + (1 << (dacResolution - 1));
+    int32_t _max = (1 << dacResolution) - 1;
+    return _value < 0 ? 0 : (_value > _max ? _max : _value);
+}
+
+#endif
@@ -1,45 +1,109 @@
 #include "../PiedPiper.h"
 
-// audio input buffer
-volatile uint16_t AUD_IN_BUFFER[FFT_WINDOW_SIZE];
+// audio input buffer, each channel holds a contiguous window
+volatile uint16_t AUD_IN_BUFFER[AUD_IN_CHANNELS][FFT_WINDOW_SIZE];
 volatile uint16_t AUD_IN_BUFFER_IDX = 0;
+volatile uint32_t audioInputOverruns = 0;  // number of raw input samples discarded while AUD_IN_BUFFER was full
 
 // audio output buffer
 uint16_t PiedPiperBase::PLAYBACK_FILE[SAMPLE_RATE * PLAYBACK_FILE_LENGTH];
 uint16_t PiedPiperBase::PLAYBACK_FILE_SAMPLE_COUNT;
 
+SleepController PiedPiperBase::SleepControl;
+
+char PiedPiperBase::loadedSoundFilename[32] = { 0 };
+uint32_t PiedPiperBase::loadedSoundSize = 0;
+uint32_t PiedPiperBase::loadedSoundHash = 0;
+
 volatile uint16_t PLAYBACK_FILE_BUFFER_IDX = 0;
 
+// format of sound stored in PLAYBACK_FILE, IMA-ADPCM sounds are decoded by ISR
+PLAYBACK_FORMAT playbackFileFormat = PLAYBACK_FORMAT::PLAYBACK_PCM;
+adpcmState playbackFileDecoderInitial = { 0, 0 };
+adpcmState playbackFileDecoder = { 0, 0 };
+
+// double buffer for streaming sounds which do not fit in PLAYBACK_FILE from SD card
+File playbackStreamFile;
+uint16_t playbackStreamBuffer[2][PLAYBACK_STREAM_BUFFER_SIZE];
+volatile uint16_t playbackStreamBufferCount[2] = { 0, 0 };  // number of samples in each buffer, 0 when buffer needs to be refilled
+volatile uint8_t playbackStreamBufferIdx = 0;               // buffer currently being played by ISR
+volatile uint16_t playbackStreamSampleIdx = 0;              // index of next sample in buffer currently being played
+volatile bool playbackStreamEnd = false;                    // set once the last samples of file have been read to a buffer
+volatile bool playbackStreaming = false;
+volatile uint32_t playbackStreamUnderruns = 0;
+uint32_t playbackStreamSampleCount = 0;
+uint32_t playbackStreamSamplesRemaining = 0;
+uint32_t playbackStreamDataOffset = 0;
+
+// IMA-ADPCM streams are decoded when buffers are refilled, so the ISR always plays decoded samples
+PLAYBACK_FORMAT playbackStreamFormat = PLAYBACK_FORMAT::PLAYBACK_PCM;
+adpcmState playbackStreamDecoderInitial = { 0, 0 };
+adpcmState playbackStreamDecoder = { 0, 0 };
+uint8_t playbackStreamCodes[PLAYBACK_STREAM_BUFFER_SIZE / 2];
+
 AUD_STATE PiedPiperBase::audState = AUD_STATE::AUD_STOP;
 
-// calculating sinc table sizes
-const int sincTableSizeDown = (2 * SINC_FILTER_DOWNSAMPLE_ZERO_X + 1) * AUD_IN_DOWNSAMPLE_RATIO - AUD_IN_DOWNSAMPLE_RATIO + 1;
-const int sincTableSizeUp = (2 * SINC_FILTER_UPSAMPLE_ZERO_X + 1) * AUD_OUT_UPSAMPLE_RATIO - AUD_OUT_UPSAMPLE_RATIO + 1;
+// tables holding values corresponding to sinc filter for band limited upsampling/downsampling (generated at compile time, stored in flash)
+typedef SincFilterTable<AUD_IN_DOWNSAMPLE_RATIO, SINC_FILTER_DOWNSAMPLE_ZERO_X, AUD_IN_DOWNSAMPLE_RATIO> DownsampleSincFilter;
+typedef SincPolyphaseTable<AUD_OUT_UPSAMPLE_RATIO, SINC_FILTER_UPSAMPLE_ZERO_X> UpsampleSincFilter;
+
+const int sincTableSizeDown = DownsampleSincFilter::SIZE;
+const int sincTapsUp = UpsampleSincFilter::NUM_TAPS;
+
+const float *sincFilterTableDownsample = DownsampleSincFilter::values;
+const float *sincFilterTableUpsample = UpsampleSincFilter::values;
+
+// filter inputs are linear buffers holding the last samples of the previous block in front of the current block, so filters never wrap
+const uint16_t flatteningHistorySize = WINDOW_SIZE - 1;
 
-// tables holding values corresponding to sinc filter for band limited upsampling/downsampling
-float sincFilterTableDownsample[sincTableSizeDown];
-float sincFilterTableUpsample[sincTableSizeUp];
+// analog pins of audio input channels
+const uint8_t audioInputPins[] = { PIN_AUD_IN, PIN_AUD_IN_2, PIN_AUD_IN_3, PIN_AUD_IN_4 };
+static_assert(AUD_IN_CHANNELS >= 1 && AUD_IN_CHANNELS <= sizeof(audioInputPins), "AUD_IN_CHANNELS must be 1 to 4");
+static_assert(AUD_IN_CHANNELS <= AUDIO_STREAM_MAX_SEQUENCE, "audio input channels are sampled within one output upsampling period");
 
-// circular input buffer for downsampling
-volatile uint16_t downsampleFilterInput[sincTableSizeDown];
-volatile uint16_t downsampleInputIdx = 0;
-volatile uint16_t downsampleInputCount = 0;
+/**
+ * resampling of one audio input channel
+ */
+struct audioInputChannel {
+    uint16_t filterInput[sincTableSizeDown - 1 + AUDIO_STREAM_BLOCK_SIZE];
+    Resampler<uint16_t> downsampler;
 
-// circular input buffer for upsampling
-volatile uint16_t upsampleFilterInput[sincTableSizeUp];
-volatile uint16_t upsampleInputIdx = 0;
-volatile uint16_t upsampleInputCount = 0;
+    audioInputChannel() : downsampler(RESAMPLER_MODE::RESAMPLER_DOWNSAMPLE, sincFilterTableDownsample, sincTableSizeDown, AUD_IN_DOWNSAMPLE_RATIO,
+        filterInput, sizeof(filterInput) / sizeof(uint16_t), 0, ADC_MAX) {}
+};
+
+audioInputChannel audioInputChannels[AUD_IN_CHANNELS];
+
+// resampling of audio output, filter input only holds input samples (zero padding is skipped by polyphase table)
+uint16_t upsampleFilterInput[sincTapsUp - 1 + AUDIO_STREAM_BLOCK_SIZE];
+Resampler<uint16_t> outputUpsampler(RESAMPLER_MODE::RESAMPLER_UPSAMPLE, sincFilterTableUpsample, sincTapsUp, AUD_OUT_UPSAMPLE_RATIO,
+    upsampleFilterInput, sizeof(upsampleFilterInput) / sizeof(uint16_t), 0, DAC_MAX);
 
 // table holding values computed to flatten frequency response
 float flatteningFilter[WINDOW_SIZE];
-volatile uint16_t flatteningFilterInput[WINDOW_SIZE];
-volatile uint16_t flatteningInputIdx = 0;
-
-volatile float filteredValue = 0.0;
+uint16_t flatteningFilterInput[flatteningHistorySize + AUDIO_STREAM_BLOCK_SIZE];
 
+// last value written to DAC, held once playback is complete
 volatile uint16_t nextOutputSample = 0;
 
-volatile uint16_t sampleCount = 0;
+// output is generated two blocks ahead of being played (see AudioStream), the last samples of playback sound were played once two blocks
+// were generated after playback sound ended
+const uint8_t playbackTailBlocks = 2;
+volatile uint8_t playbackTailBlockCount = 0;
+
+// echo reference (flattened playback signal) downsampled alongside audio input, see getEchoReference()
+volatile bool echoReferenceEnabled = false;
+volatile uint16_t AUD_REF_BUFFER[FFT_WINDOW_SIZE];
+uint16_t echoReferenceWindow[FFT_WINDOW_SIZE];
+uint16_t echoReferenceFilterInput[sincTableSizeDown - 1 + AUDIO_STREAM_BLOCK_SIZE];
+Resampler<uint16_t> echoReferenceDownsampler(RESAMPLER_MODE::RESAMPLER_DOWNSAMPLE, sincFilterTableDownsample, sincTableSizeDown, AUD_IN_DOWNSAMPLE_RATIO,
+    echoReferenceFilterInput, sizeof(echoReferenceFilterInput) / sizeof(uint16_t), 0, DAC_MAX);
+uint16_t echoReferenceBlock[2][AUDIO_STREAM_BLOCK_SIZE];    // flattened playback samples of the last two output blocks, oldest is being played
+uint32_t echoReferenceBlockCount = 0;                       // number of output blocks generated since output was started
+
+// impulse response measured by impulseSequenceCalibration() (DC removed, per DAC step), see getEchoPathResponse()
+float echoPathResponse[WINDOW_SIZE];
+bool echoPathMeasured = false;
 
 void PiedPiperBase::generateImpulse() {
     for (uint16_t i = 0; i < WINDOW_SIZE; i++) {
@@ -48,183 +112,333 @@ void PiedPiperBase::generateImpulse() {
     flatteningFilter[FFT_WINDOW_SIZE] = 1.0;
 }
 
-void PiedPiperBase::RESET_PLAYBACK_FILE_INDEX() { PLAYBACK_FILE_BUFFER_IDX = 0; }
+void PiedPiperBase::RESET_PLAYBACK_FILE_INDEX() {
+    PLAYBACK_FILE_BUFFER_IDX = 0;
+    playbackFileDecoder = playbackFileDecoderInitial;
+    if (playbackStreaming) rewindPlaybackStream();
+}
+
+void PiedPiperBase::INVALIDATE_PLAYBACK_FILE() {
+    closePlaybackStream();
+    setPlaybackFileFormat(PLAYBACK_FORMAT::PLAYBACK_PCM, playbackFileDecoderInitial);
+    loadedSoundFilename[0] = 0;
+    loadedSoundSize = 0;
+    loadedSoundHash = 0;
+}
 
 void PiedPiperBase::checkResetPlaybackFileIndex() {
-    if (PLAYBACK_FILE_BUFFER_IDX >= PLAYBACK_FILE_SAMPLE_COUNT) PLAYBACK_FILE_BUFFER_IDX = 0;
+    if (playbackStreaming) return;
+    if (PLAYBACK_FILE_BUFFER_IDX >= PLAYBACK_FILE_SAMPLE_COUNT) {
+        PLAYBACK_FILE_BUFFER_IDX = 0;
+        playbackFileDecoder = playbackFileDecoderInitial;
+    }
 }
 
-uint16_t PiedPiperBase::getPlaybackFileIndex() {
-    return PLAYBACK_FILE_BUFFER_IDX;
+void PiedPiperBase::setPlaybackFileFormat(PLAYBACK_FORMAT format, adpcmState initialState) {
+    playbackFileFormat = format;
+    playbackFileDecoderInitial = initialState;
+    playbackFileDecoder = initialState;
 }
 
-void PiedPiperBase::calculateDownsampleSincFilterTable(void) {
-    int ratio = AUD_IN_DOWNSAMPLE_RATIO;
-    int nz = SINC_FILTER_DOWNSAMPLE_ZERO_X;
-    // Build sinc function table for bandlimited downsampling by @AUD_IN_DOWNSAMPLE_RATIO
-    int n = sincTableSizeDown;
+bool PiedPiperBase::openPlaybackStream(char *filename, uint32_t sampleCount, uint32_t dataOffset, PLAYBACK_FORMAT format, adpcmState initialState) {
+    closePlaybackStream();
 
-    // stores time values corresponding to sinc function
-    float ns[n];
-    float ns_step = float(nz * ratio * 2) / (n - 1);
+    playbackStreamFile = SD.open(filename, FILE_READ);
+    if (!playbackStreamFile) return false;
 
-    // stores time values corresponding to 1 period of cosine function for windowing the sinc function
-    float t[n];
-    float t_step = 1.0 / (n - 1);
+    playbackStreamSampleCount = sampleCount;
+    playbackStreamDataOffset = dataOffset;
+    playbackStreamFormat = format;
+    playbackStreamDecoderInitial = initialState;
+    playbackStreaming = true;
 
-    for (int i = 0; i < n; i++) {
-        // calculate time values for sinc function, [-nz * ratio to nz * ratio] spaced apart by ns_step
-        ns[i] = float(-1.0 * nz * ratio) + ns_step * i;
-        // calculate time values for cosine function, [0.0 to 1.0] spaced apart by t_step
-        t[i] = t_step * i;
-    }
-    // ensure to not divide by 0
-    ns[round((n - 1) / 2.0)] = 1.0;
+    // getSoundHash() must not report a sound which is not the one being played (i.e. for reusing a calibration cache)
+    loadedSoundFilename[0] = 0;
+    loadedSoundSize = 0;
+    loadedSoundHash = 0;
+
+    rewindPlaybackStream();
 
-    // calculate sinc function and store in table
-    for (int i = 0; i < n; i++) {
-        sincFilterTableDownsample[i] = (1.0 / ratio) * sin(PI * ns[i] / ratio) / (PI * ns[i] / ratio);
+    // samples are passed to analogWrite() as is, any value outside of DAC range means this isn't a playback file
+    for (uint16_t i = 0; i < playbackStreamBufferCount[0]; i++) {
+        if (playbackStreamBuffer[0][i] > DAC_MAX) {
+            closePlaybackStream();
+            return false;
+        }
     }
 
-    // sinc function is 'undefined' at 0 (sinc(0)/0), therefore set to 1.0 / ratio
-    sincFilterTableDownsample[int(round((n - 1) / 2.0))] = 1.0 / ratio;
+    return playbackStreamBufferCount[0] > 0;
+}
 
-    // window sinc function table with cosine wave 
-    for (int i = 0; i < n; i++) {
-        sincFilterTableDownsample[i] = sincFilterTableDownsample[i] * 0.5 * (1.0 - cos(2.0 * PI * t[i]));
+void PiedPiperBase::closePlaybackStream() {
+    if (!playbackStreaming) return;
+    playbackStreaming = false;
+    playbackStreamFile.close();
+}
+
+void PiedPiperBase::rewindPlaybackStream() {
+    playbackStreamBufferCount[0] = 0;
+    playbackStreamBufferCount[1] = 0;
+    playbackStreamBufferIdx = 0;
+    playbackStreamSampleIdx = 0;
+    playbackStreamEnd = false;
+    playbackStreamUnderruns = 0;
+    playbackStreamSamplesRemaining = playbackStreamSampleCount;
+    playbackStreamDecoder = playbackStreamDecoderInitial;
+
+    playbackStreamFile.seek(playbackStreamDataOffset);
+
+    // prefetching both buffers before playback starts
+    servicePlaybackStream();
+    servicePlaybackStream();
+}
+
+bool PiedPiperBase::servicePlaybackStream() {
+    if (!playbackStreaming || playbackStreamEnd) return false;
+
+    // refill the buffer after the one being played, unless the ISR is already waiting on an empty buffer
+    uint8_t _bufferIdx = playbackStreamBufferIdx;
+    if (playbackStreamBufferCount[_bufferIdx] > 0) _bufferIdx ^= 1;
+    if (playbackStreamBufferCount[_bufferIdx] > 0) return false;
+
+    uint16_t _samplesToRead = min(uint32_t(PLAYBACK_STREAM_BUFFER_SIZE), playbackStreamSamplesRemaining);
+    uint16_t _samplesRead = 0;
+    int _bytesRead;
+
+    if (playbackStreamFormat == PLAYBACK_FORMAT::PLAYBACK_ADPCM) {
+        // decoding IMA-ADPCM codes ahead of ISR, two codes are stored per byte (first sample in low nibble)
+        _bytesRead = playbackStreamFile.read(playbackStreamCodes, (_samplesToRead + 1) / 2);
+        _samplesRead = _bytesRead > 0 ? min(_samplesToRead, uint16_t(_bytesRead * 2)) : 0;
+
+        for (uint16_t i = 0; i < _samplesRead; i++) {
+            uint8_t _code = (i & 1) ? playbackStreamCodes[i >> 1] >> 4 : playbackStreamCodes[i >> 1] & 0xF;
+            playbackStreamBuffer[_bufferIdx][i] = adpcmSampleToDAC(adpcmDecode(playbackStreamDecoder, _code), DAC_RESOLUTION);
+        }
+    } else {
+        _bytesRead = playbackStreamFile.read(playbackStreamBuffer[_bufferIdx], _samplesToRead * 2);
+        _samplesRead = _bytesRead > 0 ? _bytesRead / 2 : 0;
     }
+
+    playbackStreamSamplesRemaining -= _samplesRead;
+    if (_samplesRead < _samplesToRead || playbackStreamSamplesRemaining == 0) playbackStreamEnd = true;
+
+    // buffer is handed to ISR by setting its sample count, after all samples were written
+    if (_samplesRead > 0) playbackStreamBufferCount[_bufferIdx] = _samplesRead;
+
+    return true;
 }
 
-void PiedPiperBase::calculateUpsampleSincFilterTable(void) {
-    int ratio = AUD_OUT_UPSAMPLE_RATIO;
-    int nz = SINC_FILTER_UPSAMPLE_ZERO_X;
-    // Build sinc function table for band limited upsampling by ratio
-    int n = sincTableSizeUp;
+bool PiedPiperBase::isPlaybackStreaming() {
+    return playbackStreaming;
+}
 
-    // stores time values corresponding to sinc function
-    float ns[n];
-    float ns_step = float(nz * 2) / (n - 1);
+PLAYBACK_FORMAT PiedPiperBase::getPlaybackFormat() {
+    return playbackStreaming ? playbackStreamFormat : playbackFileFormat;
+}
 
-    // stores time values corresponding to 1 period of cosine function for windowing the sinc function
-    float t[n];
-    float t_step = 1.0 / (n - 1);
+bool PiedPiperBase::playbackSamplesComplete() {
+    if (!playbackStreaming) return PLAYBACK_FILE_BUFFER_IDX >= PLAYBACK_FILE_SAMPLE_COUNT;
+    return playbackStreamEnd && playbackStreamBufferCount[0] == 0 && playbackStreamBufferCount[1] == 0;
+}
+
+bool PiedPiperBase::isPlaybackComplete() {
+    if (!playbackSamplesComplete()) return false;
+    // samples still queued in output buffer are only waited for while output is running
+    if (audState != AUD_STATE::AUD_OUT && audState != AUD_STATE::AUD_IN_OUT) return true;
+    return playbackTailBlockCount >= playbackTailBlocks;
+}
+
+bool PiedPiperBase::playbackNeedsService() {
+    if (isPlaybackComplete()) return true;
+    return playbackStreaming && !playbackStreamEnd && (playbackStreamBufferCount[0] == 0 || playbackStreamBufferCount[1] == 0);
+}
+
+uint32_t PiedPiperBase::getPlaybackStreamUnderruns() {
+    return playbackStreamUnderruns;
+}
+
+uint32_t PiedPiperBase::getAudioInputOverruns() {
+    noInterrupts();
+    uint32_t _overruns = audioInputOverruns;
+    audioInputOverruns = 0;
+    interrupts();
+
+    return _overruns;
+}
 
-    for (int i = 0; i < n; i++) {
-        // calculate time values for sinc function, [-nz to nz] spaced apart by ns_step
-        ns[i] = float(-1.0 * nz) + ns_step * i;
-        // calculate time values for cosine function, [0.0 to 1.0] spaced apart by t_step
-        t[i] = t_step * i;
+uint16_t PiedPiperBase::nextPlaybackSample() {
+    if (!playbackStreaming) {
+        if (playbackFileFormat == PLAYBACK_FORMAT::PLAYBACK_PCM) return PLAYBACK_FILE[PLAYBACK_FILE_BUFFER_IDX++];
+
+        // decoding next IMA-ADPCM code, two codes are stored per byte (first sample in low nibble)
+        uint8_t _codes = ((uint8_t *)PLAYBACK_FILE)[PLAYBACK_FILE_BUFFER_IDX >> 1];
+        uint8_t _code = (PLAYBACK_FILE_BUFFER_IDX & 1) ? _codes >> 4 : _codes & 0xF;
+        PLAYBACK_FILE_BUFFER_IDX += 1;
+
+        return adpcmSampleToDAC(adpcmDecode(playbackFileDecoder, _code), DAC_RESOLUTION);
     }
 
-    // ensure to not divide by 0
-    ns[round((n - 1) / 2.0)] = 1.0;
+    uint8_t _bufferIdx = playbackStreamBufferIdx;
 
-    // calculate sinc function and store in table
-    for (int i = 0; i < n; i++) {
-        sincFilterTableUpsample[i] = sin(PI * ns[i]) / (PI * ns[i]); 
+    // buffer wasn't refilled in time, output silence until it is
+    if (playbackStreamBufferCount[_bufferIdx] == 0) {
+        playbackStreamUnderruns += 1;
+        return DAC_MID;
     }
 
-    // sinc function is 'undefined' at 0 (sinc(0)/0), therefore set to 1.0
-    sincFilterTableUpsample[int(round((n - 1) / 2.0))] = 1.0;
+    uint16_t _sample = playbackStreamBuffer[_bufferIdx][playbackStreamSampleIdx++];
+
+    // hand buffer back for refilling once all of its samples were played
+    if (playbackStreamSampleIdx >= playbackStreamBufferCount[_bufferIdx]) {
+        playbackStreamSampleIdx = 0;
+        playbackStreamBufferCount[_bufferIdx] = 0;
+        playbackStreamBufferIdx = _bufferIdx ^ 1;
+    }
 
-    // window sinc function table with cosine wave 
-    for (int i = 0; i < n; i++) {
-        sincFilterTableUpsample[i] = sincFilterTableUpsample[i] * 0.5 * (1.0 - cos(2.0 * PI * t[i]));
-    }  
+    return _sample;
 }
 
-void PiedPiperBase::RecordAndOutputSample(void) {
-    OutputSample();
-    sampleCount += 1;
-    if (sampleCount < AUD_OUT_UPSAMPLE_RATIO) return;
-    
-    sampleCount = 0;
-    RecordSample();
+uint16_t PiedPiperBase::getPlaybackFileIndex() {
+    return PLAYBACK_FILE_BUFFER_IDX;
 }
 
-void PiedPiperBase::RecordAndOutputRawSample(void) {
-    if (AUD_IN_BUFFER_IDX >= FFT_WINDOW_SIZE) return;
-    analogWrite(PIN_AUD_OUT, PLAYBACK_FILE[PLAYBACK_FILE_BUFFER_IDX]);
-    AUD_IN_BUFFER[AUD_IN_BUFFER_IDX] = analogRead(PIN_AUD_IN);
-    
-    AUD_IN_BUFFER_IDX += 1;
-    PLAYBACK_FILE_BUFFER_IDX += 1;
-}
-
-void PiedPiperBase::RecordSample(void) {
-    if (AUD_IN_BUFFER_IDX >= FFT_WINDOW_SIZE) return;
-    // store last location in input buffer and read sample into circular downsampling input buffer
-    uint16_t downsampleInputIdxCpy = downsampleInputIdx;
-    downsampleFilterInput[downsampleInputIdx++] = analogRead(PIN_AUD_IN);
-
-    if (downsampleInputIdx == sincTableSizeDown) downsampleInputIdx = 0;
-    downsampleInputCount++;
-    // performs downsampling every AUD_IN_DOWNSAMPLE_RATIO samples
-    if (downsampleInputCount == AUD_IN_DOWNSAMPLE_RATIO) {
-        downsampleInputCount = 0;
-        // calculate downsampled value using sinc filter table
-        filteredValue = 0.0;
-        for (uint16_t i = 0; i < sincTableSizeDown; i++) {
-            filteredValue += downsampleFilterInput[downsampleInputIdxCpy++] * sincFilterTableDownsample[i];
-            if (downsampleInputIdxCpy == sincTableSizeDown) downsampleInputIdxCpy = 0;
+uint32_t PiedPiperBase::getSoundHash() {
+    return loadedSoundHash;
+}
+
+void PiedPiperBase::recordBlock(const uint16_t *samples, uint16_t count, const uint16_t *reference) {
+    PROFILE_SCOPE("isr_record");
+    uint16_t _channelSamples[AUDIO_STREAM_BLOCK_SIZE];
+    uint16_t _space = FFT_WINDOW_SIZE - AUD_IN_BUFFER_IDX;
+    uint16_t _written = 0;
+    uint16_t i;
+
+    // echo reference is downsampled with the same filter as audio input, so both are delayed equally
+    if (echoReferenceEnabled) {
+        if (reference == NULL) {
+            for (i = 0; i < count; i++) {
+                _channelSamples[i] = DAC_MID;
+            }
+            reference = _channelSamples;
         }
-        // store downsampled value in input sample buffer
-        AUD_IN_BUFFER[AUD_IN_BUFFER_IDX++] = int(round(filteredValue));
+        echoReferenceDownsampler.process(reference, count, (uint16_t *)AUD_REF_BUFFER + AUD_IN_BUFFER_IDX, _space);
     }
+
+    // volatile is cast away, input buffers are only written by ISR while AUD_IN_BUFFER_IDX is below FFT_WINDOW_SIZE
+    for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+        for (i = 0; i < count; i++) {
+            _channelSamples[i] = samples[i * AUD_IN_CHANNELS + c];
+        }
+        _written = audioInputChannels[c].downsampler.process(_channelSamples, count, (uint16_t *)AUD_IN_BUFFER[c] + AUD_IN_BUFFER_IDX, _space);
+    }
+    AUD_IN_BUFFER_IDX += _written;
+
+    // samples which do not fit in input buffer are discarded
+    audioInputOverruns += count - _written * AUD_IN_DOWNSAMPLE_RATIO;
 }
 
-void PiedPiperBase::OutputSample(void) {
-    // write sample to AUD_OUT
-    analogWrite(PIN_AUD_OUT, nextOutputSample);
+void PiedPiperBase::RecordBlock(uint16_t *block, uint16_t count) {
+    recordBlock(block, count / AUD_IN_CHANNELS, NULL);
+}
 
-    // return if outside of outputSampleBuffer bounds
-    if (PLAYBACK_FILE_BUFFER_IDX >= PLAYBACK_FILE_SAMPLE_COUNT) return;
-    // Otherwise, calculate next upsampled value for AUD_OUT
+void PiedPiperBase::RecordBlockAtOutputRate(uint16_t *block, uint16_t count) {
+    uint16_t _count = count / AUD_OUT_UPSAMPLE_RATIO;
 
-    // First layer of convolution - playback signal frequency response flattening
-    filteredValue = 0.0;
+    // keeping the last AUD_IN_CHANNELS samples of every AUD_OUT_UPSAMPLE_RATIO samples, one per channel (see startAudioInputAndOutput()),
+    // input is not low pass filtered before decimation
+    for (uint16_t i = 0; i < _count; i++) {
+        for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+            block[i * AUD_IN_CHANNELS + c] = block[(i + 1) * AUD_OUT_UPSAMPLE_RATIO - AUD_IN_CHANNELS + c];
+        }
+    }
 
-    if (upsampleInputCount == 0) {
-        uint16_t flatteningInputIdxCpy = flatteningInputIdx;
-        flatteningFilterInput[flatteningInputIdx++] = PLAYBACK_FILE[PLAYBACK_FILE_BUFFER_IDX++];
+    // input block was recorded while the oldest of the two output blocks generated since was played
+    recordBlock(block, _count, echoReferenceBlock[echoReferenceBlockCount & 1]);
+}
 
-        if (flatteningInputIdx == WINDOW_SIZE) flatteningInputIdx = 0;
+void PiedPiperBase::RecordRawBlock(uint16_t *block, uint16_t count) {
+    uint16_t _count = min(count, uint16_t(FFT_WINDOW_SIZE - AUD_IN_BUFFER_IDX));
 
-        // convolute filter input with reciprocal of recorded frequency response
-        for (uint16_t i = 0; i < WINDOW_SIZE; i++) {
-            filteredValue += flatteningFilterInput[flatteningInputIdxCpy++] * flatteningFilter[i];
-            if (flatteningInputIdxCpy == WINDOW_SIZE) flatteningInputIdxCpy = 0;
-        }
+    // raw input is only recorded from first channel (see startRawAudioInputAndOutput())
+    for (uint16_t i = 0; i < _count; i++) {
+        AUD_IN_BUFFER[0][AUD_IN_BUFFER_IDX++] = block[i];
+    }
+    audioInputOverruns += count - _count;
+}
+
+void PiedPiperBase::OutputRawBlock(uint16_t *block, uint16_t count) {
+    // samples past the end of PLAYBACK_FILE hold the last sample
+    for (uint16_t i = 0; i < count; i++) {
+        if (PLAYBACK_FILE_BUFFER_IDX < PLAYBACK_FILE_SAMPLE_COUNT) nextOutputSample = PLAYBACK_FILE[PLAYBACK_FILE_BUFFER_IDX++];
+        block[i] = nextOutputSample;
     }
+}
 
-    upsampleInputCount += 1;
+void PiedPiperBase::OutputBlock(uint16_t *block, uint16_t count) {
+    PROFILE_SCOPE("isr_output");
+    uint16_t _count = count / AUD_OUT_UPSAMPLE_RATIO;
+    uint16_t *_flattened = echoReferenceBlock[echoReferenceBlockCount & 1];    // flattened samples are the echo reference
+    uint16_t _samples = 0;
+    uint16_t _written;
+    float _filteredValue;
+    uint16_t i;
 
-    // Second layer of convolution - upsampling flattened playback signal
-    // store last location of upsampling input buffer
-    uint16_t upsampleInputIdxCpy = upsampleInputIdx;
+    if (playbackSamplesComplete() && playbackTailBlockCount < playbackTailBlocks) playbackTailBlockCount += 1;
 
-    // store value of sample to filter input buffer when upsample count == 0, otherwise pad with zeroes
-    upsampleFilterInput[upsampleInputIdx++] = round(filteredValue);
+    // First layer of convolution - playback signal frequency response flattening
+    while (_samples < _count && !playbackSamplesComplete()) {
+        uint16_t *_input = flatteningFilterInput + _samples;
+        _input[flatteningHistorySize] = nextPlaybackSample();
+
+        // convolute filter input with reciprocal of recorded frequency response, the newest sample is weighted by the first value of the
+        // filter and the others (oldest first) by the rest of the filter
+        _filteredValue = _input[flatteningHistorySize] * flatteningFilter[0];
+        for (i = 1; i < WINDOW_SIZE; i++) {
+            _filteredValue += _input[i - 1] * flatteningFilter[i];
+        }
 
-    if (upsampleInputCount == AUD_OUT_UPSAMPLE_RATIO) upsampleInputCount = 0;
-    if (upsampleInputIdx == sincTableSizeUp) upsampleInputIdx = 0;
+        _flattened[_samples++] = round(_filteredValue);
+    }
 
-    // calculate upsampled value
-    filteredValue = 0.0;
-    // convolute filter input with sinc function
-    for (uint16_t i = 0; i < sincTableSizeUp; i++) {
-        filteredValue += upsampleFilterInput[upsampleInputIdxCpy++] * sincFilterTableUpsample[i];
-        if (upsampleInputIdxCpy == sincTableSizeUp) upsampleInputIdxCpy = 0;
+    memmove(flatteningFilterInput, flatteningFilterInput + _samples, flatteningHistorySize * sizeof(uint16_t));
+
+    // Second layer of convolution - upsampling of flattened playback signal
+    _written = outputUpsampler.process(_flattened, _samples, block, count);
+    if (_written > 0) nextOutputSample = block[_written - 1];
+
+    // once all samples of playback sound were played the last output value (and flattened sample) is held
+    for (i = _written; i < count; i++) {
+        block[i] = nextOutputSample;
+    }
+    for (i = _samples; i < _count; i++) {
+        _flattened[i] = outputUpsampler.getNewest();
     }
 
-    // copy filtered value to next output sample
-    nextOutputSample = max(0, min(DAC_MAX, int(round(filteredValue))));
+    echoReferenceBlockCount += 1;
+}
+
+bool PiedPiperBase::audioInputReady() {
+    return AUD_IN_BUFFER_IDX >= FFT_WINDOW_SIZE;
 }
 
-bool PiedPiperBase::audioInputBufferFull(uint16_t *bufferPtr) {
+void PiedPiperBase::waitForAudioInput(uint16_t *bufferPtr, uint8_t numChannels) {
+    SleepControl.idleUntil(audioInputReady);
+    audioInputBufferFull(bufferPtr, numChannels);
+}
+
+bool PiedPiperBase::audioInputBufferFull(uint16_t *bufferPtr, uint8_t numChannels) {
     if (!(AUD_IN_BUFFER_IDX < FFT_WINDOW_SIZE)) {
-        for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
-            bufferPtr[i] = AUD_IN_BUFFER[i];
+        numChannels = min(numChannels, uint8_t(AUD_IN_CHANNELS));
+        for (uint8_t c = 0; c < numChannels; c++) {
+            for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
+                bufferPtr[c * FFT_WINDOW_SIZE + i] = AUD_IN_BUFFER[c][i];
+            }
+        }
+        // ISR overwrites echo reference once sampling is resumed
+        if (echoReferenceEnabled) {
+            for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
+                echoReferenceWindow[i] = AUD_REF_BUFFER[i];
+            }
         }
         AUD_IN_BUFFER_IDX = 0;
         return true;
@@ -233,23 +447,72 @@ bool PiedPiperBase::audioInputBufferFull(uint16_t *bufferPtr) {
 
 }
 
+void PiedPiperBase::setEchoReferenceEnabled(bool enabled) {
+    echoReferenceEnabled = enabled;
+}
+
+void PiedPiperBase::getEchoReference(int16_t *reference) {
+    int32_t _sum = 0;
+    uint16_t i;
+
+    for (i = 0; i < FFT_WINDOW_SIZE; i++) {
+        reference[i] = echoReferenceWindow[i];
+        _sum += reference[i];
+    }
+
+    // DC offset is removed like DCRemoval() removes it from audio input
+    int16_t _mean = _sum / FFT_WINDOW_SIZE;
+    for (i = 0; i < FFT_WINDOW_SIZE; i++) {
+        reference[i] -= _mean;
+    }
+}
+
 void PiedPiperBase::startAudioInput() {
-    TimerInterrupt.attachTimerInterrupt(AUD_IN_SAMPLE_DELAY_TIME, RecordSample);
     audState = AUD_STATE::AUD_IN;
+    audioInputOverruns = 0;
+
+    // channels are converted one after another, so the stream runs at AUD_IN_CHANNELS times the sample rate of each channel
+    AudioStream::setInputSequence(audioInputPins, AUD_IN_CHANNELS);
+    AudioStream::start(SAMPLE_RATE * AUD_IN_CHANNELS, AUDIO_STREAM_BLOCK_SIZE * AUD_IN_CHANNELS, RecordBlock, NULL);
 }
 
 void PiedPiperBase::startAudioInputAndOutput() {
-    TimerInterrupt.attachTimerInterrupt(AUD_OUT_SAMPLE_DELAY_TIME, RecordAndOutputSample);
+    uint8_t _sequence[AUD_OUT_UPSAMPLE_RATIO];
+
     audState = AUD_STATE::AUD_IN_OUT;
+    audioInputOverruns = 0;
+    playbackTailBlockCount = 0;
+    echoReferenceBlockCount = 0;
+
+    // stream runs at output sample rate, channels are converted on the last AUD_IN_CHANNELS samples of every AUD_OUT_UPSAMPLE_RATIO
+    // samples (first channel on the others), so channels are sampled at SAMPLE_RATE as close together as possible
+    for (uint8_t i = 0; i < AUD_OUT_UPSAMPLE_RATIO; i++) {
+        _sequence[i] = audioInputPins[max(0, i - (AUD_OUT_UPSAMPLE_RATIO - AUD_IN_CHANNELS))];
+    }
+    if (AUD_IN_CHANNELS > 1) {
+        AudioStream::setInputSequence(_sequence, AUD_OUT_UPSAMPLE_RATIO);
+    } else {
+        AudioStream::setInputSequence(audioInputPins, 1);
+    }
+    AudioStream::start(AUD_OUT_SAMPLE_RATE, AUDIO_STREAM_MAX_BLOCK_SIZE, RecordBlockAtOutputRate, OutputBlock);
+}
+
+void PiedPiperBase::startAudioOutput() {
+    audState = AUD_STATE::AUD_OUT;
+    playbackTailBlockCount = 0;
+    echoReferenceBlockCount = 0;
+    AudioStream::start(AUD_OUT_SAMPLE_RATE, AUDIO_STREAM_MAX_BLOCK_SIZE, NULL, OutputBlock);
 }
 
 void PiedPiperBase::startRawAudioInputAndOutput() {
-    TimerInterrupt.attachTimerInterrupt(AUD_IN_SAMPLE_DELAY_TIME, RecordAndOutputRawSample);
     audState = AUD_STATE::AUD_IN_OUT;
+    audioInputOverruns = 0;
+    AudioStream::setInputSequence(audioInputPins, 1);
+    AudioStream::start(SAMPLE_RATE, AUDIO_STREAM_BLOCK_SIZE, RecordRawBlock, OutputRawBlock);
 }
 
 void PiedPiperBase::stopAudio() {
-    TimerInterrupt.detachTimerInterrupt();
+    AudioStream::stop();
     audState = AUD_STATE::AUD_STOP;
 }
 
@@ -257,7 +520,7 @@ AUD_STATE PiedPiperBase::getAudState() {
     return audState;
 }
 
-void PiedPiperBase::impulseResponseCalibration(uint8_t responseAveraging) {
+void PiedPiperBase::impulseResponseCalibration(uint8_t responseAveraging, IMPULSE_RESPONSE_MODE mode) {
     // used for storing time domain samples and computing FFT
     uint16_t _rawSamples[FFT_WINDOW_SIZE];
     complex _samples[WINDOW_SIZE];
@@ -268,7 +531,13 @@ void PiedPiperBase::impulseResponseCalibration(uint8_t responseAveraging) {
 
     uint16_t i = 0;
 
+    if (mode == IMPULSE_RESPONSE_MODE::IMPULSE_RESPONSE_SEQUENCE) {
+        impulseSequenceCalibration(responseAveraging);
+        return;
+    }
+
     // setting up impulse for playback
+    INVALIDATE_PLAYBACK_FILE();
     for (i = 0; i < WINDOW_SIZE; i++) {
         PLAYBACK_FILE[i] = 0;
         _averagedFFT[i] = 0;
@@ -337,15 +606,132 @@ void PiedPiperBase::impulseResponseCalibration(uint8_t responseAveraging) {
     }
     _averagedFFT[0] = 0.0;
 
+    computeFlatteningFilter(_averagedFFT);
+}
+
+void PiedPiperBase::impulseSequenceCalibration(uint8_t responseAveraging) {
+    // used for storing time domain samples and computing FFT
+    uint16_t _rawSamples[FFT_WINDOW_SIZE];
+    float _averagedSamples[WINDOW_SIZE];
+    complex _response[WINDOW_SIZE];
+
+    // first impulse is only played to bring output into steady state, impulses after it are averaged
+    uint16_t _numImpulses = min(uint16_t(responseAveraging + 1), uint16_t(sizeof(PLAYBACK_FILE) / sizeof(PLAYBACK_FILE[0]) / WINDOW_SIZE - 1));
+    uint16_t _numWindows = _numImpulses * (WINDOW_SIZE / FFT_WINDOW_SIZE);
+    uint16_t _windowCount = 0;
+
+    uint16_t i = 0;
+
+    // setting up impulse sequence for playback, one impulse every WINDOW_SIZE samples
+    INVALIDATE_PLAYBACK_FILE();
+    for (i = 0; i < _numImpulses * WINDOW_SIZE; i++) {
+        PLAYBACK_FILE[i] = (i % WINDOW_SIZE) == 0 ? DAC_MAX : 0;
+    }
+    for (i = 0; i < WINDOW_SIZE; i++) {
+        _averagedSamples[i] = 0;
+    }
+
+    PLAYBACK_FILE_SAMPLE_COUNT = _numImpulses * WINDOW_SIZE;
+
+    // clearing sample buffer
+    startAudioInput();
+
+    while (!audioInputBufferFull(_rawSamples))
+        ;
+
+    stopAudio();
+
+    delay(500);
+
+    RESET_PLAYBACK_FILE_INDEX();
+
+    // recording stays aligned with impulses as long as every window is stored before the next block of input is recorded
+    startRawAudioInputAndOutput();
+
+    while (_windowCount < _numWindows) {
+        if (!audioInputBufferFull(_rawSamples)) continue;
+
+        // summing recordings of every impulse but the first, each impulse period is a circular response of WINDOW_SIZE samples
+        if (_windowCount >= WINDOW_SIZE / FFT_WINDOW_SIZE) {
+            uint16_t _offset = (_windowCount % (WINDOW_SIZE / FFT_WINDOW_SIZE)) * FFT_WINDOW_SIZE;
+            for (i = 0; i < FFT_WINDOW_SIZE; i++) {
+                _averagedSamples[_offset + i] += _rawSamples[i];
+            }
+        }
+
+        _windowCount += 1;
+    }
+
+    stopAudio();
+
+    if (getAudioInputOverruns() > 0) Serial.println("impulse response calibration: audio input overrun, response may be misaligned");
+
+    for (i = 0; i < WINDOW_SIZE; i++) {
+        _response[i] = _averagedSamples[i] / (_numImpulses - 1);
+    }
+
+    // removing dc noise from recording
+    DCRemoval(_response, WINDOW_SIZE);
+
+    // impulse response is kept for seeding echo cancellation (impulses are DAC_MAX steps above 0)
+    for (i = 0; i < WINDOW_SIZE; i++) {
+        echoPathResponse[i] = _response[i].re() / DAC_MAX;
+    }
+    echoPathMeasured = true;
+
+    // running FFT on averaged impulse response
+    Fast4::FFT(_response, WINDOW_SIZE);
+
+    // regularized inverse conj(H) / (|H|^2 + lambda), bins with little energy are not amplified beyond 1 / (2 * sqrt(lambda))
+    float _maxPower = 0;
+    for (i = 0; i < WINDOW_SIZE; i++) {
+        _maxPower = max(_maxPower, _response[i].norm());
+    }
+
+    float _lambda = IMPULSE_RESPONSE_REGULARIZATION * _maxPower;
+
+    for (i = 0; i < WINDOW_SIZE; i++) {
+        if (_response[i].norm() + _lambda > 0) _response[i] = _response[i].conjugate() / (_response[i].norm() + _lambda);
+        else _response[i] = 0.0;
+    }
+    _response[0] = 0.0;
+
+    computeFlatteningFilter(_response);
+}
+
+bool PiedPiperBase::getEchoPathResponse(float *response) {
+    if (!echoPathMeasured) return false;
+
+    const int16_t _center = sincTableSizeDown / 2;
+    int16_t _idx;
+
+    // echo path is delayed by upsampling filter (echo reference is recorded before upsampling), low pass filtered with the same sinc
+    // filter as audio input and decimated. The response is to a single sample rather than a band limited signal, so its gain is
+    // multiplied by AUD_IN_DOWNSAMPLE_RATIO
+    for (uint16_t i = 0; i < FFT_WINDOW_SIZE; i++) {
+        response[i] = 0.0;
+        for (int16_t j = 0; j < sincTableSizeDown; j++) {
+            _idx = i * AUD_IN_DOWNSAMPLE_RATIO - SINC_FILTER_UPSAMPLE_ZERO_X - (j - _center);
+            if (_idx >= 0 && _idx < WINDOW_SIZE) response[i] += echoPathResponse[_idx] * sincFilterTableDownsample[j];
+        }
+        response[i] *= AUD_IN_DOWNSAMPLE_RATIO;
+    }
+
+    return true;
+}
+
+void PiedPiperBase::computeFlatteningFilter(complex *inverseResponse) {
+    uint16_t i;
+
     // computing time domain signal corresponding to inverse frequency response
-    Fast4::IFFT(_averagedFFT, WINDOW_SIZE);
+    Fast4::IFFT(inverseResponse, WINDOW_SIZE);
 
     // windowing signal with cosine window and getting sum to ensure sum of signal is equal to 1.0
     float _sum = 0;
     float _cosTime = 2 * PI / (WINDOW_SIZE - 1);
 
     for (i = 0; i < WINDOW_SIZE; i++) {
-        flatteningFilter[i] = _averagedFFT[i].re() * 0.5 * (1.0 - cos(_cosTime * i));
+        flatteningFilter[i] = inverseResponse[i].re() * 0.5 * (1.0 - cos(_cosTime * i));
         _sum += flatteningFilter[i];
     }
 
@@ -357,5 +743,56 @@ void PiedPiperBase::impulseResponseCalibration(uint8_t responseAveraging) {
         // Serial.print(", ");
     }
     // Serial.println();
+}
+
+bool PiedPiperBase::loadCalibration(char *filename, uint32_t soundHash, calibrationFileHeader &header) {
+    if (!SDCard.openFile(filename, FILE_READ)) return false;
+
+    float _filter[WINDOW_SIZE];
+    uint32_t _dataSize = sizeof(_filter);
 
-}
\ No newline at end of file
+    bool _valid = SDCard.data.read(&header, sizeof(header)) == sizeof(header);
+    _valid = _valid && header.magic == CALIBRATION_FILE_MAGIC && header.version == CALIBRATION_FILE_VERSION && header.headerSize == sizeof(header);
+    _valid = _valid && header.filterLength == WINDOW_SIZE && header.soundHash == soundHash;
+    _valid = _valid && SDCard.data.read(_filter, _dataSize) == _dataSize;
+
+    SDCard.closeFile();
+
+    if (!_valid || fnv1aHash(_filter, _dataSize) != header.checksum) return false;
+
+    // filter is only replaced once cache is known to be valid
+    for (uint16_t i = 0; i < WINDOW_SIZE; i++) {
+        flatteningFilter[i] = _filter[i];
+    }
+
+    return true;
+}
+
+bool PiedPiperBase::saveCalibration(char *filename, uint32_t soundHash, uint32_t timestamp, int16_t wiperValue, uint16_t verificationPeak) {
+    calibrationFileHeader _header;
+    _header.magic = CALIBRATION_FILE_MAGIC;
+    _header.version = CALIBRATION_FILE_VERSION;
+    _header.headerSize = sizeof(_header);
+    _header.soundHash = soundHash;
+    _header.timestamp = timestamp;
+    _header.wiperValue = wiperValue;
+    _header.verificationPeak = verificationPeak;
+    _header.filterLength = WINDOW_SIZE;
+    _header.reserved = 0;
+    _header.checksum = fnv1aHash(flatteningFilter, sizeof(flatteningFilter));
+
+    // FILE_WRITE appends to existing files, remove stale file first
+    if (SD.exists(filename)) SD.remove(filename);
+
+    if (!SDCard.openFile(filename, FILE_WRITE)) return false;
+
+    bool _success = SDCard.data.write((uint8_t *)&_header, sizeof(_header)) == sizeof(_header);
+    _success = _success && SDCard.data.write((uint8_t *)flatteningFilter, sizeof(flatteningFilter)) == sizeof(flatteningFilter);
+
+    SDCard.closeFile();
+
+    // removing partially written file so it isn't loaded next boot
+    if (!_success) SD.remove(filename);
+
+    return _success;
+}
@@ -0,0 +1,357 @@
+#include "AudioStream.h"
+
+uint16_t AudioStream::inputBuffer[2 * AUDIO_STREAM_MAX_BLOCK_SIZE];
+uint16_t AudioStream::outputBuffer[2 * AUDIO_STREAM_MAX_BLOCK_SIZE];
+
+audioBlockCallback AudioStream::inputCallback = NULL;
+audioBlockCallback AudioStream::outputCallback = NULL;
+uint32_t AudioStream::sampleRate = 0;
+uint16_t AudioStream::blockSize = 0;
+volatile uint32_t AudioStream::blockCount = 0;
+volatile uint8_t AudioStream::currentHalf = 0;
+volatile bool AudioStream::running = false;
+
+uint8_t AudioStream::inputSequence[AUDIO_STREAM_MAX_SEQUENCE];
+uint8_t AudioStream::inputSequenceLength = 0;
+
+bool AudioStream::start(uint32_t rate, uint16_t samplesPerBlock, audioBlockCallback input, audioBlockCallback output) {
+    stop();
+
+    if (rate == 0 || samplesPerBlock == 0 || samplesPerBlock > AUDIO_STREAM_MAX_BLOCK_SIZE) return false;
+    if (input == NULL && output == NULL) return false;
+
+    sampleRate = rate;
+    blockSize = samplesPerBlock;
+    inputCallback = input;
+    outputCallback = output;
+    blockCount = 0;
+    currentHalf = 0;
+
+    // output is generated two blocks ahead of being played
+    if (outputCallback != NULL) {
+        outputCallback(outputBuffer, blockSize);
+        outputCallback(outputBuffer + blockSize, blockSize);
+    }
+
+    running = startBackend();
+    return running;
+}
+
+bool AudioStream::setInputSequence(const uint8_t *pins, uint8_t length) {
+    if (length == 0 || length > AUDIO_STREAM_MAX_SEQUENCE) return false;
+
+    for (uint8_t i = 0; i < length; i++) {
+        inputSequence[i] = pins[i];
+    }
+    inputSequenceLength = length;
+
+    return true;
+}
+
+void AudioStream::stop() {
+    if (!running) return;
+    stopBackend();
+    running = false;
+}
+
+bool AudioStream::isRunning() {
+    return running;
+}
+
+uint32_t AudioStream::getBlockCount() {
+    return blockCount;
+}
+
+void AudioStream::blockComplete() {
+    uint16_t _offset = currentHalf * blockSize;
+
+    // input is processed first, so the input callback can still use data generated along with the output block which was just played
+    if (inputCallback != NULL) inputCallback(inputBuffer + _offset, blockSize);
+    if (outputCallback != NULL) outputCallback(outputBuffer + _offset, blockSize);
+
+    currentHalf ^= 1;
+    blockCount += 1;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+#define AUDIO_STREAM_TIMER_CLOCK 48000000UL     // frequency of GCLK1 (DFLL48M), clock of TC2
+
+#define AUDIO_STREAM_DMA_MAX_(a, b) ((a) > (b) ? (a) : (b))
+#define AUDIO_STREAM_DMA_CHANNELS (AUDIO_STREAM_DMA_MAX_(AUDIO_STREAM_DMA_MAX_(AUDIO_STREAM_DMA_CHANNEL_IN, AUDIO_STREAM_DMA_CHANNEL_OUT), AUDIO_STREAM_DMA_CHANNEL_MUX) + 1)
+#define AUDIO_STREAM_DMA_HANDLER_(n) DMAC_##n##_Handler
+#define AUDIO_STREAM_DMA_HANDLER(n) AUDIO_STREAM_DMA_HANDLER_(n)
+#define AUDIO_STREAM_DMA_IRQN_(n) DMAC_##n##_IRQn
+#define AUDIO_STREAM_DMA_IRQN(n) AUDIO_STREAM_DMA_IRQN_(n)
+
+static_assert(AUDIO_STREAM_DMA_CHANNEL_IN < 4 && AUDIO_STREAM_DMA_CHANNEL_OUT < 4, "audio stream DMA channels must have their own interrupt (0 to 3)");
+static_assert(AUDIO_STREAM_DMA_CHANNEL_IN != AUDIO_STREAM_DMA_CHANNEL_OUT && AUDIO_STREAM_DMA_CHANNEL_MUX != AUDIO_STREAM_DMA_CHANNEL_IN &&
+    AUDIO_STREAM_DMA_CHANNEL_MUX != AUDIO_STREAM_DMA_CHANNEL_OUT, "audio stream needs three DMA channels");
+
+// descriptors of the first half of each double buffer are stored in the descriptor table of DMAC (one per channel up to the highest
+// channel used), descriptors of the second half are linked to them and link back, so each channel loops over its double buffer
+static DmacDescriptor dmaDescriptors[AUDIO_STREAM_DMA_CHANNELS] __attribute__((aligned(16)));
+static DmacDescriptor dmaWriteback[AUDIO_STREAM_DMA_CHANNELS] __attribute__((aligned(16)));
+static DmacDescriptor dmaSecondHalf[2] __attribute__((aligned(16)));   // input, output
+static bool dmaInitialized = false;
+
+// ADC0 INPUTCTRL values of input sequence, rotated by one: after a conversion the input of the next conversion is written
+static uint16_t muxSequence[AUDIO_STREAM_MAX_SEQUENCE];
+
+/**
+ * resets a DMA channel and sets up its two linked descriptors
+ * @param channel DMA channel
+ * @param trigger trigger source (i.e. ADC0_DMAC_ID_RESRDY)
+ * @param secondHalf descriptor of second half of double buffer
+ * @param buffer double buffer of 2 * count samples
+ * @param count number of samples per half
+ * @param peripheral data register of ADC or DAC
+ * @param toPeripheral true if channel moves samples from buffer to peripheral
+ */
+static void configureDMAChannel(uint8_t channel, uint8_t trigger, DmacDescriptor *secondHalf, uint16_t *buffer, uint16_t count, volatile void *peripheral, bool toPeripheral) {
+    DMAC->Channel[channel].CHCTRLA.bit.ENABLE = 0;
+    while (DMAC->Channel[channel].CHCTRLA.bit.ENABLE);
+    DMAC->Channel[channel].CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    while (DMAC->Channel[channel].CHCTRLA.bit.SWRST);
+
+    // incrementing addresses point to the end of the block
+    DmacDescriptor *_descriptors[2] = { &dmaDescriptors[channel], secondHalf };
+    for (uint8_t i = 0; i < 2; i++) {
+        uint16_t *_half = buffer + (i + 1) * count;
+        _descriptors[i]->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_INT | DMAC_BTCTRL_BEATSIZE_HWORD |
+            (toPeripheral ? DMAC_BTCTRL_SRCINC : DMAC_BTCTRL_DSTINC);
+        _descriptors[i]->BTCNT.reg = count;
+        _descriptors[i]->SRCADDR.reg = toPeripheral ? (uint32_t)_half : (uint32_t)peripheral;
+        _descriptors[i]->DSTADDR.reg = toPeripheral ? (uint32_t)peripheral : (uint32_t)_half;
+        _descriptors[i]->DESCADDR.reg = (uint32_t)_descriptors[i ^ 1];
+    }
+
+    DMAC->Channel[channel].CHCTRLA.reg = DMAC_CHCTRLA_TRIGSRC(trigger) | DMAC_CHCTRLA_TRIGACT_BURST | DMAC_CHCTRLA_BURSTLEN_SINGLE;
+    DMAC->Channel[channel].CHPRILVL.reg = DMAC_CHPRILVL_PRILVL_LVL3;
+    DMAC->Channel[channel].CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+}
+
+/**
+ * disables a DMA channel and its interrupt
+ * @param channel DMA channel
+ */
+static void disableDMAChannel(uint8_t channel) {
+    DMAC->Channel[channel].CHCTRLA.bit.ENABLE = 0;
+    while (DMAC->Channel[channel].CHCTRLA.bit.ENABLE);
+    DMAC->Channel[channel].CHINTENCLR.reg = DMAC_CHINTENCLR_MASK;
+    DMAC->Channel[channel].CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+}
+
+/**
+ * handles block transfer complete interrupt of a DMA channel
+ * @param channel DMA channel
+ */
+static void dmaInterrupt(uint8_t channel) {
+    if ((DMAC->Channel[channel].CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) == 0) return;
+    DMAC->Channel[channel].CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+    AudioStream::blockComplete();
+}
+
+extern "C" void AUDIO_STREAM_DMA_HANDLER(AUDIO_STREAM_DMA_CHANNEL_IN)(void) {
+    dmaInterrupt(AUDIO_STREAM_DMA_CHANNEL_IN);
+}
+
+extern "C" void AUDIO_STREAM_DMA_HANDLER(AUDIO_STREAM_DMA_CHANNEL_OUT)(void) {
+    dmaInterrupt(AUDIO_STREAM_DMA_CHANNEL_OUT);
+}
+
+bool AudioStream::startBackend() {
+    uint32_t _period = (AUDIO_STREAM_TIMER_CLOCK + sampleRate / 2) / sampleRate;
+    if (_period < 2 || _period > 0x10000) return false;
+
+    // Arduino core sets up pin multiplexing, reference and resolution of ADC and DAC, analogRead() leaves ADC disabled
+    if (inputCallback != NULL) analogRead(PIN_AUD_IN);
+    if (outputCallback != NULL) analogWrite(PIN_AUD_OUT, outputBuffer[0]);
+
+    if (!dmaInitialized) {
+        DMAC->CTRL.bit.DMAENABLE = 0;
+        DMAC->BASEADDR.reg = (uint32_t)dmaDescriptors;
+        DMAC->WRBADDR.reg = (uint32_t)dmaWriteback;
+        DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+        dmaInitialized = true;
+    }
+
+    // TC2 overflows once per sample, overflow starts an ADC conversion (event) and a DAC write (DMA trigger)
+    MCLK->APBBMASK.reg |= MCLK_APBBMASK_TC2 | MCLK_APBBMASK_EVSYS;
+    GCLK->PCHCTRL[TC2_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+    while ((GCLK->PCHCTRL[TC2_GCLK_ID].reg & GCLK_PCHCTRL_CHEN) == 0);
+
+    TC2->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC2->COUNT16.SYNCBUSY.bit.SWRST);
+    TC2->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV1;
+    TC2->COUNT16.WAVE.reg = TC_WAVE_WAVEGEN_MFRQ;
+    TC2->COUNT16.CC[0].reg = _period - 1;
+    while (TC2->COUNT16.SYNCBUSY.bit.CC0);
+    TC2->COUNT16.EVCTRL.reg = TC_EVCTRL_OVFEO;
+
+    // the interrupt is taken from the input channel if input is enabled, its block completes last (after conversion of its last sample)
+    uint8_t _interruptChannel = inputCallback != NULL ? AUDIO_STREAM_DMA_CHANNEL_IN : AUDIO_STREAM_DMA_CHANNEL_OUT;
+
+    if (inputCallback != NULL) {
+        configureDMAChannel(AUDIO_STREAM_DMA_CHANNEL_IN, ADC0_DMAC_ID_RESRDY, &dmaSecondHalf[0], inputBuffer, blockSize, &ADC0->RESULT.reg, false);
+
+        // PIN_AUD_IN is converted until an input sequence is set
+        if (inputSequenceLength == 0) {
+            inputSequence[0] = PIN_AUD_IN;
+            inputSequenceLength = 1;
+        }
+
+        // analogRead() connects pins to ADC, INPUTCTRL selects the first pin of the sequence
+        for (uint8_t i = 0; i < inputSequenceLength; i++) {
+            analogRead(inputSequence[i]);
+            muxSequence[(i + inputSequenceLength - 1) % inputSequenceLength] = ADC_INPUTCTRL_MUXPOS(g_APinDescription[inputSequence[i]].ulADCChannelNumber) |
+                ADC_INPUTCTRL_MUXNEG_GND;
+        }
+        ADC0->INPUTCTRL.reg = muxSequence[inputSequenceLength - 1];
+
+        // a single descriptor linked to itself writes the sequence over and over, triggered by the same result as the input channel
+        if (inputSequenceLength > 1) {
+            DmacDescriptor &_descriptor = dmaDescriptors[AUDIO_STREAM_DMA_CHANNEL_MUX];
+            DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_MUX].CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+            while (DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_MUX].CHCTRLA.bit.SWRST);
+
+            _descriptor.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_SRCINC;
+            _descriptor.BTCNT.reg = inputSequenceLength;
+            _descriptor.SRCADDR.reg = (uint32_t)(muxSequence + inputSequenceLength);
+            _descriptor.DSTADDR.reg = (uint32_t)&ADC0->INPUTCTRL.reg;
+            _descriptor.DESCADDR.reg = (uint32_t)&_descriptor;
+
+            DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_MUX].CHCTRLA.reg = DMAC_CHCTRLA_TRIGSRC(ADC0_DMAC_ID_RESRDY) | DMAC_CHCTRLA_TRIGACT_BURST |
+                DMAC_CHCTRLA_BURSTLEN_SINGLE;
+            DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_MUX].CHPRILVL.reg = DMAC_CHPRILVL_PRILVL_LVL2;
+        }
+
+        EVSYS->USER[EVSYS_ID_USER_ADC0_START].reg = EVSYS_USER_CHANNEL(AUDIO_STREAM_EVSYS_CHANNEL + 1);
+        EVSYS->Channel[AUDIO_STREAM_EVSYS_CHANNEL].CHANNEL.reg = EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_TC2_OVF) | EVSYS_CHANNEL_PATH_ASYNCHRONOUS;
+
+        ADC0->EVCTRL.reg = ADC_EVCTRL_STARTEI;
+        ADC0->CTRLA.bit.ENABLE = 1;
+        while (ADC0->SYNCBUSY.bit.ENABLE);
+    }
+
+    if (outputCallback != NULL) {
+        configureDMAChannel(AUDIO_STREAM_DMA_CHANNEL_OUT, TC2_DMAC_ID_OVF, &dmaSecondHalf[1], outputBuffer, blockSize, &DAC->DATA[0].reg, true);
+    }
+
+    DMAC->Channel[_interruptChannel].CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;
+    NVIC_ClearPendingIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_IN));
+    NVIC_ClearPendingIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_OUT));
+    NVIC_SetPriority(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_IN), 0);
+    NVIC_SetPriority(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_OUT), 0);
+    NVIC_EnableIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_IN));
+    NVIC_EnableIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_OUT));
+
+    // channels wait for their triggers, so input and output start on the same overflow
+    if (inputCallback != NULL) DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_IN].CHCTRLA.bit.ENABLE = 1;
+    if (inputCallback != NULL && inputSequenceLength > 1) DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_MUX].CHCTRLA.bit.ENABLE = 1;
+    if (outputCallback != NULL) DMAC->Channel[AUDIO_STREAM_DMA_CHANNEL_OUT].CHCTRLA.bit.ENABLE = 1;
+
+    TC2->COUNT16.CTRLA.bit.ENABLE = 1;
+    while (TC2->COUNT16.SYNCBUSY.bit.ENABLE);
+
+    return true;
+}
+
+void AudioStream::stopBackend() {
+    TC2->COUNT16.CTRLA.bit.ENABLE = 0;
+    while (TC2->COUNT16.SYNCBUSY.bit.ENABLE);
+
+    NVIC_DisableIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_IN));
+    NVIC_DisableIRQ(AUDIO_STREAM_DMA_IRQN(AUDIO_STREAM_DMA_CHANNEL_OUT));
+
+    disableDMAChannel(AUDIO_STREAM_DMA_CHANNEL_IN);
+    disableDMAChannel(AUDIO_STREAM_DMA_CHANNEL_OUT);
+    disableDMAChannel(AUDIO_STREAM_DMA_CHANNEL_MUX);
+
+    // ADC is handed back to analogRead() in the state it left it in
+    if (inputCallback != NULL) {
+        ADC0->CTRLA.bit.ENABLE = 0;
+        while (ADC0->SYNCBUSY.bit.ENABLE);
+        ADC0->EVCTRL.reg = 0;
+        EVSYS->USER[EVSYS_ID_USER_ADC0_START].reg = 0;
+    }
+}
+#else
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static std::thread simulatorThread;
+static std::atomic<bool> simulatorStop(false);
+static bool simulatedRealTime = true;
+
+static const uint16_t *simulatedInput = NULL;
+static uint32_t simulatedInputCount = 0;
+static uint32_t simulatedInputIdx = 0;
+static bool simulatedInputLoop = false;
+
+static uint16_t *simulatedOutput = NULL;
+static uint32_t simulatedOutputCapacity = 0;
+static uint32_t simulatedOutputCount = 0;
+
+void AudioStream::setSimulatedInput(const uint16_t *samples, uint32_t count, bool loop) {
+    simulatedInput = samples;
+    simulatedInputCount = count;
+    simulatedInputIdx = 0;
+    simulatedInputLoop = loop;
+}
+
+void AudioStream::setSimulatedOutput(uint16_t *samples, uint32_t capacity) {
+    simulatedOutput = samples;
+    simulatedOutputCapacity = capacity;
+    simulatedOutputCount = 0;
+}
+
+uint32_t AudioStream::getSimulatedOutputCount() {
+    return simulatedOutputCount;
+}
+
+void AudioStream::setSimulatedRealTime(bool realTime) {
+    simulatedRealTime = realTime;
+}
+
+void AudioStream::simulate() {
+    std::chrono::steady_clock::time_point _next = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds _period(uint64_t(blockSize) * 1000000000ULL / sampleRate);
+
+    while (!simulatorStop) {
+        if (simulatedRealTime) {
+            _next += _period;
+            std::this_thread::sleep_until(_next);
+        }
+
+        uint16_t _offset = currentHalf * blockSize;
+
+        // the half completing now was recorded and played during the last block period
+        for (uint16_t i = 0; i < blockSize; i++) {
+            if (simulatedInputIdx >= simulatedInputCount && simulatedInputLoop) simulatedInputIdx = 0;
+            inputBuffer[_offset + i] = simulatedInputIdx < simulatedInputCount ? simulatedInput[simulatedInputIdx++] : 1 << (ADC_RESOLUTION - 1);
+        }
+
+        if (outputCallback != NULL) {
+            for (uint16_t i = 0; i < blockSize && simulatedOutputCount < simulatedOutputCapacity; i++) {
+                simulatedOutput[simulatedOutputCount++] = outputBuffer[_offset + i];
+            }
+        }
+
+        blockComplete();
+    }
+}
+
+bool AudioStream::startBackend() {
+    simulatorStop = false;
+    simulatorThread = std::thread(simulate);
+    return true;
+}
+
+void AudioStream::stopBackend() {
+    simulatorStop = true;
+    if (simulatorThread.joinable()) simulatorThread.join();
+}
+#endif
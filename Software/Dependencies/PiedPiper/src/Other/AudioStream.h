@@ -0,0 +1,142 @@
+#ifndef AUDIO_STREAM_h
+#define AUDIO_STREAM_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../PiedPiperSettings.h"
+
+// Block streaming audio input and output. Samples are moved between ADC/DAC and two halves of a double buffer without the CPU (on
+// target a hardware timer triggers ADC conversions and DMA transfers), and a callback is called once per block instead of once per
+// sample. While one half is being recorded/played the callbacks process the other half: the input callback gets the half which was just
+// recorded and the output callback refills the half which was just played, so output is generated two blocks ahead of being played.
+// On host the same interface is backed by a simulator thread which reads input from memory and writes output to memory (see
+// setSimulatedInput()), so code using AudioStream can be run without the target.
+// Several analog inputs can share the ADC: an input sequence (see setInputSequence()) selects the pin converted on each sample, so input
+// blocks hold interleaved samples of all pins in the sequence.
+// Note: this header is shared with host utilities, Arduino headers are only included when ARDUINO is defined
+
+#define AUDIO_STREAM_MAX_SEQUENCE AUD_OUT_UPSAMPLE_RATIO    ///< maximum length of input sequence
+
+/**
+ * block callback of AudioStream, called from interrupt (on host from simulator thread)
+ * @param block samples of block (ADC values for input, DAC values for output)
+ * @param count number of samples in block
+ */
+typedef void (*audioBlockCallback)(uint16_t *block, uint16_t count);
+
+/**
+ * static interface of block streaming audio input and output. Input and output run at the same sample rate and are triggered by the
+ * same timer, so sample i of an input block was recorded while sample i of the output block passed to the output callback two blocks
+ * earlier was played. On target: TC2 triggers ADC0 (via EVSYS) and DAC0 (via DMA), DMA channels AUDIO_STREAM_DMA_CHANNEL_IN/OUT move
+ * samples, one interrupt per block. DMA channel AUDIO_STREAM_DMA_CHANNEL_MUX switches ADC0 input after every conversion if the input
+ * sequence holds more than one pin.
+ */
+class AudioStream
+{
+    private:
+        static uint16_t inputBuffer[2 * AUDIO_STREAM_MAX_BLOCK_SIZE];     ///< double buffer written by ADC
+        static uint16_t outputBuffer[2 * AUDIO_STREAM_MAX_BLOCK_SIZE];    ///< double buffer read by DAC
+
+        static audioBlockCallback inputCallback;    ///< called with each recorded block, NULL if input is disabled
+        static audioBlockCallback outputCallback;   ///< called for refilling each played block, NULL if output is disabled
+        static uint32_t sampleRate;                 ///< sample rate of input and output
+        static uint16_t blockSize;                  ///< number of samples per block (half of double buffer)
+        static volatile uint32_t blockCount;        ///< number of blocks since start()
+        static volatile uint8_t currentHalf;        ///< half of double buffers which completes next
+        static volatile bool running;               ///< true between start() and stop()
+
+        static uint8_t inputSequence[AUDIO_STREAM_MAX_SEQUENCE];    ///< analog pins converted on consecutive samples
+        static uint8_t inputSequenceLength;                         ///< number of pins in input sequence, 0 until setInputSequence() is called
+
+        /**
+         * starts hardware (or simulator thread) once buffers are prepared, called by start()
+         * @return False if sample rate can't be generated
+         */
+        static bool startBackend(void);
+
+        /**
+         * stops hardware (or simulator thread), called by stop()
+         */
+        static void stopBackend(void);
+
+#ifndef ARDUINO
+        /**
+         * simulator thread, reads an input block and writes an output block once per block period
+         */
+        static void simulate(void);
+#endif
+
+    public:
+        /**
+         * starts streaming, both halves of output buffer are filled by outputCallback before the first sample is played
+         * @param rate sample rate of input and output (i.e. SAMPLE_RATE or AUD_OUT_SAMPLE_RATE)
+         * @param samplesPerBlock number of samples per block, at most AUDIO_STREAM_MAX_BLOCK_SIZE
+         * @param input called with every recorded block, NULL to disable input
+         * @param output called for refilling every played block, NULL to disable output
+         * @return False if stream can't be started with these parameters
+         * @note a running stream is stopped first, samples of a partially recorded block are discarded
+         */
+        static bool start(uint32_t rate, uint16_t samplesPerBlock, audioBlockCallback input, audioBlockCallback output);
+
+        /**
+         * sets analog pins converted by input, sample i of the stream is read from pins[i % length]. Takes effect on next start()
+         * @param pins analog pins (i.e. PIN_AUD_IN), on target all pins must be inputs of ADC0
+         * @param length number of pins, 1 to AUDIO_STREAM_MAX_SEQUENCE
+         * @return False if length is out of range
+         */
+        static bool setInputSequence(const uint8_t *pins, uint8_t length);
+
+        /**
+         * stops streaming, the last value written to DAC is held
+         */
+        static void stop(void);
+
+        /**
+         * checks if stream is running
+         * @return true between start() and stop()
+         */
+        static bool isRunning(void);
+
+        /**
+         * get number of blocks processed since stream was started, i.e. number of audio interrupts
+         * @return number of blocks
+         */
+        static uint32_t getBlockCount(void);
+
+        /**
+         * processes the half of the double buffer which was just completed (input callback, then output callback), called once per block
+         * by the DMA interrupt (on host by simulator thread)
+         */
+        static void blockComplete(void);
+
+#ifndef ARDUINO
+        /**
+         * sets samples read by simulated ADC, input blocks past the end of samples are filled with ADC_MID (or start over if loop is set)
+         * @param samples ADC values, must remain valid while stream runs
+         * @param count number of samples
+         * @param loop true to start over at the end of samples
+         */
+        static void setSimulatedInput(const uint16_t *samples, uint32_t count, bool loop);
+
+        /**
+         * sets buffer written by simulated DAC, samples past capacity are discarded
+         * @param samples buffer for DAC values
+         * @param capacity number of samples which fit in buffer
+         */
+        static void setSimulatedOutput(uint16_t *samples, uint32_t capacity);
+
+        /**
+         * get number of samples written by simulated DAC since setSimulatedOutput()
+         * @return number of samples
+         */
+        static uint32_t getSimulatedOutputCount(void);
+
+        /**
+         * sets pacing of simulator thread
+         * @param realTime true to deliver blocks at sample rate, false to deliver blocks as fast as callbacks return
+         */
+        static void setSimulatedRealTime(bool realTime);
+#endif
+};
+
+#endif
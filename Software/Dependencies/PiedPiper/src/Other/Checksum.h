@@ -0,0 +1,23 @@
+#ifndef CHECKSUM_h
+#define CHECKSUM_h
+
+#include <stdint.h>
+
+/**
+ * computes a 32-bit FNV-1a hash of some data, used for validating files stored on SD card
+ * @param data pointer to data
+ * @param numBytes number of bytes to hash
+ * @param hash hash to continue from, allows for hashing data in chunks
+ * @return hash of data
+ * @note this header is shared with host utilities, do not include Arduino headers here
+ */
+inline uint32_t fnv1aHash(const void *data, uint32_t numBytes, uint32_t hash = 2166136261UL) {
+    const uint8_t *_bytes = (const uint8_t *)data;
+    for (uint32_t i = 0; i < numBytes; i++) {
+        hash ^= _bytes[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef CYCLE_COUNTER_h
+#define CYCLE_COUNTER_h
+
+#include <stdint.h>
+
+// Free running time stamp counter used for measuring execution time (Profiler, kernel benchmarks). On target the Cortex-M4 DWT cycle
+// counter is used (ticks are CPU cycles), on host std::chrono::steady_clock is used (ticks are nanoseconds).
+// Note: this header is shared with host utilities, Arduino headers are only included when ARDUINO is defined
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+/**
+ * enables DWT cycle counter, must be called before cycleCounterTicks() is used
+ */
+inline void cycleCounterBegin(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * get current value of time stamp counter
+ * @return CPU cycles (wraps around)
+ */
+inline uint32_t cycleCounterTicks(void) { return DWT->CYCCNT; }
+
+/**
+ * get number of ticks per microsecond
+ * @return F_CPU / 1000000
+ */
+inline uint32_t cycleCounterTicksPerMicrosecond(void) { return F_CPU / 1000000; }
+#else
+#include <chrono>
+
+inline void cycleCounterBegin(void) {}
+
+inline uint32_t cycleCounterTicks(void) {
+    return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline uint32_t cycleCounterTicksPerMicrosecond(void) { return 1000; }
+#endif
+
+#endif
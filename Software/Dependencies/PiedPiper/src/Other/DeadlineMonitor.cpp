@@ -0,0 +1,120 @@
+#include "DeadlineMonitor.h"
+
+DeadlineMonitor::DeadlineMonitor(uint32_t deadline) {
+    this->deadline = deadline;
+    this->degradeEnabled = true;
+    this->degradeLevel = DEGRADE_LEVEL::DEGRADE_NONE;
+    this->recoverCount = 0;
+    this->windowStart = 0;
+    this->stageStart = 0;
+    this->windowStage = NULL;
+    this->windowStageTime = 0;
+    this->windowMissed = false;
+    this->reset();
+}
+
+void DeadlineMonitor::setDegradeEnabled(bool enabled) {
+    this->degradeEnabled = enabled;
+    if (!enabled) this->degradeLevel = DEGRADE_LEVEL::DEGRADE_NONE;
+}
+
+void DeadlineMonitor::beginWindow(uint32_t now) {
+    this->windowStart = now;
+    this->stageStart = now;
+    this->windowStage = NULL;
+    this->windowStageTime = 0;
+    this->windowMissed = false;
+}
+
+void DeadlineMonitor::endStage(const char *name, uint32_t now) {
+    uint32_t _stageTime = now - this->stageStart;
+    if (this->windowStage == NULL || _stageTime > this->windowStageTime) {
+        this->windowStage = name;
+        this->windowStageTime = _stageTime;
+    }
+    this->stageStart = now;
+}
+
+bool DeadlineMonitor::endWindow(uint32_t now, uint32_t discardedSamples) {
+    int32_t _slack = int32_t(this->deadline) - int32_t(now - this->windowStart);
+    bool _met = _slack >= 0 && discardedSamples == 0;
+
+    this->windows += 1;
+    this->lostSamples += discardedSamples;
+    this->windowMissed = !_met;
+
+    if (!_met) {
+        // worst miss is the one with least slack, its longest stage is reported as the offending stage
+        if (this->misses == 0 || _slack < this->minSlack) {
+            this->missStage = this->windowStage;
+            this->missStageTime = this->windowStageTime;
+        }
+        this->misses += 1;
+    }
+
+    if (_slack < this->minSlack) this->minSlack = _slack;
+
+    if (!_met) {
+        this->recoverCount = 0;
+        if (this->degradeEnabled && this->degradeLevel < DEGRADE_LEVEL::DEGRADE_SKIP_CORRELATION) {
+            this->degradeLevel = DEGRADE_LEVEL(this->degradeLevel + 1);
+            Serial.printf("DeadlineMonitor: deadline missed by %d us (%s), degrade level %d\n", int(-_slack), this->windowStage != NULL ? this->windowStage : "-", int(this->degradeLevel));
+        }
+    } else if (this->degradeLevel > DEGRADE_LEVEL::DEGRADE_NONE && _slack >= this->deadline * DEADLINE_RECOVER_SLACK) {
+        this->recoverCount += 1;
+        if (this->recoverCount >= DEADLINE_RECOVER_WINDOWS) {
+            this->recoverCount = 0;
+            this->degradeLevel = DEGRADE_LEVEL(this->degradeLevel - 1);
+        }
+    } else this->recoverCount = 0;
+
+    if (this->degradeLevel > this->maxDegradeLevel) this->maxDegradeLevel = this->degradeLevel;
+
+    return _met;
+}
+
+void DeadlineMonitor::endTasks(uint32_t now, uint32_t discardedSamples, const char *task, uint32_t taskTime) {
+    if (discardedSamples == 0) return;
+
+    int32_t _slack = int32_t(this->deadline) - int32_t(now - this->windowStart);
+
+    this->lostSamples += discardedSamples;
+
+    if (this->misses == 0 || _slack < this->minSlack) {
+        this->missStage = task;
+        this->missStageTime = taskTime;
+    }
+    if (!this->windowMissed) this->misses += 1;
+    this->windowMissed = true;
+
+    if (_slack < this->minSlack) this->minSlack = _slack;
+
+    // a slow task slice is not a reason to skip detection stages, but the window doesn't count towards recovering either
+    this->recoverCount = 0;
+
+    Serial.printf("DeadlineMonitor: %d samples lost while tasks ran (%s)\n", int(discardedSamples), task != NULL ? task : "-");
+}
+
+DEGRADE_LEVEL DeadlineMonitor::getDegradeLevel(void) {
+    return this->degradeLevel;
+}
+
+uint32_t DeadlineMonitor::getMisses(void) {
+    return this->misses;
+}
+
+void DeadlineMonitor::printSummary(Print &output) {
+    output.printf("windows: %d misses: %d lost: %d min_slack: %d us stage: %s (%d us) degrade: %d/%d\n", int(this->windows), int(this->misses),
+        int(this->lostSamples), int(this->minSlack), this->missStage != NULL ? this->missStage : "-", int(this->missStageTime),
+        int(this->degradeLevel), int(this->maxDegradeLevel));
+}
+
+void DeadlineMonitor::reset(void) {
+    this->windows = 0;
+    this->misses = 0;
+    this->lostSamples = 0;
+    this->minSlack = this->deadline;
+    this->missStage = NULL;
+    this->missStageTime = 0;
+    this->maxDegradeLevel = this->degradeLevel;
+}
@@ -0,0 +1,115 @@
+#ifndef DEADLINE_MONITOR_h
+#define DEADLINE_MONITOR_h
+
+#include <Arduino.h>
+#include "../PiedPiperSettings.h"
+
+/**
+ * Levels of work skipped by the detection loop while it can't keep up with audio input, each level includes the previous ones
+ */
+enum DEGRADE_LEVEL {
+    DEGRADE_NONE = 0,           ///< all stages run on every window
+    DEGRADE_SKIP_SMOOTHING,     ///< time and frequency smoothing are skipped
+    DEGRADE_SKIP_CORRELATION    ///< correlation runs on every other window only
+};
+
+/**
+ * class for checking that each window of audio input is processed before the next window is sampled (FFT_WINDOW_SIZE / FFT_SAMPLE_RATE).
+ * Processing time is split in named stages, a window which takes longer than the deadline or during which input samples were discarded
+ * (see PiedPiperBase::getAudioInputOverruns()) is counted as a miss along with its longest stage. Samples discarded while tasks run in
+ * the slack after the window (see TaskScheduler) are recorded separately by endTasks() with the task as offending stage. The degrade
+ * level is raised after every miss of the detection stages (not after task overruns, skipping stages would not help) and lowered again after DEADLINE_RECOVER_WINDOWS windows in a row finish with at least DEADLINE_RECOVER_SLACK of the deadline to spare.
+ */
+class DeadlineMonitor
+{
+    private:
+        uint32_t deadline;              ///< time available for processing a window (microseconds)
+
+        uint32_t windowStart;           ///< micros() when current window started
+        uint32_t stageStart;            ///< micros() when current stage started
+        const char *windowStage;        ///< longest stage of current window
+        uint32_t windowStageTime;       ///< duration of longest stage of current window
+        bool windowMissed;              ///< true if detection stages of current window missed deadline
+
+        uint32_t windows;               ///< number of windows since last reset
+        uint32_t misses;                ///< number of windows which missed deadline since last reset
+        uint32_t lostSamples;           ///< number of input samples discarded since last reset
+        int32_t minSlack;               ///< smallest slack of any window since last reset (negative if a window missed deadline)
+        const char *missStage;          ///< longest stage of the worst missed window since last reset
+        uint32_t missStageTime;         ///< duration of missStage in the worst missed window
+
+        bool degradeEnabled;            ///< true if degrade level may be raised
+        DEGRADE_LEVEL degradeLevel;     ///< current degrade level
+        DEGRADE_LEVEL maxDegradeLevel;  ///< highest degrade level since last reset
+        uint16_t recoverCount;          ///< number of consecutive windows with enough slack to lower degrade level
+
+    public:
+        /**
+         * constructor for DeadlineMonitor
+         * @param deadline time available for processing a window (microseconds)
+         */
+        DeadlineMonitor(uint32_t deadline);
+
+        /**
+         * enables or disables degrading, disabling resets degrade level to DEGRADE_NONE
+         * @param enabled true if degrade level may be raised after a miss
+         */
+        void setDegradeEnabled(bool enabled);
+
+        /**
+         * starts measuring a window, called once a window of audio input is available
+         * @param now current time (micros())
+         */
+        void beginWindow(uint32_t now);
+
+        /**
+         * ends current stage and starts the next one
+         * @param name name of stage which just ended, must remain valid (i.e. a string literal)
+         * @param now current time (micros())
+         */
+        void endStage(const char *name, uint32_t now);
+
+        /**
+         * ends current window, computes slack and updates degrade level
+         * @param now current time (micros())
+         * @param discardedSamples number of input samples discarded while window was processed
+         * @return true if window met its deadline
+         */
+        bool endWindow(uint32_t now, uint32_t discardedSamples);
+
+        /**
+         * records input samples discarded while tasks ran after the current window was processed, counted as a miss (unless the detection
+         * stages of the window already missed) with the task as offending stage, degrade level is not changed
+         * @param now current time (micros())
+         * @param discardedSamples number of input samples discarded while tasks ran
+         * @param task name of task with the longest slice, NULL if no task ran
+         * @param taskTime duration of longest slice (microseconds)
+         */
+        void endTasks(uint32_t now, uint32_t discardedSamples, const char *task, uint32_t taskTime);
+
+        /**
+         * get current degrade level
+         * @return DEGRADE_LEVEL the detection loop should run at
+         */
+        DEGRADE_LEVEL getDegradeLevel(void);
+
+        /**
+         * get number of windows which missed their deadline since last reset
+         * @return number of misses
+         */
+        uint32_t getMisses(void);
+
+        /**
+         * prints a single line summary (windows, misses, lost samples, minimum slack, stage of worst miss, degrade level) to Serial or an open file
+         * @param output Serial or an open file (i.e. LOG.TXT)
+         */
+        void printSummary(Print &output);
+
+        /**
+         * clears statistics (degrade level is kept)
+         */
+        void reset(void);
+
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "MemoryArena.h"
+
+MemoryArena::MemoryArena(uint8_t *buffer, uint32_t capacity) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    this->reset();
+}
+
+void *MemoryArena::allocate(const char *name, uint32_t numBytes) {
+    // rounding allocation up so that the next allocation is aligned
+    uint32_t _alignedBytes = (numBytes + MEMORY_ARENA_ALIGNMENT - 1) & ~uint32_t(MEMORY_ARENA_ALIGNMENT - 1);
+    bool _fits = this->used + _alignedBytes <= this->capacity;
+
+    this->requested += _alignedBytes;
+
+    if (this->numAllocations < MEMORY_ARENA_MAX_ALLOCATIONS) {
+        this->allocationNames[this->numAllocations] = name;
+        this->allocationSizes[this->numAllocations] = _alignedBytes;
+        this->numAllocations += 1;
+    } else _fits = false;
+
+    if (!_fits) {
+        Serial.printf("MemoryArena::allocate() out of memory: %s (%d bytes)\n", name, int(numBytes));
+        return NULL;
+    }
+
+    void *_ptr = this->buffer + this->used;
+    memset(_ptr, 0, _alignedBytes);
+    this->used += _alignedBytes;
+
+    return _ptr;
+}
+
+void MemoryArena::reset(void) {
+    this->used = 0;
+    this->requested = 0;
+    this->numAllocations = 0;
+}
+
+bool MemoryArena::withinBudget(void) {
+    return this->requested <= this->capacity && this->requested == this->used;
+}
+
+uint32_t MemoryArena::getUsed(void) {
+    return this->used;
+}
+
+uint32_t MemoryArena::getRequested(void) {
+    return this->requested;
+}
+
+uint32_t MemoryArena::getCapacity(void) {
+    return this->capacity;
+}
+
+void MemoryArena::printUsage(void) {
+    for (uint8_t i = 0; i < this->numAllocations; i++) {
+        Serial.printf("%s: %d bytes\n", this->allocationNames[i], int(this->allocationSizes[i]));
+    }
+    Serial.printf("arena: %d / %d bytes used (%d bytes requested)\n", int(this->used), int(this->capacity), int(this->requested));
+}
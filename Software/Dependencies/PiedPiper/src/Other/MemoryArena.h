@@ -0,0 +1,90 @@
+#ifndef MEMORY_ARENA_h
+#define MEMORY_ARENA_h
+
+#include <Arduino.h>
+
+#define MEMORY_ARENA_MAX_ALLOCATIONS 16 ///< maximum number of named allocations tracked by a MemoryArena
+#define MEMORY_ARENA_ALIGNMENT 4        ///< alignment (in bytes) of every allocation
+
+/**
+ * class for sub-allocating buffers from one fixed-size (statically allocated) block of memory. Buffers are never freed individually,
+ * the whole arena is reset instead, so memory can't fragment. Every allocation is named so the memory used by each buffer can be reported.
+ */
+class MemoryArena
+{
+    private:
+
+        uint8_t *buffer;        ///< pointer to block of memory the arena allocates from
+        uint32_t capacity;      ///< size of buffer in bytes
+        uint32_t used;          ///< number of bytes allocated (including alignment padding)
+        uint32_t requested;     ///< number of bytes requested, including failed allocations, used for budget check
+
+        const char *allocationNames[MEMORY_ARENA_MAX_ALLOCATIONS];  ///< names of allocations, failed allocations are recorded too
+        uint32_t allocationSizes[MEMORY_ARENA_MAX_ALLOCATIONS];     ///< size of allocations in bytes
+        uint8_t numAllocations;                                     ///< number of allocations (including failed allocations)
+
+    public:
+
+        /**
+         * constructor for MemoryArena
+         * @param buffer pointer to block of memory (i.e. a global uint8_t array)
+         * @param capacity size of buffer in bytes
+         */
+        MemoryArena(uint8_t *buffer, uint32_t capacity);
+
+        /**
+         * allocates a block of memory from the arena
+         * @param name name of allocation used in usage report, must remain valid (i.e. a string literal)
+         * @param numBytes size of allocation in bytes
+         * @return pointer to zeroed block of memory, NULL if arena is out of memory
+         */
+        void *allocate(const char *name, uint32_t numBytes);
+
+        /**
+         * allocates an array from the arena
+         * @param name name of allocation used in usage report
+         * @param count number of elements
+         * @return pointer to zeroed array, NULL if arena is out of memory
+         */
+        template <typename T>
+        T *allocate(const char *name, uint32_t count) {
+            return (T *)this->allocate(name, count * sizeof(T));
+        }
+
+        /**
+         * releases all allocations, pointers returned before reset must not be used afterwards
+         */
+        void reset(void);
+
+        /**
+         * checks whether all allocations requested since last reset fit in arena
+         * @return false if any allocation failed
+         */
+        bool withinBudget(void);
+
+        /**
+         * get number of bytes allocated from arena
+         * @return number of bytes allocated (including alignment padding)
+         */
+        uint32_t getUsed(void);
+
+        /**
+         * get number of bytes requested from arena
+         * @return number of bytes requested, including failed allocations
+         */
+        uint32_t getRequested(void);
+
+        /**
+         * get size of arena
+         * @return size of arena in bytes
+         */
+        uint32_t getCapacity(void);
+
+        /**
+         * prints size of each allocation and total usage of arena
+         */
+        void printUsage(void);
+
+};
+
+#endif
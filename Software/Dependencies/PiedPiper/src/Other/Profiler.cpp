@@ -0,0 +1,124 @@
+#include "Profiler.h"
+
+#ifdef PIEDPIPER_PROFILING
+
+#include <string.h>
+
+#ifdef ARDUINO
+#define PROFILER_ENTER_CRITICAL() noInterrupts()
+#define PROFILER_EXIT_CRITICAL() interrupts()
+#else
+#define PROFILER_ENTER_CRITICAL()
+#define PROFILER_EXIT_CRITICAL()
+#endif
+
+profileScopeStats Profiler::scopes[PROFILER_MAX_SCOPES];
+uint8_t Profiler::numScopes = 0;
+
+void Profiler::begin(void) {
+    cycleCounterBegin();
+    reset();
+}
+
+uint32_t Profiler::ticksPerMicrosecond(void) {
+    return cycleCounterTicksPerMicrosecond();
+}
+
+uint8_t Profiler::registerScope(const char *name) {
+    uint8_t _id;
+
+    PROFILER_ENTER_CRITICAL();
+
+    for (_id = 0; _id < numScopes; _id++) {
+        if (strcmp(scopes[_id].name, name) == 0) break;
+    }
+
+    if (_id == numScopes && numScopes < PROFILER_MAX_SCOPES) {
+        memset(&scopes[_id], 0, sizeof(profileScopeStats));
+        scopes[_id].name = name;
+        scopes[_id].minTicks = 0xFFFFFFFF;
+        numScopes += 1;
+    }
+
+    PROFILER_EXIT_CRITICAL();
+
+    return _id;
+}
+
+void Profiler::record(uint8_t id, uint32_t duration) {
+    if (id >= numScopes) return;
+
+    profileScopeStats *_stats = &scopes[id];
+
+    _stats->count += 1;
+    _stats->totalTicks += duration;
+    if (duration < _stats->minTicks) _stats->minTicks = duration;
+    if (duration > _stats->maxTicks) _stats->maxTicks = duration;
+
+    // bin index is the number of significant bits of duration
+    uint8_t _bin = duration == 0 ? 0 : 32 - __builtin_clz(duration);
+    if (_bin >= PROFILER_HISTOGRAM_BINS) _bin = PROFILER_HISTOGRAM_BINS - 1;
+    _stats->histogram[_bin] += 1;
+}
+
+const profileScopeStats *Profiler::getStats(uint8_t id) {
+    if (id >= numScopes) return NULL;
+    return &scopes[id];
+}
+
+uint8_t Profiler::getNumScopes(void) {
+    return numScopes;
+}
+
+void Profiler::reset(void) {
+    PROFILER_ENTER_CRITICAL();
+
+    for (uint8_t i = 0; i < numScopes; i++) {
+        const char *_name = scopes[i].name;
+        memset(&scopes[i], 0, sizeof(profileScopeStats));
+        scopes[i].name = _name;
+        scopes[i].minTicks = 0xFFFFFFFF;
+    }
+
+    PROFILER_EXIT_CRITICAL();
+}
+
+#ifdef ARDUINO
+#define PROFILER_PRINTF(...) output.printf(__VA_ARGS__)
+void Profiler::printReport(Print &output) {
+#else
+#define PROFILER_PRINTF(...) fprintf(output, __VA_ARGS__)
+void Profiler::printReport(FILE *output) {
+#endif
+    profileScopeStats _stats;
+
+    // durations are printed in ticks, integer formatting only (float printf is not available on all targets)
+    PROFILER_PRINTF("ticks per us: %lu\n", (unsigned long)ticksPerMicrosecond());
+    PROFILER_PRINTF("scope count min mean max\n");
+
+    for (uint8_t i = 0; i < numScopes; i++) {
+        // copy statistics so they are not updated by an ISR while printing
+        PROFILER_ENTER_CRITICAL();
+        _stats = scopes[i];
+        PROFILER_EXIT_CRITICAL();
+
+        if (_stats.count == 0) {
+            PROFILER_PRINTF("%s 0 - - -\n", _stats.name);
+            continue;
+        }
+
+        PROFILER_PRINTF("%s %lu %lu %lu %lu\n", _stats.name, (unsigned long)_stats.count, (unsigned long)_stats.minTicks,
+            (unsigned long)(_stats.totalTicks / _stats.count), (unsigned long)_stats.maxTicks);
+
+        // histogram bins are printed as upper bound (in ticks) and count
+        PROFILER_PRINTF("  histogram:");
+        for (uint8_t b = 0; b < PROFILER_HISTOGRAM_BINS; b++) {
+            if (_stats.histogram[b] == 0) continue;
+            if (b == PROFILER_HISTOGRAM_BINS - 1) PROFILER_PRINTF(" >=%lu:%lu", 1UL << (b - 1), (unsigned long)_stats.histogram[b]);
+            else PROFILER_PRINTF(" <%lu:%lu", 1UL << b, (unsigned long)_stats.histogram[b]);
+        }
+        PROFILER_PRINTF("\n");
+    }
+}
+
+#endif
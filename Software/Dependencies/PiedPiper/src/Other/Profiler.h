@@ -0,0 +1,158 @@
+#ifndef PROFILER_h
+#define PROFILER_h
+
+#include <stdint.h>
+#include "../PiedPiperSettings.h"
+#include "CycleCounter.h"
+
+// Per-stage execution time profiling. Stages are wrapped in named scopes (PROFILE_SCOPE("fft")), every time a scope is left its duration
+// is added to the statistics of its name (count, min/mean/max and a log2 histogram). Durations are measured in ticks of CycleCounter.h
+// (CPU cycles on target, nanoseconds on host), see Profiler::ticksPerMicrosecond().
+// Profiling is compiled out completely (macros expand to nothing) unless PIEDPIPER_PROFILING is defined (see PiedPiperSettings.h).
+// Note: this header is shared with host utilities, Arduino headers are only included when ARDUINO is defined
+
+#ifdef PIEDPIPER_PROFILING
+
+#ifdef ARDUINO
+class Print;
+#else
+#include <stdio.h>
+#endif
+
+/**
+ * execution time statistics of a single named scope
+ */
+struct profileScopeStats {
+    const char *name;                               ///< name of scope, NULL if unused
+    uint32_t count;                                 ///< number of times scope was left
+    uint32_t minTicks;                              ///< shortest duration
+    uint32_t maxTicks;                              ///< longest duration
+    uint64_t totalTicks;                            ///< sum of durations, used for mean duration
+    uint32_t histogram[PROFILER_HISTOGRAM_BINS];    ///< bin b counts durations in [2^(b - 1), 2^b), last bin counts all longer durations
+};
+
+/**
+ * static registry of profiling scopes, safe to use from ISRs (statistics are only read with interrupts disabled)
+ */
+class Profiler
+{
+    private:
+        static profileScopeStats scopes[PROFILER_MAX_SCOPES];   ///< statistics of each registered scope
+        static uint8_t numScopes;                               ///< number of registered scopes
+
+    public:
+        /**
+         * enables cycle counter, must be called before any scope is measured
+         */
+        static void begin(void);
+
+        /**
+         * get current value of time stamp counter
+         * @return CPU cycles on target, nanoseconds on host (wraps around)
+         */
+        static uint32_t ticks(void) { return cycleCounterTicks(); };
+
+        /**
+         * get number of ticks per microsecond
+         * @return F_CPU / 1000000 on target, 1000 on host
+         */
+        static uint32_t ticksPerMicrosecond(void);
+
+        /**
+         * registers a scope, registering a name twice returns the same id
+         * @param name name of scope, must remain valid (i.e. a string literal)
+         * @return id of scope, PROFILER_MAX_SCOPES if there are too many scopes (durations are discarded)
+         */
+        static uint8_t registerScope(const char *name);
+
+        /**
+         * adds a duration to the statistics of a scope
+         * @param id id returned by registerScope()
+         * @param duration duration in ticks
+         */
+        static void record(uint8_t id, uint32_t duration);
+
+        /**
+         * get statistics of a scope
+         * @param id id returned by registerScope()
+         * @return pointer to statistics, NULL if id is invalid
+         */
+        static const profileScopeStats *getStats(uint8_t id);
+
+        /**
+         * get number of registered scopes
+         * @return number of scopes
+         */
+        static uint8_t getNumScopes(void);
+
+        /**
+         * clears statistics of all scopes (scopes stay registered)
+         */
+        static void reset(void);
+
+#ifdef ARDUINO
+        /**
+         * prints statistics of all scopes (durations in ticks) and their non empty histogram bins
+         * @param output Serial or an open file
+         */
+        static void printReport(Print &output);
+#else
+        /**
+         * prints statistics of all scopes (durations in ticks) and their non empty histogram bins
+         * @param output stdout or an open file
+         */
+        static void printReport(FILE *output);
+#endif
+};
+
+/**
+ * measures the lifetime of an object, duration is recorded when the object goes out of scope
+ */
+class ProfileScope
+{
+    private:
+        uint8_t id;         ///< id of scope
+        uint32_t start;     ///< ticks when scope was entered
+
+    public:
+        /**
+         * constructor for ProfileScope, starts measuring
+         * @param id id returned by Profiler::registerScope()
+         */
+        ProfileScope(uint8_t id) {
+            this->id = id;
+            this->start = Profiler::ticks();
+        };
+
+        /**
+         * destructor for ProfileScope, records duration
+         */
+        ~ProfileScope(void) {
+            Profiler::record(this->id, Profiler::ticks() - this->start);
+        };
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/**
+ * measures the rest of the enclosing block as scope name (scope is registered the first time it is entered)
+ */
+#define PROFILE_SCOPE(name) \
+    static uint8_t PROFILE_CONCAT(_profileId, __LINE__) = Profiler::registerScope(name); \
+    ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(PROFILE_CONCAT(_profileId, __LINE__))
+
+#define PROFILE_BEGIN() Profiler::begin()
+#define PROFILE_REPORT(output) Profiler::printReport(output)
+#define PROFILE_RESET() Profiler::reset()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_BEGIN()
+#define PROFILE_REPORT(output)
+#define PROFILE_RESET()
+
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(uint32_t margin) {
+    this->numTasks = 0;
+    this->margin = margin;
+    this->longestSlice = NULL;
+    this->longestSliceTime = 0;
+}
+
+int8_t TaskScheduler::addTask(const char *name, taskFunction function, TASK_PRIORITY priority, uint32_t interval, uint32_t budget) {
+    if (this->numTasks >= TASK_MAX_TASKS) {
+        Serial.printf("TaskScheduler: cannot add task %s, TASK_MAX_TASKS reached\n", name);
+        return -1;
+    }
+
+    task &_task = this->tasks[this->numTasks];
+    _task.function = function;
+    _task.priority = priority;
+    _task.interval = interval;
+    _task.budget = budget;
+    _task.lastStart = micros();
+    _task.deferCount = 0;
+    _task.pending = false;
+    _task.enabled = true;
+
+    memset(&_task.stats, 0, sizeof(taskStats));
+    _task.stats.name = name;
+
+    return this->numTasks++;
+}
+
+void TaskScheduler::trigger(int8_t id) {
+    if (id < 0 || id >= this->numTasks) return;
+    this->tasks[id].pending = true;
+}
+
+void TaskScheduler::setEnabled(int8_t id, bool enabled) {
+    if (id < 0 || id >= this->numTasks) return;
+    this->tasks[id].enabled = enabled;
+    this->tasks[id].lastStart = micros();
+}
+
+bool TaskScheduler::isPending(int8_t id) {
+    if (id < 0 || id >= this->numTasks) return false;
+    return this->tasks[id].pending;
+}
+
+void TaskScheduler::restartIntervals(uint32_t now) {
+    for (uint8_t i = 0; i < this->numTasks; i++) {
+        this->tasks[i].lastStart = now;
+    }
+}
+
+uint8_t TaskScheduler::run(uint32_t windowStart, uint32_t deadline) {
+    uint32_t _now = micros();
+    uint8_t _slices = 0;
+
+    this->longestSlice = NULL;
+    this->longestSliceTime = 0;
+
+    // periodic tasks become pending once their interval has passed
+    for (uint8_t i = 0; i < this->numTasks; i++) {
+        task &_task = this->tasks[i];
+        if (_task.interval == 0 || !_task.enabled || _task.pending) continue;
+        if (_now - _task.lastStart < _task.interval) continue;
+
+        _task.lastStart = _now;
+        _task.pending = true;
+    }
+
+    // tasks are run by priority (then by order added), at most one slice per task per window
+    bool _ran[TASK_MAX_TASKS] = { false };
+    while (true) {
+        int8_t _next = -1;
+        for (uint8_t i = 0; i < this->numTasks; i++) {
+            if (!this->tasks[i].pending || _ran[i]) continue;
+            if (_next < 0 || this->tasks[i].priority < this->tasks[_next].priority) _next = i;
+        }
+        if (_next < 0) break;
+
+        task &_task = this->tasks[_next];
+        _ran[_next] = true;
+
+        int32_t _slack = int32_t(deadline) - int32_t(micros() - windowStart) - int32_t(this->margin);
+        bool _forced = _task.deferCount >= TASK_MAX_DEFERRALS;
+        if (_slack < int32_t(_task.budget) && !_forced) {
+            _task.deferCount += 1;
+            _task.stats.deferrals += 1;
+            continue;
+        }
+
+        uint32_t _start = micros();
+        bool _done = _task.function();
+        uint32_t _time = micros() - _start;
+
+        _task.deferCount = 0;
+        _task.stats.runs += 1;
+        _task.stats.totalTime += _time;
+        if (_time > _task.stats.maxTime) _task.stats.maxTime = _time;
+        if (_time > _task.budget) {
+            // an overrun can discard audio input, so the task is not started again unless its longest slice fits
+            _task.stats.overruns += 1;
+            _task.budget = _time;
+        }
+        if (_forced) _task.stats.forced += 1;
+
+        if (this->longestSlice == NULL || _time > this->longestSliceTime) {
+            this->longestSlice = _task.stats.name;
+            this->longestSliceTime = _time;
+        }
+
+        if (_done) {
+            _task.pending = false;
+            _task.stats.completions += 1;
+        }
+        _slices += 1;
+    }
+
+    return _slices;
+}
+
+const char *TaskScheduler::getLongestSlice(void) {
+    return this->longestSlice;
+}
+
+uint32_t TaskScheduler::getLongestSliceTime(void) {
+    return this->longestSliceTime;
+}
+
+const taskStats *TaskScheduler::getStats(int8_t id) {
+    if (id < 0 || id >= this->numTasks) return NULL;
+    return &this->tasks[id].stats;
+}
+
+uint8_t TaskScheduler::getNumTasks(void) {
+    return this->numTasks;
+}
+
+void TaskScheduler::printStats(Print &output) {
+    for (uint8_t i = 0; i < this->numTasks; i++) {
+        const taskStats &_stats = this->tasks[i].stats;
+        output.printf("task: %s runs: %d done: %d avg: %d us max: %d us budget: %d us overruns: %d deferred: %d forced: %d\n", _stats.name,
+            int(_stats.runs), int(_stats.completions), int(_stats.runs > 0 ? _stats.totalTime / _stats.runs : 0), int(_stats.maxTime),
+            int(this->tasks[i].budget), int(_stats.overruns), int(_stats.deferrals), int(_stats.forced));
+    }
+}
+
+void TaskScheduler::resetStats(void) {
+    for (uint8_t i = 0; i < this->numTasks; i++) {
+        const char *_name = this->tasks[i].stats.name;
+        memset(&this->tasks[i].stats, 0, sizeof(taskStats));
+        this->tasks[i].stats.name = _name;
+    }
+}
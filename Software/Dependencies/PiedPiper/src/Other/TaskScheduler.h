@@ -0,0 +1,156 @@
+#ifndef TASK_SCHEDULER_h
+#define TASK_SCHEDULER_h
+
+#include <Arduino.h>
+#include "../PiedPiperSettings.h"
+
+/**
+ * Priorities of scheduled tasks, when several tasks are pending the task with the highest priority (lowest value) runs first
+ */
+enum TASK_PRIORITY {
+    TASK_PRIORITY_HIGH = 0,     ///< i.e. servicing playback while it runs
+    TASK_PRIORITY_NORMAL,       ///< i.e. periodic playback
+    TASK_PRIORITY_LOW           ///< i.e. logging and photos
+};
+
+/**
+ * task function, called once per slice. A task which can't finish within its budget should do a part of its work per call (i.e. one
+ * step of a state machine) and return false, it is then called again in a following window.
+ * @return true once task is done, false if task needs another slice
+ */
+typedef bool (*taskFunction)(void);
+
+/**
+ * runtime statistics of a single task
+ */
+struct taskStats {
+    const char *name;       ///< name of task
+    uint32_t runs;          ///< number of slices run
+    uint32_t completions;   ///< number of times task returned true
+    uint32_t totalTime;     ///< total time of all slices (microseconds)
+    uint32_t maxTime;       ///< longest slice (microseconds)
+    uint32_t overruns;      ///< number of slices which took longer than budget of task
+    uint32_t deferrals;     ///< number of windows in which task was pending but did not fit in slack
+    uint32_t forced;        ///< number of slices run without enough slack after TASK_MAX_DEFERRALS deferrals in a row
+};
+
+/**
+ * run-to-completion scheduler for work which is done in between windows of audio input (logging, photos, periodic playback...). run()
+ * is called once per window after the window was processed, and runs pending tasks by priority as long as their budget fits in the
+ * remaining slack (time until the next window is sampled), so tasks do not cause audio input to be discarded. Tasks are made pending
+ * periodically (interval) or by trigger() (deferred work). A task which did not fit is deferred to a following window, unless it was
+ * deferred TASK_MAX_DEFERRALS windows in a row, in which case it is run anyway so it can't be starved.
+ */
+class TaskScheduler
+{
+    private:
+        struct task {
+            taskFunction function;      ///< function called per slice
+            TASK_PRIORITY priority;     ///< priority of task
+            uint32_t interval;          ///< time between periodic runs (microseconds), 0 if task only runs when triggered
+            uint32_t budget;            ///< worst case time of a single slice (microseconds), raised to the longest slice measured
+            uint32_t lastStart;         ///< micros() when task was last made pending
+            uint16_t deferCount;        ///< number of consecutive windows task was deferred
+            bool pending;               ///< true if task is waiting to run or is between slices
+            bool enabled;               ///< false if periodic runs are paused
+            taskStats stats;            ///< runtime statistics
+        };
+
+        task tasks[TASK_MAX_TASKS];
+        uint8_t numTasks;
+        uint32_t margin;                ///< slack kept free in every window (microseconds)
+        const char *longestSlice;       ///< name of task with the longest slice of last run(), NULL if no slice was run
+        uint32_t longestSliceTime;      ///< duration of longest slice of last run() (microseconds)
+
+    public:
+        /**
+         * constructor for TaskScheduler
+         * @param margin slack kept free in every window for jitter of ISR and loop (microseconds)
+         */
+        TaskScheduler(uint32_t margin);
+
+        /**
+         * adds a task to scheduler
+         * @param name name of task, must remain valid (i.e. a string literal)
+         * @param function task function
+         * @param priority TASK_PRIORITY of task
+         * @param interval time between periodic runs (microseconds), 0 if task only runs when triggered
+         * @param budget worst case time of a single slice (microseconds), a slice which takes longer raises the budget to its time, so
+         * the budget follows the longest slice measured (taskStats.maxTime) and slices are only started if it fits in slack
+         * @return id of task, -1 if TASK_MAX_TASKS tasks were already added
+         */
+        int8_t addTask(const char *name, taskFunction function, TASK_PRIORITY priority, uint32_t interval, uint32_t budget);
+
+        /**
+         * makes a task pending, it runs in the next window with enough slack
+         * @param id id returned by addTask()
+         */
+        void trigger(int8_t id);
+
+        /**
+         * pauses or resumes periodic runs of a task (a pending task still runs to completion)
+         * @param id id returned by addTask()
+         * @param enabled false to pause periodic runs
+         */
+        void setEnabled(int8_t id, bool enabled);
+
+        /**
+         * checks if a task is pending (waiting to run or between slices)
+         * @param id id returned by addTask()
+         * @return true if task is pending
+         */
+        bool isPending(int8_t id);
+
+        /**
+         * restarts interval of all periodic tasks, i.e. after audio input was stopped for a long time
+         * @param now current time (micros())
+         */
+        void restartIntervals(uint32_t now);
+
+        /**
+         * runs pending tasks which fit in slack, called once per window after the window was processed
+         * @param windowStart micros() when current window was read from audio input buffer (the next window is due WINDOW_DEADLINE later)
+         * @param deadline time available per window (microseconds)
+         * @return number of slices run
+         */
+        uint8_t run(uint32_t windowStart, uint32_t deadline);
+
+        /**
+         * get name of task with the longest slice run by last run(), i.e. for attributing discarded input samples to a task
+         * @return name of task, NULL if no slice was run
+         */
+        const char *getLongestSlice(void);
+
+        /**
+         * get duration of longest slice run by last run()
+         * @return duration of slice (microseconds), 0 if no slice was run
+         */
+        uint32_t getLongestSliceTime(void);
+
+        /**
+         * get runtime statistics of a task
+         * @param id id returned by addTask()
+         * @return pointer to statistics, NULL if id is not valid
+         */
+        const taskStats *getStats(int8_t id);
+
+        /**
+         * get number of added tasks
+         * @return number of tasks
+         */
+        uint8_t getNumTasks(void);
+
+        /**
+         * prints one line of statistics per task (runs, completions, average and maximum slice time, overruns, deferrals)
+         * @param output Serial or an open file (i.e. LOG.TXT)
+         */
+        void printStats(Print &output);
+
+        /**
+         * clears statistics of all tasks
+         */
+        void resetStats(void);
+
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TEMPLATE_FILE_h
+#define TEMPLATE_FILE_h
+
+#include <stdint.h>
+#include "Checksum.h"
+
+#define TEMPLATE_FILE_MAGIC 0x54505050UL    ///< "PPPT" stored little-endian at the start of a binary template file
+#define TEMPLATE_FILE_VERSION 2             ///< incremented whenever the layout of templateFileHeader changes
+
+/**
+ * header of a binary template file (i.e. "TEMPS/BMSB.BIN"). The header is followed by numRows * numCols uint16_t values stored
+ * in the same layout as the correlation template buffer (value of bin f in window t is stored at f + t * numRows). Values are
+ * already scaled by the frequency width, and the square root of the sum squared of the template (within the frequency range)
+ * is precomputed, so the file can be passed to CrossCorrelation as is.
+ * @note this header is shared with the host template converter (see Utilities/TemplateConverter.cpp), do not include Arduino headers here
+ */
+struct templateFileHeader {
+    uint32_t magic;                 ///< must be equal to TEMPLATE_FILE_MAGIC
+    uint16_t version;               ///< must be equal to TEMPLATE_FILE_VERSION
+    uint16_t headerSize;            ///< size of this header in bytes
+    uint16_t sampleRate;            ///< sample rate of template
+    uint16_t windowSize;            ///< window size of template
+    uint16_t numRows;               ///< number of rows (frequency bins) in template
+    uint16_t numCols;               ///< number of columns (windows) in template
+    uint16_t frequencyRangeLow;     ///< start frequency used for computing templateSqrtSumSq
+    uint16_t frequencyRangeHigh;    ///< end frequency used for computing templateSqrtSumSq
+    uint32_t sourceHash;            ///< FNV-1a hash of the text template this file was generated from, used to detect a stale binary file
+    uint32_t templateSqrtSumSq;     ///< precomputed square root of the sum squared of the template
+    uint32_t checksum;              ///< FNV-1a hash of the template data following the header
+};
+
+#endif
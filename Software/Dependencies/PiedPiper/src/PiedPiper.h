@@ -9,7 +9,17 @@
 #include "PiedPiperSettings.h"
 #include "Devices/Peripherals.h"
 #include "Other/OperationManager.h"
+#include "Other/MemoryArena.h"
+#include "Other/TemplateFile.h"
+#include "Other/AdpcmCodec.h"
+#include "Other/Checksum.h"
+#include "Other/Profiler.h"
+#include "Other/DeadlineMonitor.h"
+#include "Other/TaskScheduler.h"
+#include "Other/AudioStream.h"
 #include "DataProcessing/DataProcessing.h"
+#include "DataProcessing/SincFilter.h"
+#include "DataProcessing/Resampler.h"
 
 const uint16_t ADC_MAX = (1 << ADC_RESOLUTION) - 1; ///< Maximum write value of ADC
 const uint16_t DAC_MAX = (1 << DAC_RESOLUTION) - 1; ///< Maximum write value of DAC
@@ -27,19 +37,104 @@ const float FREQ_WIDTH = float(FFT_WINDOW_SIZE) / FFT_SAMPLE_RATE;          ///<
 const uint16_t AUD_IN_SAMPLE_DELAY_TIME = 1000000 / SAMPLE_RATE;            ///< Delay between audio input samples
 const uint16_t AUD_OUT_SAMPLE_DELAY_TIME = 1000000 / AUD_OUT_SAMPLE_RATE;   ///< Delay between audio output samples
 
+const uint32_t WINDOW_DEADLINE = uint32_t(FFT_WINDOW_SIZE) * 1000000 / FFT_SAMPLE_RATE;  ///< time available for processing a window of audio input (microseconds)
+
 /**
- * States which the sampling ISR can be in
+ * States which audio streaming (see AudioStream) can be in
  */
 enum AUD_STATE {
-    AUD_STOP = 0,   ///< Audio stopped, ISR detached
-    AUD_IN,         ///< Audio input only, ISR runs RecordSample()
-    AUD_OUT,        ///< Audio output only, ISR runs OutputSample()
-    AUD_IN_OUT      ///< Audio input and output, ISR runs RecordAndOutputSample()
+    AUD_STOP = 0,   ///< Audio stopped
+    AUD_IN,         ///< Audio input only, blocks are processed by RecordBlock()
+    AUD_OUT,        ///< Audio output only, blocks are generated by OutputBlock()
+    AUD_IN_OUT      ///< Audio input and output, blocks are processed by RecordBlockAtOutputRate() and OutputBlock() (or raw callbacks)
+};
+
+/**
+ * Methods used by PiedPiperMonitor::preAmpGainCalibration() for finding the digital pot wiper value
+ */
+enum PREAMP_CALIBRATION_MODE {
+    PREAMP_CALIBRATION_SEARCH = 0,  ///< binary search over wiper values, plays the whole calibration sound per step
+    PREAMP_CALIBRATION_MODEL        ///< fits a linear gain curve to two short measurements and jumps to the target wiper value
+};
+
+/**
+ * Methods used by PiedPiperBase::impulseResponseCalibration() for measuring the frequency response of audio output
+ */
+enum IMPULSE_RESPONSE_MODE {
+    IMPULSE_RESPONSE_REPEATED = 0,  ///< plays and records one impulse at a time with a delay between recordings, frequency responses are averaged
+    IMPULSE_RESPONSE_SEQUENCE       ///< plays a sequence of impulses in one continuous recording, recordings are averaged in time domain
+};
+
+/**
+ * Formats of playback sounds
+ */
+enum PLAYBACK_FORMAT {
+    PLAYBACK_PCM = 0,   ///< 16-bit unsigned samples which are written to DAC as is
+    PLAYBACK_ADPCM      ///< 4-bit IMA-ADPCM codes which are decoded during playback
+};
+
+/**
+ * Methods used by the detection loop for removing noise from magnitudes of a window
+ */
+enum NOISE_REMOVAL_MODE {
+    NOISE_REMOVAL_ATM = 0,          ///< NoiseRemoval_ATM(), noise is estimated from neighbouring bins of the window
+    NOISE_REMOVAL_CFAR,             ///< NoiseRemoval_CFAR(), noise is estimated from neighbouring bins of the window
+    NOISE_REMOVAL_FLOOR_EWMA,       ///< NoiseFloorTracker (NOISE_FLOOR_EWMA), noise floor of each bin is tracked across windows
+    NOISE_REMOVAL_FLOOR_MIN_STATS   ///< NoiseFloorTracker (NOISE_FLOOR_MIN_STATS), noise floor of each bin is tracked across windows
+};
+
+/**
+ * detection algorithm settings, loaded from settings file by loadSettings(...) (defaults are used for settings missing from file)
+ */
+struct detectionSettings {
+    float correlationThreshold = 0.8;       ///< positive correlation threshold ("correlation_thresh")
+    uint16_t correlationCount = 8;          ///< number of positive correlations to be considered a detection ("correlation_count")
+    uint32_t correlationMaxInterval = 5000000;  ///< maximum time between positive correlations (in microseconds) before correlation count is reset ("correlation_interval")
+    uint8_t noiseRemovalSize = 4;           ///< number of adjacent samples used for computing sample deviation ("noise_size")
+    float noiseRemovalThreshold = 2.75;     ///< minimum sample deviation, samples below this deviation are considered noise ("noise_thresh")
+    WINDOW_TYPE windowType = WINDOW_TYPE::WINDOW_RECTANGULAR;  ///< window applied to audio input before FFT, templates must be made with the same window ("window_type")
+    MAGNITUDE_MODE magnitudeMode = MAGNITUDE_MODE::MAGNITUDE_EXACT;  ///< measure of magnitude used by noise removal, smoothing and correlation ("magnitude_mode")
+    float modeCorrelationThreshold = 0;     ///< positive correlation threshold replacing correlationThreshold for MAGNITUDE_POWER and MAGNITUDE_LOG2, which shift correlation coefficients so the exact magnitude threshold doesn't carry over, required by these modes (0 = not set) ("mode_thresh")
+    NOISE_REMOVAL_MODE noiseRemovalMode = NOISE_REMOVAL_MODE::NOISE_REMOVAL_ATM;   ///< noise removal method ("noise_mode")
+    float noiseFloorSmoothing = 0.05;       ///< weight of newest window in noise floor tracking ("floor_smoothing")
+    float noiseFloorOverSubtraction = 1.5;  ///< multiplier of noise floor subtracted from magnitudes ("floor_oversub")
+    uint16_t noiseFloorSubWindow = 32;      ///< number of windows per sub-window of minimum statistics noise floor ("floor_subwindow")
+    uint8_t timeSmoothing = 2;              ///< number of FFT windows used for averaging spectrogram data in time axis ("time_smoothing")
+    uint8_t freqSmoothing = 1;              ///< number of adjacent frequency domain magnitudes used for frequency smoothing ("freq_smoothing")
+    uint16_t templateLength = 13;           ///< length of correlation template in windows ("template_length")
+    uint16_t frequencyRangeLow = 50;        ///< start frequency of correlation in Hz ("freq_low")
+    uint16_t frequencyRangeHigh = 110;      ///< end frequency of correlation in Hz ("freq_high")
+    uint8_t recTime = 8;                    ///< length of processed frequency buffer in seconds ("rec_time")
+    uint8_t rawRecTime = 10;                ///< length of raw samples buffer (pre-trigger history saved on detection) in seconds ("raw_rec_time")
+    bool bandOnlyHistory = true;            ///< processed frequency buffer only stores bins within correlation frequency range ("band_only")
+    bool degradeOnOverload = true;          ///< detection stages are skipped while windows miss their deadline, see DeadlineMonitor ("deadline_degrade")
+    bool echoCancellation = false;          ///< echo of playback sound is removed from audio input, so detection continues during playback, see EchoCanceller ("echo_cancel")
+    uint8_t channelVotes = 1;               ///< number of audio input channels which must reach correlation count within correlation interval to be considered a detection ("channel_votes")
+};
+
+#define CALIBRATION_FILE_MAGIC 0x4C435050UL  ///< "PPCL" stored little-endian at the start of a calibration cache file
+#define CALIBRATION_FILE_VERSION 1          ///< incremented whenever the layout of calibrationFileHeader changes
+
+/**
+ * header of a calibration cache file (i.e. "CAL.BIN"), followed by filterLength floats of the flattening filter computed by
+ * impulseResponseCalibration(...)
+ */
+struct calibrationFileHeader {
+    uint32_t magic;                 ///< must be equal to CALIBRATION_FILE_MAGIC
+    uint16_t version;               ///< must be equal to CALIBRATION_FILE_VERSION
+    uint16_t headerSize;            ///< size of this header in bytes
+    uint32_t soundHash;             ///< hash of calibration sound used for calibration (see getSoundHash())
+    uint32_t timestamp;             ///< unix time at which calibration was performed
+    int16_t wiperValue;             ///< preamp digital pot wiper value, -1 if preamp was not calibrated
+    uint16_t verificationPeak;      ///< peak amplitude of verification playback at wiperValue, used for checking drift
+    uint16_t filterLength;          ///< number of flattening filter coefficients following header
+    uint16_t reserved;              ///< unused, set to 0
+    uint32_t checksum;              ///< FNV-1a hash of flattening filter coefficients
 };
 
 /**
  * Pied Piper Base is the base class of Pied Piper Monitor and Playback. This class contains functions and data structures which are 
- * relevant to all child classes, such as loading and writing data to and SD card, initializing timer interrupt for sampling
+ * relevant to all child classes, such as loading and writing data to and SD card, streaming audio input and output
  * or outputting a signals, etc.
  * @note hardware configuration used for child classes may differ!
 */
@@ -47,15 +142,75 @@ class PiedPiperBase
 {
 
     protected:
-        static uint16_t PLAYBACK_FILE[SAMPLE_RATE * PLAYBACK_FILE_LENGTH];  ///< stores samples for audio playback, these can be manually inserted via member functions or loaded from SD card with loadSound(...)
+        static uint16_t PLAYBACK_FILE[SAMPLE_RATE * PLAYBACK_FILE_LENGTH];  ///< stores samples for audio playback, these can be manually inserted via member functions or loaded from SD card with loadSound(...), IMA-ADPCM sounds are stored as packed 4-bit codes
 
         static uint16_t PLAYBACK_FILE_SAMPLE_COUNT;                         ///< stores the number of samples in PLAYBACK_FILE, meaning that the PLAYBACK_FILE can contain any number of samples as long as it is less than or equal to SAMPLE_RATE * PLAYBACK_FILE_LENGTH
 
-        static void RESET_PLAYBACK_FILE_INDEX(void);                        ///< sets the playback file index to 0, meaing the next sample to be played is the first sample in PLAYBACK_FILE
+        static void RESET_PLAYBACK_FILE_INDEX(void);                        ///< sets the playback file index to 0, meaing the next sample to be played is the first sample in PLAYBACK_FILE (or rewinds the playback stream)
+
+        static void INVALIDATE_PLAYBACK_FILE(void);                         ///< marks PLAYBACK_FILE as no longer holding the last sound loaded by loadSound(...) and closes playback stream, must be called whenever PLAYBACK_FILE is modified directly
 
     private:
 
-        static AUD_STATE audState;  ///< stores state of sampling timer ISR
+        static AUD_STATE audState;  ///< stores state of audio streaming
+
+        static char loadedSoundFilename[32];    ///< directory of sound file currently stored in PLAYBACK_FILE, empty if PLAYBACK_FILE was modified directly
+        static uint32_t loadedSoundSize;        ///< size (in bytes) of sound file currently stored in PLAYBACK_FILE
+        static uint32_t loadedSoundHash;        ///< FNV-1a hash of sound data currently stored in PLAYBACK_FILE
+
+        /**
+         * sets format of sound stored in PLAYBACK_FILE
+         * @param format PLAYBACK_FORMAT of sound
+         * @param initialState decoder state at first sample of IMA-ADPCM sound
+         */
+        static void setPlaybackFileFormat(PLAYBACK_FORMAT format, adpcmState initialState);
+
+        /**
+         * computes flattening filter from inverse frequency response: the time domain signal is windowed with a cosine window and
+         * normalized so that the sum of the filter is 1.0
+         * @param inverseResponse inverse frequency response (WINDOW_SIZE values), overwritten by its IFFT
+         */
+        static void computeFlatteningFilter(complex *inverseResponse);
+
+        /**
+         * checks if all samples of playback sound were passed to OutputBlock(), unlike isPlaybackComplete() samples which are still queued
+         * for output are not waited for
+         * @return true if nextPlaybackSample() has no samples left
+         */
+        static bool playbackSamplesComplete(void);
+
+        /**
+         * wake condition of performPlayback(), true once playback is complete or a playback stream buffer needs refilling
+         * @return true if performPlayback() needs to stop waiting
+         */
+        static bool playbackNeedsService(void);
+
+        /**
+         * IMPULSE_RESPONSE_SEQUENCE mode of impulseResponseCalibration()
+         * @param responseAveraging number of impulses averaged
+         */
+        void impulseSequenceCalibration(uint8_t responseAveraging);
+
+        /**
+         * opens a sound file which does not fit in PLAYBACK_FILE for streaming, and fills both playback stream buffers
+         * @param filename char array containing directory of sound file
+         * @param sampleCount number of samples in sound file
+         * @param dataOffset offset of first sample (or IMA-ADPCM code) in file
+         * @param format PLAYBACK_FORMAT of sound, IMA-ADPCM sounds are decoded when playback stream buffers are refilled
+         * @param initialState decoder state at first sample of IMA-ADPCM sound
+         * @return False on failure
+         */
+        static bool openPlaybackStream(char *filename, uint32_t sampleCount, uint32_t dataOffset, PLAYBACK_FORMAT format, adpcmState initialState);
+        /**
+         * seeks to start of playback stream and fills both playback stream buffers
+         */
+        static void rewindPlaybackStream(void);
+
+        /**
+         * gets the next sample to be played from PLAYBACK_FILE (decoding IMA-ADPCM sounds) or from playback stream buffers
+         * @return next sample of playback sound, DAC_MID if playback stream buffers ran empty
+         */
+        static uint16_t nextPlaybackSample(void);
 
         /**
          * sets pinMode() for all pins in use
@@ -63,35 +218,54 @@ class PiedPiperBase
         void configurePins(void);
         
         /**
-         * calculates sinc filter table for resampling input signal
+         * downsamples a block of audio input and stores each channel to its window of AUD_IN_BUFFER, samples which do not fit are counted
+         * as overruns
+         * @param samples raw samples at SAMPLE_RATE, AUD_IN_CHANNELS interleaved samples (one per channel) per sample period
+         * @param count number of sample periods, at most AUDIO_STREAM_BLOCK_SIZE
+         * @param reference flattened playback samples output while samples were recorded (echo reference), NULL if there is no output
          */
-        static void calculateDownsampleSincFilterTable(void);
+        static void recordBlock(const uint16_t *samples, uint16_t count, const uint16_t *reference);
         /**
-         * calculates sinc filter table for resampling output signal
+         * AudioStream input callback at SAMPLE_RATE, records/resamples a block and stores to AUD_IN_BUFFER
          */
-        static void calculateUpsampleSincFilterTable(void);
-
+        static void RecordBlock(uint16_t *block, uint16_t count);
         /**
-         * sets delta spike as flattening filter in case impulse response is not or cannot be calculated
+         * AudioStream input callback at AUD_OUT_SAMPLE_RATE, takes the last AUD_IN_CHANNELS samples of every AUD_OUT_UPSAMPLE_RATIO
+         * samples of block and runs recordBlock()
          */
-        static void generateImpulse(void);
-
+        static void RecordBlockAtOutputRate(uint16_t *block, uint16_t count);
         /**
-         * records/resamples a single sample and stores to AUD_IN_BUFFER
+         * AudioStream output callback at AUD_OUT_SAMPLE_RATE, flattens/resamples samples from PLAYBACK_FILE (or playback stream)
          */
-        static void RecordSample(void);
+        static void OutputBlock(uint16_t *block, uint16_t count);
         /**
-         * outputs/resamples a single sample from PLAYBACK_BUFFER
+         * AudioStream input callback at SAMPLE_RATE, records a block of raw samples (no resampling is done)
          */
-        static void OutputSample(void);
+        static void RecordRawBlock(uint16_t *block, uint16_t count);
         /**
-         * runs RecordSample() and OutputSample() together
+         * AudioStream output callback at SAMPLE_RATE, outputs a block of raw samples from PLAYBACK_FILE (no resampling is done)
          */
-        static void RecordAndOutputSample(void);
+        static void OutputRawBlock(uint16_t *block, uint16_t count);
+
         /**
-         * records/outputs a single raw sample (no resampling is done)
+         * starts audio output only, used by performPlayback()
          */
-        static void RecordAndOutputRawSample(void);
+        static void startAudioOutput(void);
+
+        /**
+         * loads a binary template file from SD card and sets it as template for correlation
+         * @param filename char array containing directory of binary template file (i.e. "TEMPS/BMSB.BIN")
+         * @param sourceHash fnv1aHash() of the text template file (0 if it does not exist), used to detect a stale binary file
+         * @return False if file is missing, stale, corrupted or does not match the requested template configuration
+         */
+        bool loadTemplateBinary(char *filename, uint32_t sourceHash, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
+        /**
+         * writes template data which has already been set for correlation to a binary template file on SD card
+         * @param filename char array containing directory of binary template file
+         * @param sourceHash fnv1aHash() of the text template file the data was loaded from
+         * @return False on failure
+         */
+        bool writeTemplateBinary(char *filename, uint32_t sourceHash, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
 
     public:
     
@@ -102,8 +276,7 @@ class PiedPiperBase
 
         Adafruit_NeoPixel indicator = Adafruit_NeoPixel(1, 8, NEO_GRB + NEO_KHZ800);    ///< LED indicator on M4 Express
 
-        static TimerInterruptController TimerInterrupt;         ///< Object for controlloring timer interrupt
-        SleepController SleepControl;                           ///< Object for putting MCU to sleep
+        static SleepController SleepControl;                    ///< Object for putting MCU to sleep, also idles CPU while waiting for audio input or playback
         WDTController WDTControl;                               ///< WatchDog timer for resetting board in case there is an issue 
         OperationManager OperationMan;                          ///< Object for setting operation and checking which state device should be in
 
@@ -115,9 +288,12 @@ class PiedPiperBase
         char playbackFilename[32];          ///< stroes directory of playback file
         char templateFilename[32];          ///< stores directory of correlation template file
         char operationTimesFilename[32];    ///< stores directory of operation times file
+        uint32_t playbackInterval = 900;    ///< time between periodic playbacks within operation intervals in seconds, at most 4294 ("playback_interval")
+
+        detectionSettings detection;        ///< detection algorithm settings
 
         /**
-         * sets pinMode() on all pins in use, runs preliminary calculations such as sinc filter tables, and initializes timer
+         * sets pinMode() on all pins in use, runs preliminary calculations such as flattening filter
          */
         virtual void init(void);
 
@@ -128,32 +304,119 @@ class PiedPiperBase
         void HYPNOS_5VR_OFF(void);
 
         /**
-         * attaches RecordSample() to timer ISR
+         * starts streaming audio input at SAMPLE_RATE (RecordBlock())
          */
         static void startAudioInput(void);
         /**
-         * attaches RecordAndOutputSample() to timer ISR
+         * starts streaming audio input and output at AUD_OUT_SAMPLE_RATE (RecordBlockAtOutputRate() and OutputBlock())
          */
         static void startAudioInputAndOutput(void);
         /**
-         * attaches RecordAndOutputRawSample to timer ISR
+         * starts streaming raw audio input and output at SAMPLE_RATE (RecordRawBlock() and OutputRawBlock())
          */
         static void startRawAudioInputAndOutput(void);
         /**
-         * detaches ISR from timer
+         * stops audio streaming, the last output value is held
          */
         static void stopAudio(void);
 
         /**
-         * performs a single playback of ALL samples stored in PLAYBACK_FILE
+         * performs a single playback of ALL samples stored in PLAYBACK_FILE (or playback stream), the playback stream is refilled while waiting,
+         * otherwise the CPU idles until playback is complete
          */
         static void performPlayback(void);
 
+        /**
+         * starts a single playback of ALL samples stored in PLAYBACK_FILE (or playback stream) alongside audio input and returns immediately,
+         * unlike performPlayback() audio input keeps running. servicePlaybackStream() must be called once per window while playback runs, and
+         * startAudioInput() once isPlaybackComplete() returns true
+         */
+        static void startPlayback(void);
+
+        /**
+         * refills at most one empty playback stream buffer from SD card, this should be called at least once per PLAYBACK_STREAM_BUFFER_SIZE
+         * samples while a streamed sound is playing (i.e. once per window in the detection loop while playback runs alongside audio input)
+         * @return true if a buffer was refilled
+         * @note SD card must remain on while a streamed sound is playing
+         */
+        static bool servicePlaybackStream(void);
+
+        /**
+         * closes playback stream, playback will use PLAYBACK_FILE afterwards. Must be called before SD card is powered off, a streamed sound
+         * is opened again by loadSound()
+         */
+        static void closePlaybackStream(void);
+
+        /**
+         * checks if playback sound was loaded for streaming from SD card rather than to PLAYBACK_FILE
+         * @return true if playback is streamed
+         */
+        static bool isPlaybackStreaming(void);
+
+        /**
+         * get format of sound being played
+         * @return PLAYBACK_FORMAT of playback stream if playback is streamed, otherwise of sound stored in PLAYBACK_FILE
+         */
+        static PLAYBACK_FORMAT getPlaybackFormat(void);
+
+        /**
+         * checks if all samples of playback sound have been played
+         * @return true if playback is complete
+         */
+        static bool isPlaybackComplete(void);
+
+        /**
+         * get number of samples which were replaced with silence since playback stream buffers were not refilled in time
+         * @return number of playback stream underruns (in samples) since playback stream was last opened
+         */
+        static uint32_t getPlaybackStreamUnderruns(void);
+
+        /**
+         * get number of input samples which were discarded since audio input buffer was not emptied in time (see audioInputBufferFull())
+         * @return number of discarded samples (at SAMPLE_RATE) since last call or since audio input was last started
+         */
+        static uint32_t getAudioInputOverruns(void);
+
         /**
          * calculates a filter to flatten frequency response of audio output by sampling a series of impulses produced by vibration exciter through substrate
          * @param responseAveraging number of impulses used for calculating frequency response
+         * @param mode IMPULSE_RESPONSE_SEQUENCE plays all impulses (one WINDOW_SIZE apart) in one recording and computes a regularized inverse
+         * (IMPULSE_RESPONSE_REGULARIZATION), number of impulses is limited by size of PLAYBACK_FILE
+         */
+        void impulseResponseCalibration(uint8_t responseAveraging = 1, IMPULSE_RESPONSE_MODE mode = IMPULSE_RESPONSE_MODE::IMPULSE_RESPONSE_REPEATED);
+
+        /**
+         * sets delta spike as flattening filter in case impulse response is not or cannot be calculated
+         */
+        static void generateImpulse(void);
+
+        /**
+         * get echo path from audio output (see getEchoReference()) to audio input measured by the last IMPULSE_RESPONSE_SEQUENCE calibration,
+         * used for seeding an EchoCanceller
+         * @param response float array of FFT_WINDOW_SIZE values for storing impulse response at FFT_SAMPLE_RATE
+         * @return false if no impulse response was measured since power up (i.e. calibration was loaded from cache)
+         */
+        static bool getEchoPathResponse(float *response);
+
+        /**
+         * loads a calibration cache file from SD card, and restores the flattening filter if the cache is valid
+         * @param filename char array containing directory of calibration cache file (i.e. "CAL.BIN")
+         * @param soundHash hash of calibration sound, the cache is rejected if it was computed using a different calibration sound
+         * @param header reference to calibrationFileHeader for storing details of cached calibration (timestamp, wiper value, verification peak)
+         * @return False if cache file is missing, corrupted or was computed using a different calibration sound
+         * @note checking age of calibration and drift of preamp gain is up to the user, call generateImpulse() if the cache is rejected afterwards
          */
-        void impulseResponseCalibration(uint8_t responseAveraging = 1);
+        bool loadCalibration(char *filename, uint32_t soundHash, calibrationFileHeader &header);
+        /**
+         * writes the current flattening filter along with calibration details to a calibration cache file on SD card
+         * @param filename char array containing directory of calibration cache file (i.e. "CAL.BIN")
+         * @param soundHash hash of calibration sound used for calibration
+         * @param timestamp unix time of calibration
+         * @param wiperValue preamp digital pot wiper value, -1 if preamp was not calibrated
+         * @param verificationPeak peak amplitude of verification playback at wiperValue
+         * @return False on failure
+         */
+        bool saveCalibration(char *filename, uint32_t soundHash, uint32_t timestamp, int16_t wiperValue, uint16_t verificationPeak);
 
         /**
          * Continously flashes NeoPixel LED red and resets the MCU using WDT
@@ -167,17 +430,40 @@ class PiedPiperBase
         /**
          * loads a settings file from SD card
          * @param filename char array containing directory of settings file (i.e. "SETTINGS.txt")
-         * @return False on failure
+         * @return False on failure, or if detection settings are out of range (default detection settings are used instead)
          * @note see SD template for an example of settings file structure
          */
         bool loadSettings(char *filename);
         /**
-         * loads playback sound from SD card
+         * loads playback sound from SD card, the file is read in SD_SECTOR_SIZE chunks directly into PLAYBACK_FILE. Loading is skipped if
+         * the same file (same directory and size) is already stored in PLAYBACK_FILE. Sounds longer than PLAYBACK_FILE_LENGTH are opened for
+         * streaming instead, in which case this must be called again after SD card has been restarted. Both raw and IMA-ADPCM playback files
+         * are supported, IMA-ADPCM sounds take up a quarter of the space in PLAYBACK_FILE
          * @param filename char array containing directory of sound file (i.e. "PBAUD/BMSB.PAD")
-         * @return False on failure
-         * @note see Documentation for instructions on formatting a playback sound
+         * @return False on failure, including files which are empty or contain values outside of DAC range
+         * @note see Documentation for instructions on formatting a playback sound, and Utilities/AudioFileConverter.cpp for IMA-ADPCM sounds
          */
         bool loadSound(char *filename);
+        /**
+         * starts loading a playback sound from SD card, the sound is then read into PLAYBACK_FILE by loadSoundChunk() so loading can be
+         * spread over several windows while audio input keeps running. Sounds which are streamed (see loadSound()) or already stored in
+         * PLAYBACK_FILE are ready once this returns true (loadSoundChunk() then returns 0 right away)
+         * @param filename char array containing directory of sound file (i.e. "PBAUD/BMSB.PAD")
+         * @return False on failure, including files which are empty
+         * @note PLAYBACK_FILE holds no sound until loading is complete, SD card must remain on until then (or cancelLoadSound() is called)
+         */
+        bool beginLoadSound(char *filename);
+        /**
+         * reads a part of the sound started by beginLoadSound() into PLAYBACK_FILE
+         * @param maxSectors maximum number of SD_SECTOR_SIZE chunks read
+         * @return number of bytes left to read, 0 once the sound is loaded, -1 on failure (including values outside of DAC range)
+         */
+        int32_t loadSoundChunk(uint16_t maxSectors);
+        /**
+         * stops loading a sound started by beginLoadSound() (PLAYBACK_FILE holds no sound afterwards), must be called before SD card is
+         * powered off
+         */
+        void cancelLoadSound(void);
         /**
          * loads operation times from SD card
          * @param filename char array containing directory of operation times file (i.e. "PBINT/PBINT.txt")
@@ -194,6 +480,20 @@ class PiedPiperBase
          * @note see Documentation on instructions for creating a template
          */
         bool loadTemplate(char *filename, uint16_t *bufferPtr, uint16_t templateLength);
+        /**
+         * loads correlation template from SD card, scales it by FREQ_WIDTH and sets it as template for correlation. The binary template file
+         * with the same name (i.e. "TEMPS/BMSB.BIN" for "TEMPS/BMSB.txt") is loaded with a single block read if it exists and matches the
+         * text template, otherwise the text template is loaded and the binary template file is (re)generated for the next boot
+         * @param filename char array containing directory of text template file (i.e. "TEMPS/BMSB.txt")
+         * @param correlation CrossCorrelation object to set the template on
+         * @param bufferPtr pointer to 2d uint16_t array for storing template data
+         * @param templateLength length of template in windows
+         * @param frequencyRangeLow start frequency for correlation
+         * @param frequencyRangeHigh end frequency for correlation
+         * @return False on failure
+         * @note see Utilities/TemplateConverter.cpp for generating binary template files on a computer
+         */
+        bool loadTemplate(char *filename, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh);
 
         /**
          * this is a templated function which writes some data to an open file
@@ -208,12 +508,23 @@ class PiedPiperBase
         };
 
         /**
-         * this is a templated function which writes data stored in a circular buffer object to an open file
+         * this is a templated function which writes data stored in a circular buffer object to an open file (oldest column first)
          * @param buffer pointer to a CircularBuffer
          */
         template <typename T> void writeCircularBufferToFile(CircularBuffer<T> *buffer) {
             uint16_t _rows = buffer->getNumRows();
             uint16_t _cols = buffer->getNumCols();
+
+            // mirrored buffers store the whole history contiguously
+            if (buffer->isMirrored()) {
+                CircularBufferView<T> _view = buffer->getLatest(_cols);
+                const T *_data = _view.getData();
+                for (uint32_t i = 0; i < _view.getSize(); i++) {
+                    SDCard.data.println(_data[i], DEC);
+                }
+                return;
+            }
+
             T *_column = 0;
             for (int i = 1; i <= _cols; i++) {
                 _column = buffer->getData(i);
@@ -223,12 +534,55 @@ class PiedPiperBase
             }
         };
 
+        /**
+         * writes samples stored in a packed circular buffer to an open file (same format as writeCircularBufferToFile(CircularBuffer<T> *)),
+         * samples are unpacked while writing
+         * @param buffer pointer to a PackedCircularBuffer
+         */
+        void writeCircularBufferToFile(PackedCircularBuffer *buffer);
+
+        /**
+         * writes magnitudes stored in a circular buffer of LogQuantize() codes to an open file (same format as
+         * writeCircularBufferToFile(CircularBuffer<T> *)), magnitudes are decoded while writing
+         * @param buffer pointer to a CircularBuffer of quantized magnitudes
+         */
+        void writeLogQuantizedBufferToFile(CircularBuffer<uint8_t> *buffer);
+
         /**
          * checks if volatile input buffer was filled with samples sampled by ISR.
-         * @param bufferOtr uint16_t array with length greater than or equal to FFT_WINDOW_SIZE
+         * @param bufferPtr uint16_t array with length greater than or equal to numChannels * FFT_WINDOW_SIZE
+         * @param numChannels number of audio input channels stored to bufferPtr, window of channel c starts at c * FFT_WINDOW_SIZE
          * @return true if buffer was filled, upon which samples are stored to bufferPtr and sampling is resumed
          */
-        static bool audioInputBufferFull(uint16_t *bufferPtr);
+        static bool audioInputBufferFull(uint16_t *bufferPtr, uint8_t numChannels = 1);
+
+        /**
+         * checks if volatile input buffer was filled by ISR, without copying samples (see audioInputBufferFull())
+         * @return true if buffer is full
+         */
+        static bool audioInputReady(void);
+
+        /**
+         * idles CPU (SleepControl, IDLE_SLEEP_MODE) until volatile input buffer was filled by ISR, then stores samples to bufferPtr. Should be
+         * used instead of polling audioInputBufferFull() while audio input runs, as the CPU otherwise spins at full clock between samples
+         * @param bufferPtr uint16_t array with length greater than or equal to numChannels * FFT_WINDOW_SIZE
+         * @param numChannels number of audio input channels stored to bufferPtr (see audioInputBufferFull())
+         */
+        static void waitForAudioInput(uint16_t *bufferPtr, uint8_t numChannels = 1);
+
+        /**
+         * enables recording of echo reference, the flattened playback signal which is sent to audio output, alongside audio input. Each
+         * window of echo reference is stored when audio input buffer is emptied (see audioInputBufferFull())
+         * @param enabled true to record echo reference while audio input and output run
+         */
+        static void setEchoReferenceEnabled(bool enabled);
+
+        /**
+         * get echo reference of the last window read from audio input buffer, downsampled like audio input so each value lines up with
+         * a sample of audio input (see EchoCanceller)
+         * @param reference int16_t array with length greater than or equal to FFT_WINDOW_SIZE, DC offset is removed
+         */
+        static void getEchoReference(int16_t *reference);
 
         /**
          * get index of current sample in playback file
@@ -236,13 +590,19 @@ class PiedPiperBase
          */
         static uint16_t getPlaybackFileIndex();
 
+        /**
+         * get hash of sound stored in PLAYBACK_FILE, used for checking whether a calibration cache was computed with this sound
+         * @return FNV-1a hash of sound data loaded by loadSound(...), 0 if PLAYBACK_FILE was modified directly or sound is streamed
+         */
+        static uint32_t getSoundHash();
+
         /**
          * checks if full duration of playback file has been played, if so the playback file index is reset
          */
         static void checkResetPlaybackFileIndex();
 
         /**
-         * get the current state of sampling ISR
+         * get the current state of audio streaming
          * @return AUD_STATE enum
          * @see AUD_STATE
          */
@@ -261,6 +621,19 @@ class PiedPiperMonitor : public PiedPiperBase
 {
     private:
 
+        /**
+         * model based search for wiper value. The MCP465 is a linear pot, so the peak amplitude is modelled as a linear function of
+         * the wiper value, fitted from short measurements (PREAMP_MODEL_WINDOWS) at PREAMP_MODEL_WIPER_LOW and PREAMP_MODEL_WIPER_HIGH.
+         * The short measurements are scaled to the peak amplitude of the whole calibration sound using one full playback. After jumping
+         * to the wiper value predicted by the model, each confirmation measurement outside of the target range is corrected with a secant step.
+         * @param playbackNumWindows number of sampling windows of whole calibration sound
+         * @param calValLow lower bound of target peak amplitude
+         * @param calValHigh upper bound of target peak amplitude
+         * @param peak reference for storing last (scaled) peak amplitude measured
+         * @return wiper value within target range, -1 if model did not converge within PREAMP_MODEL_MAX_STEPS
+         */
+        int16_t preAmpGainModelSearch(uint16_t playbackNumWindows, uint16_t calValLow, uint16_t calValHigh, uint16_t &peak);
+
     public:
 
         DFRobot_SHT3x *tempSensor = NULL;               ///< pointer to DFRobot_SHT3x object defined in PiedPiperMonitor.cpp file
@@ -286,9 +659,32 @@ class PiedPiperMonitor : public PiedPiperBase
          * 
          * @param adcRange target ADC range [0, 1.0]
          * @param rangeThreshold target ADC range threshold [0, 1.0]
+         * @param mode method used for finding wiper value, PREAMP_CALIBRATION_MODEL falls back to PREAMP_CALIBRATION_SEARCH if it does not converge
          * @return true if calibration was successful
          */
-        bool preAmpGainCalibration(float adcRange, float rangeThreshold);
+        bool preAmpGainCalibration(float adcRange, float rangeThreshold, PREAMP_CALIBRATION_MODE mode = PREAMP_CALIBRATION_MODE::PREAMP_CALIBRATION_SEARCH);
+
+        /**
+         * plays the first numWindows windows of PLAYBACK_FILE at the current wiper value and finds the peak amplitude of ADC readings
+         * (with DC component removed per window)
+         * @param numWindows number of sampling windows (of FFT_WINDOW_SIZE) to measure
+         * @param initialPeak optional pointer for storing peak amplitude within the first initialWindows windows
+         * @param initialWindows number of sampling windows used for initialPeak
+         * @return peak amplitude of ADC readings
+         */
+        uint16_t measurePeakAmplitude(uint16_t numWindows, uint16_t *initialPeak = NULL, uint16_t initialWindows = 0);
+
+        /**
+         * checks whether the preamp gain has drifted since calibration by playing a short portion of the calibration sound
+         * (CALIBRATION_VERIFY_WINDOWS) at a previously calibrated wiper value, flattening filter must be the one used during calibration
+         * @param wiperValue calibrated wiper value
+         * @param verificationPeak peak amplitude returned by measurePeakAmplitude(CALIBRATION_VERIFY_WINDOWS) once calibration was completed
+         * @param driftThreshold maximum relative deviation of peak amplitude [0, 1.0]
+         * @return true if peak amplitude is within threshold, the wiper value remains written to digital pot
+         */
+        bool verifyPreAmpGain(int16_t wiperValue, uint16_t verificationPeak, float driftThreshold);
+
+        int16_t calibratedWiperValue = -1;  ///< wiper value set by last successful preAmpGainCalibration() or verifyPreAmpGain(), -1 if not calibrated
 
 
 };
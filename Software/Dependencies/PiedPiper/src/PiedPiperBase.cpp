@@ -5,12 +5,20 @@ PiedPiperBase::PiedPiperBase() {}
 // uint16_t PiedPiperBase::PLAYBACK_FILE[SAMPLE_RATE * PLAYBACK_FILE_LENGTH];
 // uint16_t PiedPiperBase::PLAYBACK_FILE_SAMPLE_COUNT;
 
+// sound being loaded into PLAYBACK_FILE by loadSoundChunk(), PLAYBACK_FILE only holds a valid sound once loading is complete
+File soundLoadFile;
+char soundLoadFilename[32] = { 0 };
+bool soundLoading = false;
+uint32_t soundLoadFileSize = 0;
+uint32_t soundLoadSampleCount = 0;
+uint32_t soundLoadDataSize = 0;
+uint32_t soundLoadBytesRead = 0;
+PLAYBACK_FORMAT soundLoadFormat = PLAYBACK_FORMAT::PLAYBACK_PCM;
+adpcmState soundLoadInitialState = { 0, 0 };
+
 void PiedPiperBase::init() {
     this->configurePins();
-    this->calculateDownsampleSincFilterTable();
-    this->calculateUpsampleSincFilterTable();
     this->generateImpulse();
-    this->TimerInterrupt.initialize();
     delay(1000);
 }
 
@@ -71,12 +79,20 @@ void PiedPiperBase::initializationSuccess() {
 bool PiedPiperBase::loadSettings(char *filename) {
     if (!SDCard.openFile(filename, FILE_READ)) return false;
 
+    // detection settings are used for sizing buffers, fall back to defaults if any setting is out of range
+    bool _valid = true;
+
     while (SDCard.data.available()) {
         String settingName = SDCard.data.readStringUntil(':');
         SDCard.data.read();
         String setting = SDCard.data.readStringUntil('\n');
         setting.trim();
 
+        // numeric settings are range checked before they are stored, so values which do not fit a setting can't wrap into valid ones
+        long _value = setting.toInt();
+        float _floatValue = setting.toFloat();
+        bool _inRange = true;
+
         // store to corresponding setting on device
         if (settingName == "calibration") {
             strcpy(this->calibrationFilename, "/PBAUD/");
@@ -90,38 +106,234 @@ bool PiedPiperBase::loadSettings(char *filename) {
         } else if (settingName == "operation") {
             strcpy(this->operationTimesFilename, "/PBINT/");
             strcat(this->operationTimesFilename, setting.c_str());
+        } else if (settingName == "playback_interval") {
+            // interval is measured with micros()
+            _inRange = _value > 0 && _value <= UINT32_MAX / 1000000;
+            if (_inRange) this->playbackInterval = _value;
+        } else if (settingName == "correlation_thresh") {
+            _inRange = _floatValue > 0 && _floatValue <= 1.0;
+            if (_inRange) this->detection.correlationThreshold = _floatValue;
+        } else if (settingName == "correlation_count") {
+            _inRange = _value > 0 && _value <= UINT16_MAX;
+            if (_inRange) this->detection.correlationCount = _value;
+        } else if (settingName == "correlation_interval") {
+            _inRange = _value > 0;
+            if (_inRange) this->detection.correlationMaxInterval = _value;
+        } else if (settingName == "noise_size") {
+            _inRange = _value > 0 && _value < FFT_WINDOW_SIZE_BY2 / 2;
+            if (_inRange) this->detection.noiseRemovalSize = _value;
+        } else if (settingName == "noise_thresh") {
+            _inRange = _floatValue >= 0;
+            if (_inRange) this->detection.noiseRemovalThreshold = _floatValue;
+        } else if (settingName == "window_type") {
+            _inRange = _value >= WINDOW_TYPE::WINDOW_RECTANGULAR && _value <= WINDOW_TYPE::WINDOW_BLACKMAN;
+            if (_inRange) this->detection.windowType = WINDOW_TYPE(_value);
+        } else if (settingName == "magnitude_mode") {
+            _inRange = _value >= MAGNITUDE_MODE::MAGNITUDE_EXACT && _value <= MAGNITUDE_MODE::MAGNITUDE_LOG2;
+            if (_inRange) this->detection.magnitudeMode = MAGNITUDE_MODE(_value);
+        } else if (settingName == "mode_thresh") {
+            _inRange = _floatValue >= 0 && _floatValue <= 1.0;
+            if (_inRange) this->detection.modeCorrelationThreshold = _floatValue;
+        } else if (settingName == "noise_mode") {
+            _inRange = _value >= NOISE_REMOVAL_MODE::NOISE_REMOVAL_ATM && _value <= NOISE_REMOVAL_MODE::NOISE_REMOVAL_FLOOR_MIN_STATS;
+            if (_inRange) this->detection.noiseRemovalMode = NOISE_REMOVAL_MODE(_value);
+        } else if (settingName == "floor_smoothing") {
+            _inRange = _floatValue > 0 && _floatValue <= 1.0;
+            if (_inRange) this->detection.noiseFloorSmoothing = _floatValue;
+        } else if (settingName == "floor_oversub") {
+            _inRange = _floatValue >= 0;
+            if (_inRange) this->detection.noiseFloorOverSubtraction = _floatValue;
+        } else if (settingName == "floor_subwindow") {
+            _inRange = _value > 0 && _value <= UINT16_MAX;
+            if (_inRange) this->detection.noiseFloorSubWindow = _value;
+        } else if (settingName == "time_smoothing") {
+            _inRange = _value > 0 && _value <= UINT8_MAX;
+            if (_inRange) this->detection.timeSmoothing = _value;
+        } else if (settingName == "freq_smoothing") {
+            _inRange = _value >= 0 && _value < FFT_WINDOW_SIZE_BY2 / 2;
+            if (_inRange) this->detection.freqSmoothing = _value;
+        } else if (settingName == "template_length") {
+            _inRange = _value > 0 && _value <= UINT16_MAX;
+            if (_inRange) this->detection.templateLength = _value;
+        } else if (settingName == "freq_low") {
+            _inRange = _value >= 0 && _value <= FFT_SAMPLE_RATE / 2;
+            if (_inRange) this->detection.frequencyRangeLow = _value;
+        } else if (settingName == "freq_high") {
+            _inRange = _value > 0 && _value <= FFT_SAMPLE_RATE / 2;
+            if (_inRange) this->detection.frequencyRangeHigh = _value;
+        } else if (settingName == "rec_time") {
+            _inRange = _value > 0 && _value <= UINT8_MAX;
+            if (_inRange) this->detection.recTime = _value;
+        } else if (settingName == "raw_rec_time") {
+            _inRange = _value > 0 && _value <= UINT8_MAX;
+            if (_inRange) this->detection.rawRecTime = _value;
+        } else if (settingName == "band_only") {
+            this->detection.bandOnlyHistory = _value != 0;
+        } else if (settingName == "deadline_degrade") {
+            this->detection.degradeOnOverload = _value != 0;
+        } else if (settingName == "echo_cancel") {
+            this->detection.echoCancellation = _value != 0;
+        } else if (settingName == "channel_votes") {
+            _inRange = _value > 0 && _value <= UINT8_MAX;
+            if (_inRange) this->detection.channelVotes = _value;
         } else continue;
+
+        if (!_inRange) {
+            Serial.printf("loadSettings() %s out of range: %s\n", settingName.c_str(), setting.c_str());
+            _valid = false;
+        }
     }
 
     SDCard.closeFile();
 
+    // settings which depend on each other are checked once all settings are read
+    detectionSettings &_d = this->detection;
+    _valid = _valid && _d.frequencyRangeLow < _d.frequencyRangeHigh;
+    _valid = _valid && _d.templateLength <= uint32_t(_d.recTime) * FFT_SAMPLE_RATE / FFT_WINDOW_SIZE;
+
+    // correlation coefficients of MAGNITUDE_POWER and MAGNITUDE_LOG2 differ from those of exact magnitudes (e.g. at 0.8 MAGNITUDE_LOG2 drops
+    // all positive windows of the synthetic golden vectors), so these modes are only used with a threshold tuned for them
+    if (_d.magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_POWER || _d.magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_LOG2) {
+        if (_d.modeCorrelationThreshold == 0) {
+            Serial.printf("loadSettings() magnitude_mode %d needs mode_thresh\n", int(_d.magnitudeMode));
+            _valid = false;
+        } else {
+            _d.correlationThreshold = _d.modeCorrelationThreshold;
+        }
+    }
+
+    if (!_valid) {
+        Serial.println("loadSettings() invalid detection settings, using defaults");
+        this->detection = detectionSettings();
+        return false;
+    }
+
     return true;
 }
 
 bool PiedPiperBase::loadSound(char *filename) {
-    if (!SDCard.openFile(filename, FILE_READ)) return false;
+    if (!this->beginLoadSound(filename)) return false;
 
-    //Serial.println("Opened file. Loading samples...");
+    int32_t _bytesRemaining;
+    do {
+        _bytesRemaining = this->loadSoundChunk(UINT16_MAX);
+    } while (_bytesRemaining > 0);
+
+    return _bytesRemaining == 0;
+}
+
+bool PiedPiperBase::beginLoadSound(char *filename) {
+    this->cancelLoadSound();
+
+    File _file = SD.open(filename, FILE_READ);
+    if (!_file) return false;
 
     // get size of playback file (in bytes)
-    int fsize = SDCard.data.size();
+    uint32_t fsize = _file.size();
+
+    // raw playback file is exported as 16-bit unsigned int, the total number of samples stored in the file is fsize / 2
+    PLAYBACK_FORMAT _format = PLAYBACK_FORMAT::PLAYBACK_PCM;
+    uint32_t _sampleCount = fsize / 2;
+    uint32_t _dataSize = _sampleCount * 2;
+    uint32_t _dataOffset = 0;
+    adpcmState _initialState = { 0, 0 };
+
+    // IMA-ADPCM playback file starts with a header, whereas a raw playback file starts with a sample which can't be equal to the magic value
+    adpcmSoundHeader _header;
+    if (fsize >= sizeof(_header) && _file.read(&_header, sizeof(_header)) == sizeof(_header) && _header.magic == ADPCM_SOUND_MAGIC) {
+        _format = PLAYBACK_FORMAT::PLAYBACK_ADPCM;
+        _sampleCount = _header.sampleCount;
+        _dataSize = (_sampleCount + 1) / 2;
+        _dataOffset = sizeof(_header);
+        _initialState.predictor = _header.predictor;
+        _initialState.stepIndex = _header.stepIndex;
+
+        if (_header.version != ADPCM_SOUND_VERSION || _header.headerSize != sizeof(_header) || _header.stepIndex > 88 || fsize < _dataOffset + _dataSize)
+            _sampleCount = 0;
+    }
 
-    // playback file is exported as 16-bit unsigned int, the total number of samples stored in the file is fsize / 2
-    PLAYBACK_FILE_SAMPLE_COUNT = fsize / 2;
+    if (_sampleCount == 0) {
+        Serial.printf("loadSound() invalid size: %d bytes\n", int(fsize));
+        _file.close();
+        return false;
+    }
 
-    for (int i = 0; i < PLAYBACK_FILE_SAMPLE_COUNT; i++) {
-        // stop reading at end of file, and ensure 2 bytes are available for reading
-        if ((2 * i) >= (fsize - 1)) break;
-        // read two bytes at a time and store to outputSampleBuffer[i]
-        SDCard.data.read(&PLAYBACK_FILE[i], 2);
-        // Serial.println(PLAYBACK_FILE[i]);
+    // sounds which do not fit in PLAYBACK_FILE are streamed from SD card during playback
+    if (_dataSize > sizeof(PLAYBACK_FILE)) {
+        _file.close();
+        return openPlaybackStream(filename, _sampleCount, _dataOffset, _format, _initialState);
     }
 
-    SDCard.closeFile();
+    closePlaybackStream();
+
+    // skip loading if the same file is still stored in PLAYBACK_FILE
+    if (fsize == loadedSoundSize && strcmp(filename, loadedSoundFilename) == 0) {
+        _file.close();
+        return true;
+    }
+
+    INVALIDATE_PLAYBACK_FILE();
+    PLAYBACK_FILE_SAMPLE_COUNT = 0;
+
+    _file.seek(_dataOffset);
+
+    soundLoadFile = _file;
+    strncpy(soundLoadFilename, filename, sizeof(soundLoadFilename) - 1);
+    soundLoadFilename[sizeof(soundLoadFilename) - 1] = 0;
+    soundLoadFileSize = fsize;
+    soundLoadSampleCount = _sampleCount;
+    soundLoadDataSize = _dataSize;
+    soundLoadBytesRead = 0;
+    soundLoadFormat = _format;
+    soundLoadInitialState = _initialState;
+    soundLoading = true;
 
     return true;
 }
 
+int32_t PiedPiperBase::loadSoundChunk(uint16_t maxSectors) {
+    if (!soundLoading) return 0;
+
+    uint8_t *_bufferPtr = (uint8_t *)PLAYBACK_FILE + soundLoadBytesRead;
+    uint16_t _bytesToRead;
+    bool _valid = true;
+
+    // read file in sector sized chunks straight into PLAYBACK_FILE
+    for (uint16_t i = 0; i < maxSectors && soundLoadBytesRead < soundLoadDataSize && _valid; i++) {
+        _bytesToRead = min(uint32_t(SD_SECTOR_SIZE), soundLoadDataSize - soundLoadBytesRead);
+        _valid = soundLoadFile.read(_bufferPtr, _bytesToRead) == _bytesToRead;
+        _bufferPtr += _bytesToRead;
+        soundLoadBytesRead += _bytesToRead;
+    }
+
+    if (_valid && soundLoadBytesRead < soundLoadDataSize) return soundLoadDataSize - soundLoadBytesRead;
+
+    this->cancelLoadSound();
+
+    // raw samples are passed to analogWrite() as is, any value outside of DAC range means this isn't a playback file
+    for (uint32_t i = 0; i < soundLoadSampleCount && _valid && soundLoadFormat == PLAYBACK_FORMAT::PLAYBACK_PCM; i++) {
+        if (PLAYBACK_FILE[i] > DAC_MAX) _valid = false;
+    }
+
+    if (!_valid) return -1;
+
+    PLAYBACK_FILE_SAMPLE_COUNT = soundLoadSampleCount;
+    setPlaybackFileFormat(soundLoadFormat, soundLoadInitialState);
+    RESET_PLAYBACK_FILE_INDEX();
+
+    strcpy(loadedSoundFilename, soundLoadFilename);
+    loadedSoundSize = soundLoadFileSize;
+    loadedSoundHash = fnv1aHash(PLAYBACK_FILE, soundLoadDataSize);
+
+    return 0;
+}
+
+void PiedPiperBase::cancelLoadSound() {
+    if (!soundLoading) return;
+    soundLoading = false;
+    soundLoadFile.close();
+}
+
 bool PiedPiperBase::loadTemplate(char *filename, uint16_t *bufferPtr, uint16_t templateLength) {
     if (!SDCard.openFile(filename, FILE_READ)) return false;
 
@@ -143,6 +355,153 @@ bool PiedPiperBase::loadTemplate(char *filename, uint16_t *bufferPtr, uint16_t t
     return true;
 }
 
+bool PiedPiperBase::loadTemplate(char *filename, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
+    char _binaryFilename[32];
+    uint8_t _chunk[SD_SECTOR_SIZE];
+    uint32_t _sourceHash = 0;
+    int _bytesRead;
+    uint16_t i;
+
+    // binary template file has the same name as text template with .BIN extension (i.e. "TEMPS/BMSB.txt" -> "TEMPS/BMSB.BIN")
+    strncpy(_binaryFilename, filename, sizeof(_binaryFilename) - 5);
+    _binaryFilename[sizeof(_binaryFilename) - 5] = 0;
+    char *_extension = strrchr(_binaryFilename, '.');
+    if (_extension != NULL) *_extension = 0;
+    strcat(_binaryFilename, ".BIN");
+
+    // hash of text template is used to check whether binary template file is stale (an edited template may keep its size)
+    if (SDCard.openFile(filename, FILE_READ)) {
+        _sourceHash = fnv1aHash(NULL, 0);
+        while ((_bytesRead = SDCard.data.read(_chunk, sizeof(_chunk))) > 0) {
+            _sourceHash = fnv1aHash(_chunk, _bytesRead, _sourceHash);
+        }
+        SDCard.closeFile();
+    }
+
+    if (loadTemplateBinary(_binaryFilename, _sourceHash, correlation, bufferPtr, templateLength, frequencyRangeLow, frequencyRangeHigh)) return true;
+
+    // falling back to text template
+    if (!loadTemplate(filename, bufferPtr, templateLength)) return false;
+
+    // scaling template values
+    for (i = 0; i < FFT_WINDOW_SIZE_BY2 * templateLength; i++) {
+        bufferPtr[i] = uint16_t(round(bufferPtr[i] * FREQ_WIDTH));
+    }
+
+    correlation.setTemplate(bufferPtr, FFT_WINDOW_SIZE_BY2, templateLength, frequencyRangeLow, frequencyRangeHigh);
+
+    // caching preprocessed template for next boot, failing to write the binary file is not an error
+    if (!writeTemplateBinary(_binaryFilename, _sourceHash, correlation, bufferPtr, templateLength, frequencyRangeLow, frequencyRangeHigh))
+        Serial.printf("writeTemplateBinary() error: %s\n", _binaryFilename);
+
+    return true;
+}
+
+bool PiedPiperBase::loadTemplateBinary(char *filename, uint32_t sourceHash, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
+    if (!SDCard.openFile(filename, FILE_READ)) return false;
+
+    templateFileHeader _header;
+    uint32_t _dataSize = uint32_t(FFT_WINDOW_SIZE_BY2) * templateLength * sizeof(uint16_t);
+
+    bool _valid = SDCard.data.read(&_header, sizeof(_header)) == sizeof(_header);
+
+    // checking that binary file matches the current template configuration, and that it was generated from the current text template
+    _valid = _valid &&
+        _header.magic == TEMPLATE_FILE_MAGIC &&
+        _header.version == TEMPLATE_FILE_VERSION &&
+        _header.headerSize == sizeof(_header) &&
+        _header.sampleRate == correlation.getSampleRate() &&
+        _header.windowSize == correlation.getWindowSize() &&
+        _header.numRows == FFT_WINDOW_SIZE_BY2 &&
+        _header.numCols == templateLength &&
+        _header.frequencyRangeLow == frequencyRangeLow &&
+        _header.frequencyRangeHigh == frequencyRangeHigh &&
+        (sourceHash == 0 || _header.sourceHash == sourceHash) &&
+        SDCard.data.size() == sizeof(_header) + _dataSize;
+
+    // reading entire template with a single block read
+    _valid = _valid && SDCard.data.read(bufferPtr, _dataSize) == int(_dataSize);
+
+    SDCard.closeFile();
+
+    if (!_valid || fnv1aHash(bufferPtr, _dataSize) != _header.checksum) return false;
+
+    correlation.setTemplate(bufferPtr, FFT_WINDOW_SIZE_BY2, templateLength, frequencyRangeLow, frequencyRangeHigh, _header.templateSqrtSumSq);
+
+    return true;
+}
+
+bool PiedPiperBase::writeTemplateBinary(char *filename, uint32_t sourceHash, CrossCorrelation &correlation, uint16_t *bufferPtr, uint16_t templateLength, uint16_t frequencyRangeLow, uint16_t frequencyRangeHigh) {
+    uint32_t _dataSize = uint32_t(FFT_WINDOW_SIZE_BY2) * templateLength * sizeof(uint16_t);
+
+    templateFileHeader _header;
+    _header.magic = TEMPLATE_FILE_MAGIC;
+    _header.version = TEMPLATE_FILE_VERSION;
+    _header.headerSize = sizeof(_header);
+    _header.sampleRate = correlation.getSampleRate();
+    _header.windowSize = correlation.getWindowSize();
+    _header.numRows = FFT_WINDOW_SIZE_BY2;
+    _header.numCols = templateLength;
+    _header.frequencyRangeLow = frequencyRangeLow;
+    _header.frequencyRangeHigh = frequencyRangeHigh;
+    _header.sourceHash = sourceHash;
+    _header.templateSqrtSumSq = correlation.getTemplateSqrtSumSq();
+    _header.checksum = fnv1aHash(bufferPtr, _dataSize);
+
+    // FILE_WRITE appends to existing files, remove stale file first
+    if (SD.exists(filename)) SD.remove(filename);
+
+    if (!SDCard.openFile(filename, FILE_WRITE)) return false;
+
+    bool _success = SDCard.data.write((uint8_t *)&_header, sizeof(_header)) == sizeof(_header);
+    _success = _success && SDCard.data.write((uint8_t *)bufferPtr, _dataSize) == _dataSize;
+
+    SDCard.closeFile();
+
+    // removing partially written file so it isn't loaded next boot
+    if (!_success) SD.remove(filename);
+
+    return _success;
+}
+
+void PiedPiperBase::writeCircularBufferToFile(PackedCircularBuffer *buffer) {
+    uint16_t _rows = buffer->getNumRows();
+    uint16_t _cols = buffer->getNumCols();
+    uint16_t _a, _b;
+    const uint8_t *_packed = NULL;
+    for (int i = 1; i <= _cols; i++) {
+        _packed = buffer->getPackedData(i);
+        for (int j = 0; j < _rows; j += 2, _packed += 3) {
+            PackedCircularBuffer::unpack(_packed, _a, _b);
+            SDCard.data.println(_a, DEC);
+            SDCard.data.println(_b, DEC);
+        }
+    }
+}
+
+void PiedPiperBase::writeLogQuantizedBufferToFile(CircularBuffer<uint8_t> *buffer) {
+    uint16_t _rows = buffer->getNumRows();
+    uint16_t _cols = buffer->getNumCols();
+
+    // mirrored buffers store the whole history contiguously
+    if (buffer->isMirrored()) {
+        CircularBufferView<uint8_t> _view = buffer->getLatest(_cols);
+        const uint8_t *_data = _view.getData();
+        for (uint32_t i = 0; i < _view.getSize(); i++) {
+            SDCard.data.println(LogDequantize(_data[i]), DEC);
+        }
+        return;
+    }
+
+    uint8_t *_column = 0;
+    for (int i = 1; i <= _cols; i++) {
+        _column = buffer->getData(i);
+        for (int j = 0; j < _rows; j++) {
+            SDCard.data.println(LogDequantize(_column[j]), DEC);
+        }
+    }
+}
+
 bool PiedPiperBase::loadOperationTimes(char *filename) {
     if (!SDCard.openFile(filename, FILE_READ)) return false;
 
@@ -169,16 +528,23 @@ bool PiedPiperBase::loadOperationTimes(char *filename) {
     return true;
 }
 
+void PiedPiperBase::startPlayback() {
+    RESET_PLAYBACK_FILE_INDEX();
+    startAudioInputAndOutput();
+}
+
 void PiedPiperBase::performPlayback() {
     stopAudio();
 
     analogWrite(PIN_AUD_OUT, DAC_MID);
     
-    audState = AUD_STATE::AUD_OUT;
-    
-    TimerInterrupt.attachTimerInterrupt(AUD_OUT_SAMPLE_DELAY_TIME, OutputSample);
+    startAudioOutput();
 
-    while (getPlaybackFileIndex() < PLAYBACK_FILE_SAMPLE_COUNT);
+    // refilling playback stream buffers while waiting (does nothing if playback sound is stored in PLAYBACK_FILE), CPU idles in between
+    while (!isPlaybackComplete()) {
+        servicePlaybackStream();
+        SleepControl.idleUntil(playbackNeedsService);
+    }
 
     stopAudio();
 
@@ -9,20 +9,20 @@ void PiedPiperMonitor::init() {
     this->tempSensor = &sht31;
 }
 
-bool PiedPiperMonitor::preAmpGainCalibration(float adcRange, float rangeThreshold) {
+bool PiedPiperMonitor::preAmpGainCalibration(float adcRange, float rangeThreshold, PREAMP_CALIBRATION_MODE mode) {
 
     // length of calibration file in windows
     uint16_t _playbackNumWindows = round(PLAYBACK_FILE_SAMPLE_COUNT / WINDOW_SIZE);
     
     // a bunch of temporary variables for digital pot adjustment
-    uint16_t _calValLow, _calValHigh, _max, _sample;
+    uint16_t _calValLow, _calValHigh, _max;
     int16_t _nextWiperValue, _nextWiperValueBy2, _lastWiperValue;
 
     uint16_t _samples[FFT_WINDOW_SIZE]; // array for storing recorded samples
 
-    uint16_t _windowCount, i;
+    this->calibratedWiperValue = -1;
 
-    uint32_t _sum;
+    uint32_t _startTime = millis();
 
     // computing calibration thresholds
     _calValLow = round(adcRange * ADC_MID) - round(rangeThreshold * ADC_MID);
@@ -47,43 +47,29 @@ bool PiedPiperMonitor::preAmpGainCalibration(float adcRange, float rangeThreshol
 
     stopAudio();
 
+    if (mode == PREAMP_CALIBRATION_MODE::PREAMP_CALIBRATION_MODEL) {
+        _nextWiperValue = preAmpGainModelSearch(_playbackNumWindows, _calValLow, _calValHigh, _max);
+
+        if (_nextWiperValue >= 0) {
+            this->calibratedWiperValue = _nextWiperValue;
+            Serial.printf("preAmpGainCalibration() wiper: %d, peak: %d, target: %d, time: %d ms\n", _nextWiperValue, _max, (_calValLow + _calValHigh) / 2, int(millis() - _startTime));
+            return true;
+        }
+
+        Serial.println("preAmpGainModelSearch() did not converge, falling back to binary search");
+        _nextWiperValue = 256;
+    }
+
     // sampling playback signal and recording peak amplitude value to adjust digital pot
     while (1) {
 
-        _max = 0;
-        _windowCount = 0;
-
         // writing next wiper value to digital pot
         if (preAmp.writeWiperValue(_nextWiperValue) > 0) Serial.println("writeWiperValue() error");
         // adding slight delay for things to stabalize
         delay(500);
 
-        RESET_PLAYBACK_FILE_INDEX();
-
-        // start audio input and output
-        startAudioInputAndOutput();
-
         // waiting for full duration of calibration sound to be completed
-        while (_windowCount < _playbackNumWindows) {
-            if (!audioInputBufferFull(_samples)) continue;
-
-            // removing DC component from recorded signal
-            _sum = 0;
-            for (i = 0; i < FFT_WINDOW_SIZE; i++) {
-                _sum += _samples[i];
-            }
-            _sum /= FFT_WINDOW_SIZE;
-
-            // finding maximum value in recorded samples
-            for (i = 0; i < FFT_WINDOW_SIZE; i++) {
-                _sample = abs(int(_samples[i]) - _sum);
-                if (_sample > _max) _max = _sample;
-            }
-
-            _windowCount += 1;
-        }
-
-        stopAudio();
+        _max = measurePeakAmplitude(_playbackNumWindows);
 
         _lastWiperValue = _nextWiperValue;
 
@@ -109,7 +95,132 @@ bool PiedPiperMonitor::preAmpGainCalibration(float adcRange, float rangeThreshol
         if (_nextWiperValue == _lastWiperValue) return false;
 
     }
+
+    this->calibratedWiperValue = _nextWiperValue;
+    Serial.printf("preAmpGainCalibration() wiper: %d, peak: %d, target: %d, time: %d ms\n", _nextWiperValue, _max, (_calValLow + _calValHigh) / 2, int(millis() - _startTime));
+
     // return true on success
     return true;
 
-}
\ No newline at end of file
+}
+
+int16_t PiedPiperMonitor::preAmpGainModelSearch(uint16_t playbackNumWindows, uint16_t calValLow, uint16_t calValHigh, uint16_t &peak) {
+    // last two measurements (wiper value, peak amplitude scaled to whole calibration sound) used for fitting gain curve
+    float _wiper[2] = { PREAMP_MODEL_WIPER_LOW, PREAMP_MODEL_WIPER_HIGH };
+    float _amplitude[2];
+    float _target = 0.5 * (calValLow + calValHigh);
+    float _scale, _slope;
+
+    uint16_t _initialPeak = 0;
+    int16_t _wiperValue;
+
+    // playing whole calibration sound once, the ratio of its peak to the peak of the first PREAMP_MODEL_WINDOWS windows is used to
+    // scale all following short measurements
+    if (preAmp.writeWiperValue(_wiper[0]) > 0) Serial.println("writeWiperValue() error");
+    delay(500);
+
+    _amplitude[0] = measurePeakAmplitude(playbackNumWindows, &_initialPeak, PREAMP_MODEL_WINDOWS);
+    if (_initialPeak == 0) return -1;
+
+    _scale = _amplitude[0] / _initialPeak;
+
+    if (preAmp.writeWiperValue(_wiper[1]) > 0) Serial.println("writeWiperValue() error");
+    delay(500);
+
+    _amplitude[1] = _scale * measurePeakAmplitude(PREAMP_MODEL_WINDOWS);
+
+    for (uint8_t _step = 0; _step < PREAMP_MODEL_MAX_STEPS; _step++) {
+        // amplitude decreases as wiper value increases, anything else means measurements are unusable (i.e. no signal)
+        _slope = (_amplitude[1] - _amplitude[0]) / (_wiper[1] - _wiper[0]);
+        if (!(_slope < 0)) return -1;
+
+        // jumping to wiper value predicted by linear model (secant step after first iteration)
+        _wiperValue = round(_wiper[1] + (_target - _amplitude[1]) / _slope);
+        _wiperValue = max(0, min(256, _wiperValue));
+
+        // target is out of range of digital pot
+        if (_wiperValue == _wiper[1]) return -1;
+
+        if (preAmp.writeWiperValue(_wiperValue) > 0) Serial.println("writeWiperValue() error");
+        delay(500);
+
+        // short confirmation window
+        peak = round(_scale * measurePeakAmplitude(PREAMP_MODEL_WINDOWS));
+
+        if (peak >= calValLow && peak <= calValHigh) return _wiperValue;
+
+        _wiper[0] = _wiper[1];
+        _amplitude[0] = _amplitude[1];
+        _wiper[1] = _wiperValue;
+        _amplitude[1] = peak;
+    }
+
+    return -1;
+}
+
+uint16_t PiedPiperMonitor::measurePeakAmplitude(uint16_t numWindows, uint16_t *initialPeak, uint16_t initialWindows) {
+    uint16_t _samples[FFT_WINDOW_SIZE]; // array for storing recorded samples
+    uint16_t _windowCount = 0, _max = 0, _sample, i;
+    uint32_t _sum;
+
+    RESET_PLAYBACK_FILE_INDEX();
+
+    // start audio input and output
+    startAudioInputAndOutput();
+
+    while (_windowCount < numWindows) {
+        if (!audioInputBufferFull(_samples)) continue;
+
+        // removing DC component from recorded signal
+        _sum = 0;
+        for (i = 0; i < FFT_WINDOW_SIZE; i++) {
+            _sum += _samples[i];
+        }
+        _sum /= FFT_WINDOW_SIZE;
+
+        // finding maximum value in recorded samples
+        for (i = 0; i < FFT_WINDOW_SIZE; i++) {
+            _sample = abs(int(_samples[i]) - _sum);
+            if (_sample > _max) _max = _sample;
+        }
+
+        _windowCount += 1;
+
+        if (initialPeak != NULL && _windowCount == initialWindows) *initialPeak = _max;
+    }
+
+    stopAudio();
+
+    return _max;
+}
+
+bool PiedPiperMonitor::verifyPreAmpGain(int16_t wiperValue, uint16_t verificationPeak, float driftThreshold) {
+    uint16_t _samples[FFT_WINDOW_SIZE];
+
+    if (wiperValue < 0 || verificationPeak == 0) return false;
+
+    analogWrite(PIN_AUD_OUT, 2048);
+
+    if (preAmp.writeWiperValue(wiperValue) > 0) Serial.println("writeWiperValue() error");
+    // adding slight delay for things to stabalize
+    delay(500);
+
+    // clearing sample buffer
+    startAudioInput();
+
+    while (!audioInputBufferFull(_samples))
+        ;
+
+    stopAudio();
+
+    uint16_t _peak = measurePeakAmplitude(CALIBRATION_VERIFY_WINDOWS);
+    float _drift = abs(float(_peak) - verificationPeak) / verificationPeak;
+
+    Serial.printf("verifyPreAmpGain() peak: %d, calibrated: %d\n", _peak, verificationPeak);
+
+    if (_drift > driftThreshold) return false;
+
+    this->calibratedWiperValue = wiperValue;
+
+    return true;
+}
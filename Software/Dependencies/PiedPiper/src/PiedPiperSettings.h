@@ -4,10 +4,16 @@
 #define SAMPLE_RATE 4096                ///< original sample rate of sampling input and output
 #define WINDOW_SIZE 256                 ///< original window size to use for sampling
 
-#define PLAYBACK_FILE_LENGTH 8          ///< maximum duration of playback file in seconds
+#define PLAYBACK_FILE_LENGTH 2          ///< maximum duration of playback file stored in RAM in seconds, longer sounds are streamed from SD card (calibration sounds must fit)
+#define PLAYBACK_STREAM_BUFFER_SIZE 512 ///< number of samples in each of the two buffers used for streaming playback sounds from SD card
+
+#define SD_SECTOR_SIZE 512              ///< size of SD card sector in bytes, files are read in chunks of this size where possible
 
 #define PIN_AUD_OUT A0                  ///< audio input pin
 #define PIN_AUD_IN A2                   ///< audio output pin
+#define PIN_AUD_IN_2 A3                 ///< second audio input pin (used if AUD_IN_CHANNELS >= 2)
+#define PIN_AUD_IN_3 A4                 ///< third audio input pin (used if AUD_IN_CHANNELS >= 3)
+#define PIN_AUD_IN_4 A5                 ///< fourth audio input pin (used if AUD_IN_CHANNELS >= 4)
 #define PIN_HYPNOS_3VR 5                ///< pin controlling hypnos 3V rail
 #define PIN_HYPNOS_5VR 6                ///< pin controlling hypnos 5V rail
 #define PIN_SD_CS 11                    ///< SD chip select pin
@@ -23,6 +29,42 @@
 #define SINC_FILTER_DOWNSAMPLE_ZERO_X 5 ///< number of zero crossings for audio input resampling filter
 #define SINC_FILTER_UPSAMPLE_ZERO_X 5   ///< number of zero crossings for audio output resampling filter
 
+#define AUDIO_STREAM_BLOCK_SIZE 32      ///< number of samples (at SAMPLE_RATE) per audio stream block, must be a multiple of AUD_IN_DOWNSAMPLE_RATIO
+#define AUDIO_STREAM_MAX_BLOCK_SIZE (AUDIO_STREAM_BLOCK_SIZE * AUD_OUT_UPSAMPLE_RATIO)  ///< block size of audio stream while output is upsampled
+#define AUDIO_STREAM_DMA_CHANNEL_IN 0   ///< DMA channel moving ADC results to audio stream input buffer
+#define AUDIO_STREAM_DMA_CHANNEL_OUT 1  ///< DMA channel moving audio stream output buffer to DAC
+#define AUDIO_STREAM_DMA_CHANNEL_MUX 2  ///< DMA channel switching ADC input between audio input channels
+#define AUDIO_STREAM_EVSYS_CHANNEL 0    ///< event system channel starting ADC conversions on audio stream timer overflow
+
+#define AUD_IN_CHANNELS 1               ///< number of audio input channels (contact microphones on PIN_AUD_IN, PIN_AUD_IN_2...), 1 to 4
+
+#define CALIBRATION_VERIFY_WINDOWS 4    ///< number of sampling windows played for verifying preamp gain against a cached calibration
+
+#define IMPULSE_RESPONSE_REGULARIZATION 0.01  ///< regularization of inverse frequency response (relative to peak power of response) used by IMPULSE_RESPONSE_SEQUENCE
+
+#define PREAMP_MODEL_WIPER_LOW 64       ///< first wiper value measured by model based preamp gain calibration
+#define PREAMP_MODEL_WIPER_HIGH 192     ///< second wiper value measured by model based preamp gain calibration
+#define PREAMP_MODEL_WINDOWS 8          ///< number of sampling windows played per measurement by model based preamp gain calibration
+#define PREAMP_MODEL_MAX_STEPS 4        ///< maximum number of correction steps taken by model based preamp gain calibration before falling back to binary search
+
+// #define PIEDPIPER_PROFILING          ///< uncomment to measure execution time of detection stages and ISRs (see Other/Profiler.h)
+#define PROFILER_MAX_SCOPES 16          ///< maximum number of named profiling scopes
+#define PROFILER_HISTOGRAM_BINS 24      ///< number of log2 histogram bins per profiling scope (last bin holds durations of 2^22 ticks and above)
+#define PROFILER_REPORT_INTERVAL 60000000   ///< time between profiling reports printed to Serial (microseconds)
+
+#define DEADLINE_RECOVER_WINDOWS 64     ///< number of consecutive windows with enough slack before DeadlineMonitor lowers degrade level
+#define DEADLINE_RECOVER_SLACK 0.25     ///< slack (relative to deadline) a window needs to count towards lowering degrade level
+
+#define IDLE_SLEEP_MODE IDLE2           ///< sleep mode used while waiting for audio input or end of playback (see SleepController::idleUntil()), only IDLE2 is supported
+#define IDLE_CURRENT_ACTIVE 30000       ///< ESTIMATE (not measured) of current draw of trap while CPU is running (microamps), only used for reporting
+#define IDLE_CURRENT_SLEEP 13000        ///< ESTIMATE (not measured) of current draw of trap while CPU is in IDLE_SLEEP_MODE (microamps), only used for reporting
+
+#define TASK_MAX_TASKS 8                ///< maximum number of tasks of a TaskScheduler
+#define TASK_MAX_DEFERRALS 256          ///< number of windows in a row a pending task may be deferred before it runs without enough slack
+
+#define ECHO_CANCELLER_STEP_SIZE 0.5    ///< normalized step size of EchoCanceller adaptation
+#define ECHO_CANCELLER_POWER_SMOOTHING 0.2  ///< smoothing factor of reference power used by EchoCanceller for normalizing step size
+
 #define ADC_RESOLUTION 12
 #define DAC_RESOLUTION 12
 
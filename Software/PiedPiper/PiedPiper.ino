@@ -25,17 +25,10 @@
 #include <PiedPiper.h>
 
 char settingsFilename[] = "SETTINGS.txt";   // settings filename (loaded from SD card)
+char calibrationCacheFilename[] = "CAL.BIN"; // calibration cache filename (written to SD card after a full calibration)
 
-// detection algorithm settings
-#define CORRELATION_THRESH 0.8            // positive correlation threshold
-#define CORRELATION_COUNT 8              // number of positive correlations to be considered a detection
-#define CORRELATION_MAX_INTERVAL 5000000 // maximum time between positive correlations (in microseconds) before correlation count is reset
-
-#define NOISE_REMOVAL_SIZE 4              // number of adjacent samples to use for computing sample deviation (Note: 2 = 5 total adjacent frequency domain samples used for averaging, 4 = 9, 8 = 17...)
-#define NOISE_REMOVAL_THRESH 2.75          // minumum sample deviation (samples with deviation below this value are considered noise)
-
-#define TIME_SMOOTHING 2                  // time domain smoothing size - (number of FFT windows used for averaging spectrogram data in the time axis)
-#define FREQ_SMOOTHING 1                  // number of adjacent frequency domain magnitudes to use for frequency domain smoothing (Note 2 = 5 total adjacent frequency domain samples used for averaging)
+// detection algorithm settings (correlation threshold, noise removal, smoothing, template length, frequency range, record time) are
+// loaded from settings file (see detectionSettings in PiedPiper.h for settings names and defaults)
 
 // preamp calibration values (audio input circuit gain is adjusted so that the maximum value read from ADC (during playback) is in this range:
 // [PREAMP_CALIBRATION * ADC_MAX - PREAMP_CALIBRATION_THESH * ADC_MAX, PREAMP_CALIBRATION * ADC_MAX + PREAMP_CALIBRATION_THESH * ADC_MAX]
@@ -45,48 +38,122 @@ char settingsFilename[] = "SETTINGS.txt";   // settings filename (loaded from SD
 // number impulse FFTs to average to flatten frequency response of playback signal
 #define IMPULSE_RESPONSE_AVERAGING 20
 
-#define TEMPLATE_LENGTH 13  // length of correlation template (in windows)
-
-#define REC_TIME 8  // length of processed frequency buffer (in seconds)
+// cached calibration (CAL.BIN) is reused on boot if it was computed with the same calibration sound, is younger than CALIBRATION_MAX_AGE
+// and the peak amplitude of a short verification playback is within CALIBRATION_DRIFT_THRESH of the peak amplitude recorded after calibration
+#define CALIBRATION_MAX_AGE 604800        // maximum age of cached calibration (in seconds)
+#define CALIBRATION_DRIFT_THRESH 0.1      // maximum relative drift of verification peak amplitude
 
 #define DETECTION_PLAYBACK_DURATION 30000000 // mating call playback duration after a positive detection has occured (microseconds)
 
-const uint16_t SAMPLES_WIN_COUNT = (REC_TIME * FFT_SAMPLE_RATE + FFT_WINDOW_SIZE * TIME_SMOOTHING) / FFT_WINDOW_SIZE;
-const uint16_t FREQ_WIN_COUNT = REC_TIME * FFT_SAMPLE_RATE / FFT_WINDOW_SIZE; // number of windows for processed frequency buffer data
+// intermittent work (periodic playback, alive logging, photos) is run by scheduler in the slack left after processing a window, so it does
+// not stop audio input (see TaskScheduler), intervals are measured with micros() so they must be shorter than ~71 minutes
+#define TASK_MARGIN 4000                  // slack kept free in every window for jitter of ISR and loop (microseconds)
+#define LOG_ALIVE_INTERVAL 3600000000UL   // time between alive logs (microseconds)
+#define PHOTO_INTERVAL 3600000000UL       // time between control photos (microseconds), a photo is also taken after each detection
+// task budgets are worst case times of a single slice (microseconds), the scheduler raises them to the longest slice measured (taskStats.maxTime,
+// see budget printed to LOG.TXT), tasks which use SD card power it in one slice and start it (SD.begin()) in the next
+#define PLAYBACK_TASK_BUDGET 20000        // starting SD card, opening sound file or reading SOUND_LOAD_SECTORS sectors of it
+#define LOG_ALIVE_TASK_BUDGET 20000       // starting SD card or appending to LOG.TXT
+#define PHOTO_TASK_BUDGET 25000           // worst case time of a photo task slice (microseconds), fits in the slack of most windows
+#define SOUND_LOAD_SECTORS 4              // number of sectors of playback sound read per window by playback task (a stream prefetches 4 sectors when opened)
+#define PHOTO_CHUNK_SIZE 64               // number of bytes of photo read from camera per window (64 bytes take about 17 ms at 38400 baud)
+
+#define DETECTION_ARENA_SIZE 65536  // size of memory arena holding detection buffers (in bytes), buffers are sized by detection settings
+
+uint8_t detectionArenaBuffer[DETECTION_ARENA_SIZE] __attribute__((aligned(4)));
+MemoryArena detectionArena = MemoryArena(detectionArenaBuffer, DETECTION_ARENA_SIZE);
+
+uint16_t samplesWinCount = 0;  // number of windows for raw samples buffer
+uint16_t freqWinCount = 0;     // number of windows for processed frequency buffer data
+
+uint16_t processedFreqsFirstRow = 0;  // frequency bin of first row stored in processed frequency buffer
+uint16_t processedFreqsNumRows = 0;   // number of frequency bins stored in processed frequency buffer (see bandOnlyHistory)
+
+uint16_t *correlationTemplate = NULL; // buffer for template data
+
+// detection data of one audio input channel (contact microphone), every channel runs the same detection algorithm and channels vote
+// on detections (see channelVotes of detection settings)
+struct detectionChannel {
+  uint8_t *rawSamples = NULL;           // buffer for storing raw samples for detection data (packed 12-bit samples)
+  uint8_t *processedFreqs = NULL;       // buffer for processed frequency data (LogQuantize() codes, mirrored)
+  uint16_t *rawFreqs = NULL;            // buffer for raw frequency data
+  complex *echoCancellerComplex = NULL; // buffers of echo canceller (only allocated if echo cancellation is enabled)
+  float *echoCancellerFloat = NULL;
+  float *noiseFloorBuffer = NULL;       // buffer of noise floor tracker (only allocated if noise floor is tracked, see noise_mode setting)
+
+  PackedCircularBuffer rawSamplesBuffer = PackedCircularBuffer();             // circular buffer for raw samples
+  CircularBuffer<uint16_t> rawFreqsBuffer = CircularBuffer<uint16_t>();       // circular buffer for raw frequency data
+  CircularBuffer<uint8_t> processedFreqsBuffer = CircularBuffer<uint8_t>();   // circular buffer for processed frequency data
+
+  // removes echo of playback sound from audio input of channel, so correlations are counted while playback sound is played (see echo_cancel setting)
+  EchoCanceller echoCanceller = EchoCanceller(ECHO_CANCELLER_STEP_SIZE, ECHO_CANCELLER_POWER_SMOOTHING);
+
+  // removes persistent noise (i.e. pumps, hum) of channel, replaced by one using noise floor settings once settings are loaded
+  NoiseFloorTracker noiseFloor = NoiseFloorTracker(NOISE_FLOOR_MODE::NOISE_FLOOR_EWMA, 0.05, 1.0, 1);
+
+  float correlationCoefficient = 0.0;
+  float *averagedCorrelationCoefficient = NULL;  // for computing average correlation coefficient of consecutive detections
+
+  uint16_t correlationCount = 0; // see correlationCount and correlationMaxInterval of detection settings
+  uint32_t lastCorrelationTime = 0xFFFFFFFF;
+};
 
-uint16_t rawSamples[FFT_WINDOW_SIZE][SAMPLES_WIN_COUNT];               // buffer for storing raw samples for detection data
-uint16_t correlationTemplate[FFT_WINDOW_SIZE_BY2][TEMPLATE_LENGTH]; // buffer for template data
-uint16_t processedFreqs[FFT_WINDOW_SIZE_BY2][FREQ_WIN_COUNT];       // buffer for processed frequency data
-uint16_t rawFreqs[FFT_WINDOW_SIZE_BY2][TIME_SMOOTHING];             // buffer for raw frequency data
+detectionChannel channels[AUD_IN_CHANNELS];
 
 // complex array for FFT with Fast4ier
 complex complexSamples[FFT_WINDOW_SIZE];
 
+// coefficients of window applied before FFT (computed once settings are loaded), NULL for rectangular window
+float windowTable[FFT_WINDOW_SIZE];
+const float *sampleWindow = NULL;
+
+// audio input windows of all channels
+uint16_t channelSamples[AUD_IN_CHANNELS][FFT_WINDOW_SIZE];
+
 // scratch pad arrays
 uint16_t samples[FFT_WINDOW_SIZE];
 uint16_t scratch[FFT_WINDOW_SIZE_BY2];
+uint8_t quantizedScratch[FFT_WINDOW_SIZE_BY2];
 float freqs[FFT_WINDOW_SIZE];
 float scratchFloat[FFT_WINDOW_SIZE];
+int16_t echoReference[FFT_WINDOW_SIZE];
 
 PiedPiperMonitor p = PiedPiperMonitor(); // Pied Piper Monitor object (includes camera, digital pot, temperature sensor)
 
-CircularBuffer<uint16_t> rawSamplesBuffer = CircularBuffer<uint16_t>();     // circular buffer for raw samples
-CircularBuffer<uint16_t> rawFreqsBuffer = CircularBuffer<uint16_t>();       // circular buffer for raw frequency data
-CircularBuffer<uint16_t> processedFreqsBuffer = CircularBuffer<uint16_t>(); // circular buffer for processed frequency data
-
 CrossCorrelation correlation = CrossCorrelation(FFT_SAMPLE_RATE, FFT_WINDOW_SIZE);
 
-float correlationCoefficient = 0.0;
-float averagedCorrelationCoefficient[CORRELATION_COUNT];  // for computing average correlation coefficient of consecutive detections
-
-uint16_t correlationCount = 0; // see CORRELATION_COUNT and CORRELATION_MAX_INTERVAL
-uint32_t lastCorrelationTime = 0xFFFFFFFF;
-
 uint32_t microsTime = 0xFFFFFFFF;      // stores micros() each time audio input buffer fills
 uint32_t prevMicrosTime = 0xFFFFFFFF;
 
 uint32_t lastDetectionTime = 0xFFFFFFFF;
 
+// checks that each window is processed before the next one is sampled, skips detection stages while loop can't keep up (see DEGRADE_LEVEL)
+DeadlineMonitor deadline = DeadlineMonitor(WINDOW_DEADLINE);
+bool correlationSkipped = false;  // true if correlation was skipped on last window (DEGRADE_SKIP_CORRELATION)
+
+bool echoCancelling = false;      // true if echo cancellation is enabled and its buffers were allocated
+bool noiseFloorTracking = false;  // true if noise removal mode tracks noise floor and its buffers were allocated
+
+TaskScheduler scheduler = TaskScheduler(TASK_MARGIN);
+int8_t playbackTaskId = -1;
+int8_t logAliveTaskId = -1;
+int8_t photoTaskId = -1;
+
+uint8_t playbackTaskStep = 0;   // steps of tasks which span several windows
+uint8_t logAliveTaskStep = 0;
+uint8_t photoTaskStep = 0;
+
+bool playbackActive = false;    // true while periodic playback runs alongside audio input, trap hears its own playback so correlations are not counted (unless echoCancelling)
+File photoFile;                 // photo being read from camera
+
+uint8_t sdUsers = 0;            // number of users of SD card (and HYPNOS 3VR), see acquireSD()
+bool sdStarted = false;         // true once SD card was started after HYPNOS 3VR was powered on, see startSD()
+uint8_t hypnos5VRUsers = 0;     // number of users of HYPNOS 5VR (amplifier and camera), see acquire5VR()
+
+#ifdef PIEDPIPER_PROFILING
+uint32_t lastProfileReportTime = 0;   // stores micros() when last profiling report was printed
+#endif
+
 const char dateFormat[] = "YYYYMMDD-hh:mm:ss";
 char date[] = "YYYYMMDD-hh:mm:ss";
 
@@ -114,6 +181,9 @@ void setup() {
 
   Serial.println("Initializing Pied Piper");
 
+  // enable cycle counter used for profiling detection stages and ISRs (compiled out unless PIEDPIPER_PROFILING is defined)
+  PROFILE_BEGIN();
+
   // do necassary initializations (ISR, sinc filter table, configure pins)
   p.init();
 
@@ -147,9 +217,29 @@ void setup() {
       err |= ERR_SETTING;
     }
 
-    if (!p.loadTemplate(p.templateFilename, (uint16_t *)correlationTemplate, TEMPLATE_LENGTH)) {
+    deadline.setDegradeEnabled(p.detection.degradeOnOverload);
+
+    if (p.detection.windowType != WINDOW_TYPE::WINDOW_RECTANGULAR) {
+      ComputeWindow(windowTable, FFT_WINDOW_SIZE, p.detection.windowType);
+      sampleWindow = windowTable;
+    }
+
+    // a detection needs votes of at least one and at most all audio input channels
+    p.detection.channelVotes = constrain(p.detection.channelVotes, 1, AUD_IN_CHANNELS);
+
+    // detection buffers are sized by detection settings, so they are allocated once settings are loaded
+    if (!allocateDetectionBuffers()) p.initializationFail();
+
+    // loads binary template (TEMPS/*.BIN) if it is up to date, otherwise loads text template and caches it as binary template
+    if (!p.loadTemplate(p.templateFilename, correlation, correlationTemplate, p.detection.templateLength, p.detection.frequencyRangeLow, p.detection.frequencyRangeHigh)) {
       Serial.println("loadTemplate() error");
       err |= ERR_TEMPLATE;
+    } else if (p.detection.magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_POWER || p.detection.magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_LOG2) {
+      // template is made from exact magnitudes, so it is converted to the measure of magnitude correlated with
+      for (uint32_t i = 0; i < uint32_t(FFT_WINDOW_SIZE_BY2) * p.detection.templateLength; i++) {
+        correlationTemplate[i] = round(min(MagnitudeToMode(correlationTemplate[i], p.detection.magnitudeMode), 65535.0f));
+      }
+      correlation.setTemplate(correlationTemplate, FFT_WINDOW_SIZE_BY2, p.detection.templateLength, p.detection.frequencyRangeLow, p.detection.frequencyRangeHigh);
     }
 
     if (!p.loadOperationTimes(p.operationTimesFilename)) {
@@ -193,62 +283,94 @@ void setup() {
   // if current time is outside of operation interval, go to sleep  
   if ((err & ERR_RTC) == 0 && !trapActive) p.SleepControl.goToSleep(OFF);
 
-  // set circular buffers and template
-  rawSamplesBuffer.setBuffer((uint16_t *)rawSamples, FFT_WINDOW_SIZE, SAMPLES_WIN_COUNT);
-  rawSamplesBuffer.clearBuffer();
-  rawFreqsBuffer.setBuffer((uint16_t *)rawFreqs, FFT_WINDOW_SIZE_BY2, TIME_SMOOTHING);
-  rawFreqsBuffer.clearBuffer();
-  processedFreqsBuffer.setBuffer((uint16_t *)processedFreqs, FFT_WINDOW_SIZE_BY2, FREQ_WIN_COUNT);
-  processedFreqsBuffer.clearBuffer();
-
-  for (int f = 0; f < FFT_WINDOW_SIZE_BY2; f++) {
-    for (int t = 0; t < TEMPLATE_LENGTH; t++) {
-      correlationTemplate[f][t] = uint16_t(round(correlationTemplate[f][t] * FREQ_WIDTH));
-    }
+  // set circular buffers of each channel
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    channels[c].rawSamplesBuffer.setBuffer(channels[c].rawSamples, FFT_WINDOW_SIZE, samplesWinCount);
+    channels[c].rawFreqsBuffer.setBuffer(channels[c].rawFreqs, FFT_WINDOW_SIZE_BY2, p.detection.timeSmoothing);
+    channels[c].processedFreqsBuffer.setBuffer(channels[c].processedFreqs, processedFreqsNumRows, freqWinCount, true);
+  }
+  clearDetectionChannels();
+
+  if (!p.loadSound(p.calibrationFilename)) {
+    Serial.printf("loadSound() error: %s\n", p.calibrationFilename);
+    err |= ERR_SOUND;
+  } else if (p.isPlaybackStreaming()) {
+    // calibration plays and measures PLAYBACK_FILE directly, so a calibration sound must not be streamed
+    Serial.printf("calibration sound error: %s is longer than PLAYBACK_FILE_LENGTH (%d s)\n", p.calibrationFilename, PLAYBACK_FILE_LENGTH);
+    p.closePlaybackStream();
+    err |= ERR_SOUND;
   }
 
-  correlation.setTemplate((uint16_t *)correlationTemplate, FFT_WINDOW_SIZE_BY2, TEMPLATE_LENGTH, 50, 110);
-
-  if (!p.loadSound(p.calibrationFilename)) Serial.printf("loadSound() error: %s\n", p.calibrationFilename);
+  // hash of calibration sound is needed for saving calibration, impulseResponseCalibration() overwrites PLAYBACK_FILE
+  uint32_t calibrationSoundHash = p.getSoundHash();
+  bool calibrationCached = false;
 
-  // perform pre-amp gain calibration (calculate frequency response of transducer and set pre-amp gain) 
   p.amp.powerOn();
 
-  if ((err & ERR_PREAMP) > 0) Serial.println("digital pot error, cannot perform calibration");
-  else {
-    p.performPlayback();
-    p.preAmpGainCalibration(PREAMP_CALIBRATION, PREAMP_CALIBRATION_THRESH);
-    Serial.println("calibration complete");
+  // reuse cached calibration (flattening filter and pre-amp gain) if it is recent and pre-amp gain has not drifted
+  calibrationFileHeader calibrationHeader;
+  if ((err & (ERR_RTC | ERR_PREAMP)) == 0 && calibrationSoundHash != 0 && p.loadCalibration(calibrationCacheFilename, calibrationSoundHash, calibrationHeader)) {
+    if (dt.unixtime() >= calibrationHeader.timestamp && dt.unixtime() - calibrationHeader.timestamp < CALIBRATION_MAX_AGE) {
+      calibrationCached = p.verifyPreAmpGain(calibrationHeader.wiperValue, calibrationHeader.verificationPeak, CALIBRATION_DRIFT_THRESH);
+    }
+
+    if (calibrationCached) Serial.println("cached calibration loaded");
+    else p.generateImpulse();
   }
 
-  Wire.end();
+  if (!calibrationCached) {
+    // perform pre-amp gain calibration (calculate frequency response of transducer and set pre-amp gain) 
+    if ((err & ERR_PREAMP) > 0) Serial.println("digital pot error, cannot perform calibration");
+    else if ((err & ERR_SOUND) > 0) Serial.println("calibration sound error, cannot perform calibration");
+    else {
+      p.performPlayback();
+      p.preAmpGainCalibration(PREAMP_CALIBRATION, PREAMP_CALIBRATION_THRESH, PREAMP_CALIBRATION_MODE::PREAMP_CALIBRATION_MODEL);
+      Serial.println("calibration complete");
+    }
 
-  // TESTING PLAYBACK WITHOUT FLATTENED RESPONSE
-  // Serial.println("Starting og playback");
-  // int tempVal = 0;
-  // while (tempVal < 10) {
-  //   p.performPlayback();
-  //   tempVal += 1;
-  // }
-
-  // once gain is set, record an impulse to flatten frequency response of playback signal
-  Serial.println("Starting impulse response");
-  p.impulseResponseCalibration(IMPULSE_RESPONSE_AVERAGING);
-
-  // if (!p.loadSound(p.calibrationFilename)) Serial.printf("loadSound() error: %s\n", p.calibrationFilename);
-  // TESTING PLAYBACK WITH FLATTENED RESPONSE
-  // Serial.println("Starting flattened playback");
-  // tempVal = 0;
-  // while (tempVal < 100) {
-  //   p.performPlayback();
-  //   tempVal += 1;
-  // }
+    // TESTING PLAYBACK WITHOUT FLATTENED RESPONSE
+    // Serial.println("Starting og playback");
+    // int tempVal = 0;
+    // while (tempVal < 10) {
+    //   p.performPlayback();
+    //   tempVal += 1;
+    // }
+
+    // once gain is set, record an impulse to flatten frequency response of playback signal
+    Serial.println("Starting impulse response");
+    p.impulseResponseCalibration(IMPULSE_RESPONSE_AVERAGING, IMPULSE_RESPONSE_MODE::IMPULSE_RESPONSE_SEQUENCE);
+
+    // TESTING PLAYBACK WITH FLATTENED RESPONSE
+    // Serial.println("Starting flattened playback");
+    // tempVal = 0;
+    // while (tempVal < 100) {
+    //   p.performPlayback();
+    //   tempVal += 1;
+    // }
+
+    // record peak amplitude of flattened calibration sound, used for checking drift on next boot, and cache calibration
+    if ((err & (ERR_RTC | ERR_SOUND)) == 0 && p.calibratedWiperValue >= 0 && p.loadSound(p.calibrationFilename)) {
+      uint16_t verificationPeak = p.measurePeakAmplitude(CALIBRATION_VERIFY_WINDOWS);
+      if (!p.saveCalibration(calibrationCacheFilename, calibrationSoundHash, dt.unixtime(), p.calibratedWiperValue, verificationPeak)) Serial.println("saveCalibration() error");
+    }
+  }
+
+  // echo canceller starts from echo path measured by impulse response calibration (not stored in calibration cache, so it adapts from zero
+  // after a cached calibration was loaded), calibration only records first channel, so echo cancellers of other channels adapt from zero
+  if (echoCancelling) {
+    float echoPath[FFT_WINDOW_SIZE];
+    if (p.getEchoPathResponse(echoPath)) channels[0].echoCanceller.setEchoPath(echoPath, FFT_WINDOW_SIZE);
+    p.setEchoReferenceEnabled(true);
+  }
+
+  Wire.end();
 
   p.amp.powerOff();
   p.HYPNOS_5VR_OFF();
 
-  // load playback sound
+  // load playback sound, a streamed sound is checked and closed again as SD card is powered off (it is reopened before each playback)
   if (!p.loadSound(p.playbackFilename)) Serial.printf("loadSound() error: %s\n", p.playbackFilename);
+  p.closePlaybackStream();
 
   p.SDCard.end();
 
@@ -256,72 +378,56 @@ void setup() {
 
   Serial.println("starting audio input..");
 
+  playbackTaskId = scheduler.addTask("playback", periodicPlaybackTask, TASK_PRIORITY_NORMAL, p.playbackInterval * 1000000UL, PLAYBACK_TASK_BUDGET);
+  logAliveTaskId = scheduler.addTask("log_alive", logAliveTask, TASK_PRIORITY_LOW, LOG_ALIVE_INTERVAL, LOG_ALIVE_TASK_BUDGET);
+  photoTaskId = scheduler.addTask("photo", photoTask, TASK_PRIORITY_LOW, (err & ERR_CAMERA) ? 0 : PHOTO_INTERVAL, PHOTO_TASK_BUDGET);
+
   // begin audio sampling
   p.startAudioInput();
+  p.SleepControl.beginDutyCycle();
+  scheduler.restartIntervals(micros());
 }
 
 void loop() {
-  // check if audio input buffer is filled (store samples to buffer, this is needed as sampling is done via interrupt timer)
-  if (!p.audioInputBufferFull(samples)) return;
-
-  updateMicros();
-
-  // store raw samples in buffer (saving this data to SD card)
-  rawSamplesBuffer.pushData(samples);
-
-  // prepare arrays for FFT
-  for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
-    complexSamples[i] = samples[i];
+#ifdef PIEDPIPER_PROFILING
+  // print profiling report periodically, while waiting for audio input so printing is not measured as part of a window
+  if (micros() - lastProfileReportTime >= PROFILER_REPORT_INTERVAL) {
+    lastProfileReportTime = micros();
+    PROFILE_REPORT(Serial);
+    PROFILE_RESET();
   }
+#endif
 
-  DCRemoval(complexSamples, FFT_WINDOW_SIZE);
+  // idle until audio input buffer is filled (store samples of all channels to buffer, this is needed as sampling is done via interrupt timer)
+  p.waitForAudioInput(channelSamples[0], AUD_IN_CHANNELS);
 
-  Fast4::FFT(complexSamples, FFT_WINDOW_SIZE);
+  // measures processing of whole window (including saving detection data)
+  PROFILE_SCOPE("window");
 
-  ComplexToMagnitude(complexSamples, FFT_WINDOW_SIZE_BY2);
+  updateMicros();
 
-  // storing magnitudes in freqs array
-  for (int i = 0; i < FFT_WINDOW_SIZE_BY2; i++) {
-    freqs[i] = complexSamples[i].re() * FREQ_WIDTH;
-  }
+  deadline.beginWindow(microsTime);
 
-  // stochastic noise removal using ATM
-  NoiseRemoval_ATM<float>(freqs, scratchFloat, FFT_WINDOW_SIZE_BY2, NOISE_REMOVAL_SIZE, NOISE_REMOVAL_THRESH);
+  // echo reference is shared by all channels
+  if (playbackActive && echoCancelling) p.getEchoReference(echoReference);
 
-  // stochastic noise removal using CFAR
-  // NoiseRemoval_CFAR<float>(freqs, scratchFloat, FFT_WINDOW_SIZE_BY2, 2, 4, 1.0);
+  // loop can't keep up with audio input if correlation is skipped, skipped windows don't count as positive correlations
+  correlationSkipped = deadline.getDegradeLevel() >= DEGRADE_LEVEL::DEGRADE_SKIP_CORRELATION && !correlationSkipped;
 
-  // copy results to temporary buffer
-  for (int i = 0; i < FFT_WINDOW_SIZE_BY2; i++) {
-    scratch[i] = round(scratchFloat[i]);
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    processChannel(channels[c], channelSamples[c]);
   }
 
-  // store 'raw' data in buffer for time smoothing
-  rawFreqsBuffer.pushData(scratch);
-
-  // time smoothing on data
-  TimeSmoothing<uint16_t>((uint16_t *)rawFreqs, scratch, FFT_WINDOW_SIZE_BY2, TIME_SMOOTHING);
-
-  // smoothing frequency domain of time smoothed data
-  FrequencySmoothing<uint16_t>(scratch, samples, FFT_WINDOW_SIZE_BY2, FREQ_SMOOTHING);
-
-  // store time/frequency smoothed data to processed data buffer
-  processedFreqsBuffer.pushData(samples);
-
-  // correlation with processed data and template
-  correlationCoefficient = correlation.correlate((uint16_t *)processedFreqs, processedFreqsBuffer.getCurrentIndex(), FREQ_WIN_COUNT);
-
-  // do stuff if correlation is positive...
-  if (correlationCoefficient >= CORRELATION_THRESH) {
-    // reset correlation count if positive correlation didn't occur within CORRELATION_MAX_INTERVAL
-    if (microsTime - lastCorrelationTime > CORRELATION_MAX_INTERVAL) correlationCount = 0;
-    averagedCorrelationCoefficient[correlationCount] = correlationCoefficient;
-    correlationCount += 1;
-    lastCorrelationTime = microsTime;
-  }
+  // processing of window is complete (saving detection data stops audio input, so it is not measured)
+  deadline.endWindow(micros(), p.getAudioInputOverruns());
   
-  // if count of recent positive correlation is equal to CORRELATION_COUNT, consider this a positive detection
-  if (correlationCount == CORRELATION_COUNT) {
+  // if enough channels counted correlationCount recent positive correlations, consider this a positive detection
+  uint8_t votes = 0;
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    if (hasChannelVote(channels[c])) votes += 1;
+  }
+
+  if (votes >= p.detection.channelVotes) {
     // stop audio sampling
     p.stopAudio();
 
@@ -333,7 +439,7 @@ void loop() {
     lastDetectionTime = microsTime;
 
     // write detection data (structure: DATA/YYMMDD/hhmmss/)
-    p.HYPNOS_3VR_ON();
+    acquireSD();
 
     // get date time
     Wire.begin();
@@ -343,33 +449,244 @@ void loop() {
     Serial.println(date);
     Wire.end();
 
-    p.SDCard.begin();
-
     saveDetection();
-    
-    p.SDCard.end();
 
-    p.HYPNOS_3VR_OFF();
+    // report windows which missed their deadline since last detection
+    if (deadline.getMisses() > 0) logDeadlineMisses();
 
-    // perform playback...
-    p.HYPNOS_5VR_ON();
-    p.amp.powerOn();
-    p.performPlayback();
-    p.amp.powerOff();
-    p.HYPNOS_5VR_OFF();
+    logRuntimeStats();
+
+    if (echoCancelling) {
+      // playback runs alongside audio input (see periodicPlaybackTask()), so detection continues during playback
+      if (!playbackActive) scheduler.trigger(playbackTaskId);
+    } else {
+      // playback sounds longer than PLAYBACK_FILE_LENGTH are streamed from SD card, so the sound is reopened after SD card was restarted
+      // and SD card is kept on until playback is complete (sounds stored in PLAYBACK_FILE are not reloaded)
+      if (!p.loadSound(p.playbackFilename)) Serial.printf("loadSound() error: %s\n", p.playbackFilename);
+
+      // perform playback...
+      acquire5VR();
+      p.amp.powerOn();
+      p.performPlayback();
+      p.amp.powerOff();
+      release5VR();
+
+      if (p.getPlaybackStreamUnderruns() > 0) Serial.printf("playback stream underruns: %d\n", int(p.getPlaybackStreamUnderruns()));
+    }
+
+    // SD card stays on if a task is using it
+    releaseSD();
+
+    clearDetectionChannels();
+
+    // restart audio sampling, periodic playback which was interrupted by saving detection data resumes
+    if (playbackActive) p.startAudioInputAndOutput();
+    else p.startAudioInput();
+    p.SleepControl.beginDutyCycle();
+
+    // take a photo of the detected insect once there is slack (no slack is left in this window)
+    scheduler.trigger(photoTaskId);
+    return;
+  }
+
+  // intermittent work in slack until next window is sampled (microsTime stores micros() when this window was read)
+  scheduler.run(microsTime, WINDOW_DEADLINE);
 
-    rawSamplesBuffer.clearBuffer();
-    rawFreqsBuffer.clearBuffer();
-    processedFreqsBuffer.clearBuffer();
+  // samples discarded by a task slice are charged to the task, not to detection stages of the next window
+  deadline.endTasks(micros(), p.getAudioInputOverruns(), scheduler.getLongestSlice(), scheduler.getLongestSliceTime());
+}
+
+// runs detection algorithm on a window of audio input of one channel and counts positive correlations of channel
+// (SignalChain in Utilities/GoldenVectors.cpp is a host copy of this function, keep it in sync when changing detection stages)
+void processChannel(detectionChannel &channel, uint16_t *channelWindow) {
+  // store raw samples in buffer (saving this data to SD card)
+  channel.rawSamplesBuffer.pushData(channelWindow);
 
-    correlationCount = 0;
+  // prepare arrays for FFT, echo reference is not windowed so window is applied after echo cancelling
+  bool cancelEcho = playbackActive && echoCancelling;
+  DCRemovalWindow(channelWindow, complexSamples, cancelEcho ? NULL : sampleWindow, FFT_WINDOW_SIZE);
 
-    // restart audio sampling
-    p.startAudioInput();
+  // remove echo of playback sound which is played alongside audio input, so detection continues during playback
+  if (cancelEcho) {
+    {
+      PROFILE_SCOPE("echo_cancel");
+
+      channel.echoCanceller.process(echoReference, complexSamples);
+      if (sampleWindow != NULL) ApplyWindow(complexSamples, sampleWindow, FFT_WINDOW_SIZE);
+    }
+
+    deadline.endStage("echo_cancel", micros());
   }
 
-  // TODO - add other intermittent data logging (see PiedPiper_old.ino as example)
-  //        use microsTime here, it stores time returned by micros() everytime the audio input buffer fills
+  {
+    PROFILE_SCOPE("fft");
+
+    Fast4::FFT(complexSamples, FFT_WINDOW_SIZE);
+
+    // storing magnitudes (measured as set by magnitude_mode) in freqs array
+    ComplexToMagnitude(complexSamples, freqs, FFT_WINDOW_SIZE_BY2, p.detection.magnitudeMode, FREQ_WIDTH);
+  }
+
+  deadline.endStage("fft", micros());
+
+  {
+    PROFILE_SCOPE("noise_removal");
+
+    if (noiseFloorTracking) {
+      // persistent noise is removed by subtracting noise floor tracked across windows, noise floor is frozen while correlation of
+      // previous window is positive or while playback sound is heard
+      channel.noiseFloor.setAdaptation(channel.correlationCoefficient < p.detection.correlationThreshold && (!playbackActive || echoCancelling));
+      channel.noiseFloor.process(freqs, scratchFloat);
+    } else if (p.detection.noiseRemovalMode == NOISE_REMOVAL_MODE::NOISE_REMOVAL_CFAR) {
+      // stochastic noise removal using CFAR
+      NoiseRemoval_CFAR<float>(freqs, scratchFloat, FFT_WINDOW_SIZE_BY2, 2, 4, 1.0);
+    } else {
+      // stochastic noise removal using ATM
+      NoiseRemoval_ATM<float>(freqs, scratchFloat, FFT_WINDOW_SIZE_BY2, p.detection.noiseRemovalSize, p.detection.noiseRemovalThreshold);
+    }
+
+    // copy results to temporary buffer (MAGNITUDE_POWER values may exceed range of buffer)
+    for (int i = 0; i < FFT_WINDOW_SIZE_BY2; i++) {
+      scratch[i] = round(min(scratchFloat[i], 65535.0f));
+    }
+  }
+
+  deadline.endStage("noise_removal", micros());
+
+  {
+    PROFILE_SCOPE("smoothing");
+
+    // store 'raw' data in buffer for time smoothing
+    channel.rawFreqsBuffer.pushData(scratch);
+
+    if (deadline.getDegradeLevel() >= DEGRADE_LEVEL::DEGRADE_SKIP_SMOOTHING) {
+      // loop can't keep up with audio input, noise removed data is used as is
+      for (int i = 0; i < FFT_WINDOW_SIZE_BY2; i++) {
+        samples[i] = scratch[i];
+      }
+    } else {
+      // time smoothing on data
+      TimeSmoothing<uint16_t>(channel.rawFreqs, scratch, FFT_WINDOW_SIZE_BY2, p.detection.timeSmoothing);
+
+      // smoothing frequency domain of time smoothed data
+      FrequencySmoothing<uint16_t>(scratch, samples, FFT_WINDOW_SIZE_BY2, p.detection.freqSmoothing);
+    }
+  }
+
+  deadline.endStage("smoothing", micros());
+
+  {
+    PROFILE_SCOPE("correlation");
+
+    // store time/frequency smoothed data (log quantized) to processed data buffer
+    for (int i = 0; i < processedFreqsNumRows; i++) {
+      quantizedScratch[i] = LogQuantize(samples[processedFreqsFirstRow + i]);
+    }
+    channel.processedFreqsBuffer.pushData(quantizedScratch);
+
+    // correlation with processed data and template
+    // (processed data buffer is mirrored, so the whole history is contiguous and ends with the latest window)
+    if (correlationSkipped) channel.correlationCoefficient = 0.0;
+    else channel.correlationCoefficient = correlation.correlate(channel.processedFreqsBuffer.getLatest(freqWinCount), processedFreqsFirstRow);
+  }
+
+  deadline.endStage("correlation", micros());
+
+  // sounds of insects are not part of echo, echo canceller only adapts while correlation is negative
+  if (echoCancelling) channel.echoCanceller.setAdaptation(channel.correlationCoefficient < p.detection.correlationThreshold);
+
+  // do stuff if correlation is positive...
+  if (channel.correlationCoefficient >= p.detection.correlationThreshold && (!playbackActive || echoCancelling)) {
+    // reset correlation count if positive correlation didn't occur within correlationMaxInterval
+    if (microsTime - channel.lastCorrelationTime > p.detection.correlationMaxInterval) channel.correlationCount = 0;
+
+    // channel which already counted correlationCount positive correlations keeps the latest ones while it waits for votes of other channels
+    if (channel.correlationCount == p.detection.correlationCount) {
+      memmove(channel.averagedCorrelationCoefficient, channel.averagedCorrelationCoefficient + 1, (channel.correlationCount - 1) * sizeof(float));
+      channel.correlationCount -= 1;
+    }
+
+    channel.averagedCorrelationCoefficient[channel.correlationCount] = channel.correlationCoefficient;
+    channel.correlationCount += 1;
+    channel.lastCorrelationTime = microsTime;
+  }
+}
+
+// checks if a channel votes for a detection, i.e. it counted correlationCount positive correlations and the last one is recent
+bool hasChannelVote(detectionChannel &channel) {
+  return channel.correlationCount == p.detection.correlationCount && microsTime - channel.lastCorrelationTime <= p.detection.correlationMaxInterval;
+}
+
+// clears detection data buffers and correlation counts of all channels
+void clearDetectionChannels() {
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    channels[c].rawSamplesBuffer.clearBuffer();
+    channels[c].rawFreqsBuffer.clearBuffer();
+    channels[c].processedFreqsBuffer.clearBuffer();
+    channels[c].correlationCount = 0;
+  }
+}
+
+// allocates detection buffers from detection arena, buffer sizes depend on detection settings loaded from settings file
+// returns false if buffers do not fit in arena (usage of each buffer is printed either way)
+bool allocateDetectionBuffers() {
+  samplesWinCount = (p.detection.rawRecTime * FFT_SAMPLE_RATE + FFT_WINDOW_SIZE * p.detection.timeSmoothing) / FFT_WINDOW_SIZE;
+  freqWinCount = p.detection.recTime * FFT_SAMPLE_RATE / FFT_WINDOW_SIZE;
+
+  // processed frequency buffer either stores all bins or only the bins used for correlation (band is read from correlation, template
+  // loaded later uses the same frequency range)
+  correlation.setFrequencyRange(p.detection.frequencyRangeLow, p.detection.frequencyRangeHigh);
+  if (p.detection.bandOnlyHistory) {
+    processedFreqsFirstRow = correlation.getFrequencyIndexLow();
+    processedFreqsNumRows = correlation.getFrequencyIndexHigh() - processedFreqsFirstRow;
+  } else {
+    processedFreqsFirstRow = 0;
+    processedFreqsNumRows = FFT_WINDOW_SIZE_BY2;
+  }
+
+  detectionArena.reset();
+
+  correlationTemplate = detectionArena.allocate<uint16_t>("correlationTemplate", uint32_t(FFT_WINDOW_SIZE_BY2) * p.detection.templateLength);
+
+  bool trackNoiseFloor = p.detection.noiseRemovalMode == NOISE_REMOVAL_MODE::NOISE_REMOVAL_FLOOR_EWMA ||
+                         p.detection.noiseRemovalMode == NOISE_REMOVAL_MODE::NOISE_REMOVAL_FLOOR_MIN_STATS;
+
+  // every channel has its own detection buffers
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    detectionChannel &channel = channels[c];
+
+    channel.rawSamples = detectionArena.allocate<uint8_t>("rawSamples", PackedCircularBuffer::bytesRequired(FFT_WINDOW_SIZE, samplesWinCount));
+    channel.processedFreqs = detectionArena.allocate<uint8_t>("processedFreqs", CircularBuffer<uint8_t>::elementsRequired(processedFreqsNumRows, freqWinCount, true));
+    channel.rawFreqs = detectionArena.allocate<uint16_t>("rawFreqs", uint32_t(FFT_WINDOW_SIZE_BY2) * p.detection.timeSmoothing);
+    channel.averagedCorrelationCoefficient = detectionArena.allocate<float>("averagedCorrelationCoefficient", p.detection.correlationCount);
+
+    if (p.detection.echoCancellation) {
+      channel.echoCancellerComplex = detectionArena.allocate<complex>("echoCancellerComplex", EchoCanceller::complexElementsRequired(FFT_WINDOW_SIZE));
+      channel.echoCancellerFloat = detectionArena.allocate<float>("echoCancellerFloat", EchoCanceller::floatElementsRequired(FFT_WINDOW_SIZE));
+    }
+
+    if (trackNoiseFloor) {
+      channel.noiseFloorBuffer = detectionArena.allocate<float>("noiseFloor", NoiseFloorTracker::floatElementsRequired(FFT_WINDOW_SIZE_BY2));
+    }
+  }
+
+  detectionArena.printUsage();
+
+  if (!detectionArena.withinBudget()) return false;
+
+  echoCancelling = p.detection.echoCancellation;
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS && echoCancelling; c++) {
+    channels[c].echoCanceller.setBuffers(channels[c].echoCancellerComplex, channels[c].echoCancellerFloat, FFT_WINDOW_SIZE);
+  }
+
+  noiseFloorTracking = trackNoiseFloor;
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS && noiseFloorTracking; c++) {
+    NOISE_FLOOR_MODE mode = p.detection.noiseRemovalMode == NOISE_REMOVAL_MODE::NOISE_REMOVAL_FLOOR_EWMA ? NOISE_FLOOR_MODE::NOISE_FLOOR_EWMA : NOISE_FLOOR_MODE::NOISE_FLOOR_MIN_STATS;
+    channels[c].noiseFloor = NoiseFloorTracker(mode, p.detection.noiseFloorSmoothing, p.detection.noiseFloorOverSubtraction, p.detection.noiseFloorSubWindow);
+    channels[c].noiseFloor.setBuffer(channels[c].noiseFloorBuffer, FFT_WINDOW_SIZE_BY2);
+  }
+
+  return true;
 }
 
 // saves detection data to SD card to "/DATA/YYYYMMDD/hhmmss/"
@@ -397,37 +714,50 @@ void saveDetection() {
 
   // storing directory in temp buffer
   strcpy(buf2, buf);
-  // file for processed frequencies buffer
-  strcat(buf, "/PFD.TXT");
 
-  // write processed frequencies buffer to PFD.txt
-  if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
-  else {
-    p.writeCircularBufferToFile(&processedFreqsBuffer);
-    p.SDCard.closeFile();
-  }
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    // file for processed frequencies buffer, files of channels after the first one are numbered (PFD1.TXT, RAW1.TXT...)
+    strcpy(buf, buf2);
+    if (c == 0) strcat(buf, "/PFD.TXT");
+    else sprintf(buf + strlen(buf), "/PFD%d.TXT", int(c));
+
+    // write processed frequencies buffer to PFD.txt
+    if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
+    else {
+      p.writeLogQuantizedBufferToFile(&channels[c].processedFreqsBuffer);
+      p.SDCard.closeFile();
+    }
 
-  // file for raw samples
-  strcpy(buf, buf2);
-  strcat(buf, "/RAW.TXT");
+    // file for raw samples
+    strcpy(buf, buf2);
+    if (c == 0) strcat(buf, "/RAW.TXT");
+    else sprintf(buf + strlen(buf), "/RAW%d.TXT", int(c));
 
-  // write raw samples buffer to RAW.txt
-  if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
-  else {
-    p.writeCircularBufferToFile(&rawSamplesBuffer);
-    p.SDCard.closeFile();
+    // write raw samples buffer to RAW.txt
+    if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
+    else {
+      p.writeCircularBufferToFile(&channels[c].rawSamplesBuffer);
+      p.SDCard.closeFile();
+    }
   }
 
+  // average correlation coefficient of channels which voted for detection
+  float correlationCoefficient = 0;
+  uint8_t votes = 0;
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    if (!hasChannelVote(channels[c])) continue;
+    for (int i = 0; i < p.detection.correlationCount; i++) {
+      correlationCoefficient += channels[c].averagedCorrelationCoefficient[i];
+    }
+    votes += 1;
+  }
+  correlationCoefficient /= p.detection.correlationCount * votes;
+
   // store details of detection to DETS.txt
   strcpy(buf, buf2);
   strcat(buf, "/DETS.TXT");
   if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
   else {
-    correlationCoefficient = 0;
-    for (int i = 0; i < CORRELATION_COUNT; i++) {
-      correlationCoefficient += averagedCorrelationCoefficient[i];
-    }
-    correlationCoefficient /= CORRELATION_COUNT;
     p.SDCard.data.print(date);
     p.SDCard.data.print(" ");
     p.SDCard.data.print(correlationCoefficient, 3);
@@ -440,17 +770,32 @@ void saveDetection() {
     p.SDCard.data.print(" ");
     p.SDCard.data.print(FFT_WINDOW_SIZE);
     p.SDCard.data.print(" ");
-    p.SDCard.data.print(NOISE_REMOVAL_SIZE);
+    p.SDCard.data.print(p.detection.noiseRemovalSize);
     p.SDCard.data.print(" ");
-    p.SDCard.data.print(NOISE_REMOVAL_THRESH);
+    p.SDCard.data.print(p.detection.noiseRemovalThreshold);
     p.SDCard.data.print(" ");
-    p.SDCard.data.print(TIME_SMOOTHING);
+    p.SDCard.data.print(p.detection.timeSmoothing);
     p.SDCard.data.print(" ");
-    p.SDCard.data.println(FREQ_SMOOTHING);
+    p.SDCard.data.print(p.detection.freqSmoothing);
+    p.SDCard.data.print(" ");
+    p.SDCard.data.print(processedFreqsFirstRow);
+    p.SDCard.data.print(" ");
+    p.SDCard.data.println(processedFreqsNumRows);
     p.SDCard.closeFile();
   }
 
   Serial.println(correlationCoefficient);
+
+#ifdef PIEDPIPER_PROFILING
+  // store profiling report of detection loop and ISRs to PERF.TXT
+  strcpy(buf, buf2);
+  strcat(buf, "/PERF.TXT");
+  if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
+  else {
+    PROFILE_REPORT(p.SDCard.data);
+    p.SDCard.closeFile();
+  }
+#endif
   
   // TODO: open file for storing photo, call camera.takePhoto(&p.SDCard.data) after opening file...
   // Hints: 
@@ -512,6 +857,306 @@ void logAlive() {
 }
 
 
+// appends summary of deadline misses (count, lost samples, least slack, offending stage, degrade level) to LOG.TXT and resets it
+// in this format "YYYYMMDD-hh:mm:ss windows: W misses: M lost: L min_slack: S us stage: NAME (T us) degrade: D/MAX"
+void logDeadlineMisses() {
+  char buf[64] = { 0 };
+  strcat(buf, "/LOG.TXT");
+
+  deadline.printSummary(Serial);
+
+  if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
+  else {
+    p.SDCard.data.print(date);
+    p.SDCard.data.print(" ");
+    deadline.printSummary(p.SDCard.data);
+    p.SDCard.closeFile();
+  }
+
+  deadline.reset();
+}
+
+// logs duty cycle and estimated current draw of CPU while listening since last detection, runtime statistics of tasks and attenuation of
+// echo cancellers to LOG.TXT
+void logRuntimeStats() {
+  char buf[64] = { 0 };
+  strcat(buf, "/LOG.TXT");
+
+  p.SleepControl.printDutyCycle(Serial);
+  scheduler.printStats(Serial);
+  if (echoCancelling) printEchoAttenuation(Serial);
+
+  if (!p.SDCard.openFile(buf, FILE_WRITE)) Serial.printf("openFile() error: %s", buf);
+  else {
+    p.SDCard.data.print(date);
+    p.SDCard.data.print(" ");
+    p.SleepControl.printDutyCycle(p.SDCard.data);
+    scheduler.printStats(p.SDCard.data);
+    if (echoCancelling) printEchoAttenuation(p.SDCard.data);
+    p.SDCard.closeFile();
+  }
+
+  scheduler.resetStats();
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    channels[c].echoCanceller.resetStats();
+  }
+}
+
+// prints attenuation of echo canceller of each channel
+void printEchoAttenuation(Print &out) {
+  for (uint8_t c = 0; c < AUD_IN_CHANNELS; c++) {
+    if (AUD_IN_CHANNELS > 1) out.printf("channel %d ", int(c));
+    out.printf("echo attenuation: %d dB\n", int(channels[c].echoCanceller.getAttenuation()));
+  }
+}
+
+// powers on and starts SD card (HYPNOS 3VR) unless it is already in use, SD card may be shared by detection saving and tasks
+void acquireSD() {
+  acquireSDPower();
+  startSD();
+}
+
+// powers on SD card (HYPNOS 3VR) unless it is already in use, tasks call startSD() in a following window so a slice does not include
+// both the power up of the card and its initialization
+void acquireSDPower() {
+  if (sdUsers++ > 0) return;
+  p.HYPNOS_3VR_ON();
+  sdStarted = false;
+}
+
+// starts SD card powered on by acquireSDPower() unless it was already started
+void startSD() {
+  if (sdStarted) return;
+  if (!p.SDCard.begin()) Serial.println("SD card cannot be started");
+  sdStarted = true;
+}
+
+// powers off SD card once it is no longer in use
+void releaseSD() {
+  if (sdUsers == 0 || --sdUsers > 0) return;
+  // file handles of playback stream and sound being loaded would not survive SD card being powered off
+  p.closePlaybackStream();
+  p.cancelLoadSound();
+  if (sdStarted) p.SDCard.end();
+  p.HYPNOS_3VR_OFF();
+  sdStarted = false;
+}
+
+// powers on HYPNOS 5VR unless it is already in use, 5VR may be shared by amplifier and camera
+void acquire5VR() {
+  if (hypnos5VRUsers++ > 0) return;
+  p.HYPNOS_5VR_ON();
+}
+
+// powers off HYPNOS 5VR once it is no longer in use
+void release5VR() {
+  if (hypnos5VRUsers == 0 || --hypnos5VRUsers > 0) return;
+  p.HYPNOS_5VR_OFF();
+}
+
+// reads date and time from RTC to dt and date (HYPNOS 3VR must be on)
+void readDateTime() {
+  Wire.begin();
+  dt = p.RTCWrap.getDateTime();
+  strcpy(date, dateFormat);
+  dt.toString(date);
+  Wire.end();
+}
+
+// task: plays playback sound alongside audio input, frequency data recorded during playback is discarded once playback is complete (unless
+// echo of playback is removed by echo canceller). SD card is powered on and started in separate windows, then the sound is loaded
+// SOUND_LOAD_SECTORS sectors per window before playback starts
+bool periodicPlaybackTask() {
+  if (playbackTaskStep == 0) {
+    // RTC is powered by HYPNOS 3VR along with SD card
+    acquireSDPower();
+    playbackTaskStep = 1;
+    return false;
+  }
+
+  if (playbackTaskStep == 1) {
+    // sound is only played within operation intervals loaded from operation times file (always if time can't be read from RTC)
+    if ((err & ERR_RTC) == 0) {
+      bool withinOperationInterval = false;
+      readDateTime();
+      p.OperationMan.minutesTillNextOperationTime(dt, withinOperationInterval);
+      if (!withinOperationInterval) return endPlaybackTask();
+    }
+
+    startSD();
+    playbackTaskStep = 2;
+    return false;
+  }
+
+  if (playbackTaskStep == 2) {
+    // streamed sounds are reopened after SD card was restarted and SD card is kept on until playback is complete
+    if (!p.beginLoadSound(p.playbackFilename)) {
+      Serial.printf("loadSound() error: %s\n", p.playbackFilename);
+      return endPlaybackTask();
+    }
+
+    playbackTaskStep = 3;
+    return false;
+  }
+
+  if (playbackTaskStep == 3) {
+    int32_t bytesRemaining = p.loadSoundChunk(SOUND_LOAD_SECTORS);
+    if (bytesRemaining > 0) return false;
+    if (bytesRemaining < 0) {
+      Serial.printf("loadSound() error: %s\n", p.playbackFilename);
+      return endPlaybackTask();
+    }
+
+    if (!p.isPlaybackStreaming()) releaseSD();
+
+    acquire5VR();
+    p.amp.powerOn();
+
+    playbackActive = true;
+    p.startPlayback();
+
+    playbackTaskStep = 4;
+    return false;
+  }
+
+  p.servicePlaybackStream();
+  if (!p.isPlaybackComplete()) return false;
+
+  p.startAudioInput();
+
+  p.amp.powerOff();
+  release5VR();
+  if (p.isPlaybackStreaming()) releaseSD();
+
+  if (p.getPlaybackStreamUnderruns() > 0) Serial.printf("playback stream underruns: %d\n", int(p.getPlaybackStreamUnderruns()));
+
+  if (!echoCancelling) clearDetectionChannels();
+
+  playbackActive = false;
+  playbackTaskStep = 0;
+  return true;
+}
+
+// releases SD card of playback task which ended before playback was started
+bool endPlaybackTask() {
+  releaseSD();
+
+  playbackTaskStep = 0;
+  return true;
+}
+
+// task: logs alive data to LOG.TXT (SD card is powered on in one window, started in the next, then data is read and logged), followed by a
+// summary of deadline misses in another window if any window missed its deadline since the last summary
+bool logAliveTask() {
+  if (logAliveTaskStep == 0) {
+    acquireSDPower();
+    logAliveTaskStep = 1;
+    return false;
+  }
+
+  if (logAliveTaskStep == 1) {
+    startSD();
+    logAliveTaskStep = 2;
+    return false;
+  }
+
+  if (logAliveTaskStep == 2) {
+    readDateTime();
+    logAlive();
+
+    // windows which missed their deadline are also reported while there are no detections (i.e. on a trap which is always overloaded)
+    if (deadline.getMisses() > 0) {
+      logAliveTaskStep = 3;
+      return false;
+    }
+  } else logDeadlineMisses();
+
+  releaseSD();
+
+  logAliveTaskStep = 0;
+  return true;
+}
+
+// task: takes a photo and saves it to "/PHOTOS/YYYYMMDD/hhmmss.JPG", SD card is started, file is opened, camera is initialized and photo is
+// taken in separate windows, then photo is read from camera in chunks of PHOTO_CHUNK_SIZE bytes
+bool photoTask() {
+  if (photoTaskStep == 0) {
+    // camera and SD card are given a window to power up
+    acquireSDPower();
+    acquire5VR();
+    photoTaskStep = 1;
+    return false;
+  }
+
+  if (photoTaskStep == 1) {
+    startSD();
+    photoTaskStep = 2;
+    return false;
+  }
+
+  if (photoTaskStep == 2) {
+    char buf[64] = { 0 };
+
+    readDateTime();
+
+    strcat(buf, "/PHOTOS/");
+    if (!SD.exists(buf)) SD.mkdir(buf);
+    strncat(buf, date, 8);
+    if (!SD.exists(buf)) SD.mkdir(buf);
+    strcat(buf, "/");
+    strncat(buf, date + 9, 2);
+    strncat(buf, date + 12, 2);
+    strncat(buf, date + 15, 2);
+    strcat(buf, ".JPG");
+
+    photoFile = SD.open(buf, FILE_WRITE);
+    if (!photoFile) {
+      Serial.printf("photo error: %s\n", buf);
+      return endPhotoTask();
+    }
+
+    photoTaskStep = 3;
+    return false;
+  }
+
+  // camera commands are sent in separate windows, each of them waits for a response over UART
+  if (photoTaskStep == 3) {
+    if (!p.camera.initialize()) {
+      Serial.println("photo error: camera cannot be initialized");
+      return endPhotoTask();
+    }
+
+    photoTaskStep = 4;
+    return false;
+  }
+
+  if (photoTaskStep == 4) {
+    if (!p.camera.beginPhoto()) {
+      Serial.println("photo error: camera cannot take photo");
+      return endPhotoTask();
+    }
+
+    photoTaskStep = 5;
+    return false;
+  }
+
+  int32_t bytesRemaining = p.camera.readPhoto(&photoFile, PHOTO_CHUNK_SIZE);
+  if (bytesRemaining > 0) return false;
+  if (bytesRemaining < 0) Serial.println("photo error: reading photo from camera failed");
+
+  return endPhotoTask();
+}
+
+// closes photo file and releases power of photo task
+bool endPhotoTask() {
+  if (photoFile) photoFile.close();
+  release5VR();
+  releaseSD();
+
+  photoTaskStep = 0;
+  return true;
+}
+
 // updates microsTime
 void updateMicros() {
   prevMicrosTime = microsTime;
@@ -0,0 +1,231 @@
+#ifndef KERNEL_BENCHMARKS_h
+#define KERNEL_BENCHMARKS_h
+
+// Microbenchmarks of the DataProcessing kernels used by the detection loop of PiedPiper.ino. This file is compiled both by the
+// PiedPiperBenchmark sketch (ticks are CPU cycles of the M4, measured with the DWT cycle counter) and by Utilities/KernelBenchmark.cpp
+// on a host machine (ticks are nanoseconds), so results of both come from the same source.
+// Results are printed as CSV lines: label,kernel,input,window_size,calls,ticks_per_call,unit
+
+#include "DataProcessing/DataProcessing.h"
+#include "Other/CycleCounter.h"
+
+#define BENCHMARK_MAX_WINDOW_SIZE 256   ///< largest window size which can be benchmarked
+#define BENCHMARK_WINDOWS 64            ///< number of windows of input processed per window size (input is repeated if it is shorter)
+#define BENCHMARK_HISTORY 64            ///< number of columns of circular buffers and correlation input
+#define BENCHMARK_TEMPLATE_LENGTH 13    ///< number of columns of correlation template
+#define BENCHMARK_FREQUENCY_LOW 50      ///< start frequency of correlation
+#define BENCHMARK_FREQUENCY_HIGH 110    ///< end frequency of correlation
+
+#ifdef ARDUINO
+#define BENCHMARK_UNIT "cycles"
+#else
+#define BENCHMARK_UNIT "ns"
+#endif
+
+/**
+ * names of benchmarked kernels, in the order they run in the detection loop
+ */
+enum BENCHMARK_KERNEL {
+    BENCHMARK_DC_REMOVAL_WINDOW_RECTANGULAR = 0,
+    BENCHMARK_DC_REMOVAL_WINDOW_HANN,
+    BENCHMARK_DC_REMOVAL_WINDOW_BLACKMAN,
+    BENCHMARK_COPY_TO_COMPLEX,
+    BENCHMARK_DC_REMOVAL,
+    BENCHMARK_FFT,
+    BENCHMARK_COMPLEX_TO_MAGNITUDE,
+    BENCHMARK_MAGNITUDE_EXACT,
+    BENCHMARK_MAGNITUDE_ALPHA_MAX_BETA_MIN,
+    BENCHMARK_MAGNITUDE_POWER,
+    BENCHMARK_MAGNITUDE_LOG2,
+    BENCHMARK_NOISE_REMOVAL_ATM,
+    BENCHMARK_NOISE_REMOVAL_CFAR,
+    BENCHMARK_TIME_SMOOTHING,
+    BENCHMARK_FREQUENCY_SMOOTHING,
+    BENCHMARK_PUSH_DATA,
+    BENCHMARK_PUSH_DATA_MIRRORED,
+    BENCHMARK_LOG_QUANTIZE,
+    BENCHMARK_CORRELATE,
+    BENCHMARK_CORRELATE_QUANTIZED,
+    BENCHMARK_NUM_KERNELS
+};
+
+const char *const benchmarkKernelNames[BENCHMARK_NUM_KERNELS] = {
+    "DCRemovalWindow(rectangular)", "DCRemovalWindow(hann)", "DCRemovalWindow(blackman)", "copy(uint16_t->complex)", "DCRemoval",
+    "Fast4::FFT", "ComplexToMagnitude", "ComplexToMagnitude(exact)", "ComplexToMagnitude(alpha_max_beta_min)",
+    "ComplexToMagnitude(power)", "ComplexToMagnitude(log2)", "NoiseRemoval_ATM", "NoiseRemoval_CFAR", "TimeSmoothing", "FrequencySmoothing",
+    "CircularBuffer::pushData", "CircularBuffer::pushData(mirrored)", "LogQuantize", "CrossCorrelation::correlate",
+    "CrossCorrelation::correlate(quantized)"
+};
+
+/**
+ * buffers used by benchmarks, kept out of the stack since the M4 sketch has a small stack
+ */
+struct kernelBenchmarkBuffers {
+    complex complexSamples[BENCHMARK_MAX_WINDOW_SIZE];
+    float hannWindow[BENCHMARK_MAX_WINDOW_SIZE];
+    float blackmanWindow[BENCHMARK_MAX_WINDOW_SIZE];
+    float freqs[BENCHMARK_MAX_WINDOW_SIZE / 2];
+    float scratchFloat[BENCHMARK_MAX_WINDOW_SIZE / 2];
+    uint16_t scratch[BENCHMARK_MAX_WINDOW_SIZE / 2];
+    uint16_t smoothed[BENCHMARK_MAX_WINDOW_SIZE / 2];
+    uint8_t quantized[BENCHMARK_MAX_WINDOW_SIZE / 2];
+    uint16_t rawFreqs[BENCHMARK_MAX_WINDOW_SIZE / 2 * 2];
+    uint16_t history[BENCHMARK_MAX_WINDOW_SIZE / 2 * BENCHMARK_HISTORY * 2];
+    uint8_t quantizedHistory[BENCHMARK_MAX_WINDOW_SIZE / 2 * BENCHMARK_HISTORY * 2];
+    uint16_t correlationTemplate[BENCHMARK_MAX_WINDOW_SIZE / 2 * BENCHMARK_TEMPLATE_LENGTH];
+};
+
+/**
+ * generates a deterministic test signal (12-bit ADC values): three tones within the correlation frequency range plus white noise
+ * @param output array for samples
+ * @param numSamples number of samples to generate
+ * @param sampleRate sample rate of signal
+ */
+inline void generateBenchmarkTones(uint16_t *output, uint32_t numSamples, uint16_t sampleRate) {
+    uint32_t _noise = 12345;
+    for (uint32_t i = 0; i < numSamples; i++) {
+        float _t = float(i) / sampleRate;
+        float _value = 400.0 * sin(2.0 * PI * 60.0 * _t) + 250.0 * sin(2.0 * PI * 90.0 * _t) + 150.0 * sin(2.0 * PI * 150.0 * _t);
+
+        // linear congruential generator, so host and target generate the same noise
+        _noise = _noise * 1664525UL + 1013904223UL;
+        _value += int32_t(_noise >> 22) - 512;
+
+        output[i] = uint16_t(max(0, min(4095, int32_t(2048 + _value))));
+    }
+}
+
+/**
+ * measures cost of reading the cycle counter twice, subtracted from every measured call
+ * @return smallest number of ticks between two consecutive reads
+ */
+inline uint32_t benchmarkOverhead(void) {
+    uint32_t _overhead = 0xFFFFFFFF;
+    for (int i = 0; i < 100; i++) {
+        uint32_t _start = cycleCounterTicks();
+        uint32_t _ticks = cycleCounterTicks() - _start;
+        if (_ticks < _overhead) _overhead = _ticks;
+    }
+    return _overhead;
+}
+
+/**
+ * times a single kernel call and adds its duration to the total of a kernel
+ */
+#define BENCHMARK_KERNEL_CALL(kernel, call) { \
+    uint32_t _start = cycleCounterTicks(); \
+    call; \
+    uint32_t _ticks = cycleCounterTicks() - _start; \
+    _totalTicks[kernel] += _ticks > _overhead ? _ticks - _overhead : 0; \
+    _calls[kernel] += 1; \
+}
+
+/**
+ * runs every kernel of the detection loop over BENCHMARK_WINDOWS windows of some input and prints time per call of each kernel
+ * @param output Serial (target) or a Print object writing to a file (host)
+ * @param buffers scratch buffers
+ * @param label label printed in the first column (i.e. commit hash), so results of several runs can be compared
+ * @param inputName name of input printed in the input column
+ * @param input 12-bit ADC values sampled at sampleRate
+ * @param numSamples number of samples in input (at least windowSize)
+ * @param sampleRate sample rate of input
+ * @param windowSize window size (power of 2, at most BENCHMARK_MAX_WINDOW_SIZE)
+ */
+inline void runKernelBenchmarks(Print &output, kernelBenchmarkBuffers &buffers, const char *label, const char *inputName, const uint16_t *input,
+    uint32_t numSamples, uint16_t sampleRate, uint16_t windowSize) {
+
+    uint64_t _totalTicks[BENCHMARK_NUM_KERNELS] = { 0 };
+    uint32_t _calls[BENCHMARK_NUM_KERNELS] = { 0 };
+    uint32_t _overhead = benchmarkOverhead();
+
+    uint16_t _numBins = windowSize >> 1;
+    uint32_t _numWindows = numSamples / windowSize;
+    float _frequencyWidth = float(windowSize) / sampleRate;
+
+    CircularBuffer<uint16_t> _rawFreqsBuffer;
+    CircularBuffer<uint16_t> _historyBuffer;
+    CircularBuffer<uint16_t> _mirroredBuffer;
+    CircularBuffer<uint8_t> _quantizedBuffer;
+    _rawFreqsBuffer.setBuffer(buffers.rawFreqs, _numBins, 2);
+    _historyBuffer.setBuffer(buffers.history, _numBins, BENCHMARK_HISTORY);
+    _mirroredBuffer.setBuffer(buffers.history, _numBins, BENCHMARK_HISTORY, true);
+    _quantizedBuffer.setBuffer(buffers.quantizedHistory, _numBins, BENCHMARK_HISTORY, true);
+    _rawFreqsBuffer.clearBuffer();
+    _mirroredBuffer.clearBuffer();
+    _quantizedBuffer.clearBuffer();
+
+    ComputeWindow(buffers.hannWindow, windowSize, WINDOW_TYPE::WINDOW_HANN);
+    ComputeWindow(buffers.blackmanWindow, windowSize, WINDOW_TYPE::WINDOW_BLACKMAN);
+
+    // template only affects values, not timing, so a ramp is used
+    for (uint32_t i = 0; i < uint32_t(_numBins) * BENCHMARK_TEMPLATE_LENGTH; i++) {
+        buffers.correlationTemplate[i] = i % 37;
+    }
+    CrossCorrelation _correlation = CrossCorrelation(sampleRate, windowSize);
+    _correlation.setTemplate(buffers.correlationTemplate, _numBins, BENCHMARK_TEMPLATE_LENGTH, BENCHMARK_FREQUENCY_LOW, BENCHMARK_FREQUENCY_HIGH);
+
+    volatile float _correlationCoefficient = 0.0;
+
+    for (uint32_t w = 0; w < BENCHMARK_WINDOWS; w++) {
+        const uint16_t *_window = input + (w % _numWindows) * windowSize;
+
+        // fused conversion, DC removal and windowing, compared with copy loop plus DCRemoval() (which overwrites complexSamples)
+        BENCHMARK_KERNEL_CALL(BENCHMARK_DC_REMOVAL_WINDOW_RECTANGULAR, DCRemovalWindow(_window, buffers.complexSamples, NULL, windowSize));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_DC_REMOVAL_WINDOW_HANN, DCRemovalWindow(_window, buffers.complexSamples, buffers.hannWindow, windowSize));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_DC_REMOVAL_WINDOW_BLACKMAN, DCRemovalWindow(_window, buffers.complexSamples, buffers.blackmanWindow, windowSize));
+
+        BENCHMARK_KERNEL_CALL(BENCHMARK_COPY_TO_COMPLEX, for (uint16_t i = 0; i < windowSize; i++) buffers.complexSamples[i] = _window[i]);
+        BENCHMARK_KERNEL_CALL(BENCHMARK_DC_REMOVAL, DCRemoval(buffers.complexSamples, windowSize));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_FFT, Fast4::FFT(buffers.complexSamples, windowSize));
+
+        // every MAGNITUDE_MODE (scaled output, input is kept), scratchFloat is overwritten by noise removal below
+        BENCHMARK_KERNEL_CALL(BENCHMARK_MAGNITUDE_EXACT, ComplexToMagnitude(buffers.complexSamples, buffers.scratchFloat, _numBins, MAGNITUDE_MODE::MAGNITUDE_EXACT, _frequencyWidth));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_MAGNITUDE_ALPHA_MAX_BETA_MIN, ComplexToMagnitude(buffers.complexSamples, buffers.scratchFloat, _numBins, MAGNITUDE_MODE::MAGNITUDE_ALPHA_MAX_BETA_MIN, _frequencyWidth));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_MAGNITUDE_POWER, ComplexToMagnitude(buffers.complexSamples, buffers.scratchFloat, _numBins, MAGNITUDE_MODE::MAGNITUDE_POWER, _frequencyWidth));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_MAGNITUDE_LOG2, ComplexToMagnitude(buffers.complexSamples, buffers.scratchFloat, _numBins, MAGNITUDE_MODE::MAGNITUDE_LOG2, _frequencyWidth));
+
+        BENCHMARK_KERNEL_CALL(BENCHMARK_COMPLEX_TO_MAGNITUDE, ComplexToMagnitude(buffers.complexSamples, _numBins));
+
+        for (uint16_t i = 0; i < _numBins; i++) {
+            buffers.freqs[i] = buffers.complexSamples[i].re() * _frequencyWidth;
+        }
+
+        BENCHMARK_KERNEL_CALL(BENCHMARK_NOISE_REMOVAL_CFAR, NoiseRemoval_CFAR<float>(buffers.freqs, buffers.scratchFloat, _numBins, 2, 4, 1.0));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_NOISE_REMOVAL_ATM, NoiseRemoval_ATM<float>(buffers.freqs, buffers.scratchFloat, _numBins, 4, 2.75));
+
+        for (uint16_t i = 0; i < _numBins; i++) {
+            buffers.scratch[i] = round(buffers.scratchFloat[i]);
+        }
+
+        _rawFreqsBuffer.pushData(buffers.scratch);
+        BENCHMARK_KERNEL_CALL(BENCHMARK_TIME_SMOOTHING, TimeSmoothing<uint16_t>(buffers.rawFreqs, buffers.scratch, _numBins, 2));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_FREQUENCY_SMOOTHING, FrequencySmoothing<uint16_t>(buffers.scratch, buffers.smoothed, _numBins, 1));
+
+        // history buffers share storage (uint16_t history is only used for timing pushData and correlate)
+        BENCHMARK_KERNEL_CALL(BENCHMARK_PUSH_DATA, _historyBuffer.pushData(buffers.smoothed));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_PUSH_DATA_MIRRORED, _mirroredBuffer.pushData(buffers.smoothed));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_LOG_QUANTIZE, for (uint16_t i = 0; i < _numBins; i++) buffers.quantized[i] = LogQuantize(buffers.smoothed[i]));
+        _quantizedBuffer.pushData(buffers.quantized);
+
+        BENCHMARK_KERNEL_CALL(BENCHMARK_CORRELATE, _correlationCoefficient = _correlation.correlate(_mirroredBuffer.getLatest(BENCHMARK_HISTORY)));
+        BENCHMARK_KERNEL_CALL(BENCHMARK_CORRELATE_QUANTIZED, _correlationCoefficient = _correlation.correlate(_quantizedBuffer.getLatest(BENCHMARK_HISTORY), 0));
+    }
+
+    // correlation coefficients are only computed so the calls can't be optimized away
+    (void)_correlationCoefficient;
+
+    for (uint8_t k = 0; k < BENCHMARK_NUM_KERNELS; k++) {
+        output.printf("%s,%s,%s,%d,%lu,%lu,%s\n", label, benchmarkKernelNames[k], inputName, int(windowSize), (unsigned long)_calls[k],
+            (unsigned long)(_totalTicks[k] / (_calls[k] > 0 ? _calls[k] : 1)), BENCHMARK_UNIT);
+    }
+}
+
+/**
+ * prints CSV header of runKernelBenchmarks() results
+ * @param output Serial (target) or a Print object writing to a file (host)
+ */
+inline void printKernelBenchmarkHeader(Print &output) {
+    output.printf("label,kernel,input,window_size,calls,ticks_per_call,unit\n");
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+  This sketch runs the kernel microbenchmarks (KernelBenchmarks.h) on the Pied Piper (Feather M4) and prints the number of CPU cycles per call
+  of every DataProcessing kernel used by the detection loop, for several window sizes. The same benchmarks can be run on a host machine with
+  Utilities/KernelBenchmark.cpp. Results are printed to Serial as CSV, copy them to a file to compare them with results of other commits
+  (see Utilities/CompareBenchmarks.py).
+
+  Input is a generated signal (tones within the correlation frequency range plus noise), recordings are only benchmarked on host.
+*/
+
+#include <PiedPiper.h>
+#include "KernelBenchmarks.h"
+
+#define BENCHMARK_INPUT_LENGTH 4096  // number of generated input samples (at FFT_SAMPLE_RATE)
+
+const uint16_t windowSizes[] = { 64, 128, 256 };  // window sizes to benchmark
+
+kernelBenchmarkBuffers buffers;
+uint16_t input[BENCHMARK_INPUT_LENGTH];
+
+void setup() {
+  Serial.begin(2000000);
+
+  // wait for serial monitor, so no results are missed
+  while (!Serial)
+    ;
+
+  cycleCounterBegin();
+
+  generateBenchmarkTones(input, BENCHMARK_INPUT_LENGTH, FFT_SAMPLE_RATE);
+
+  printKernelBenchmarkHeader(Serial);
+  for (uint8_t i = 0; i < sizeof(windowSizes) / sizeof(windowSizes[0]); i++) {
+    runKernelBenchmarks(Serial, buffers, "m4", "tones", input, BENCHMARK_INPUT_LENGTH, FFT_SAMPLE_RATE, windowSizes[i]);
+  }
+
+  Serial.println("benchmarks complete");
+}
+
+void loop() {
+}
@@ -0,0 +1,139 @@
+// This is a C++ program used for converting wave files to the audio file formats used by the Pied Piper traps. It produces the same raw
+// playback files as AudioFileConverter.py (16-bit unsigned samples limited to the range [0, 2^12 - 1]), and can additionally encode
+// playback files with 4-bit IMA-ADPCM. IMA-ADPCM playback files take up a quarter of the space of raw playback files, both in RAM when the
+// sound is stored in PLAYBACK_FILE and in SD card bandwidth when the sound is streamed, and are decoded by the trap during playback.
+
+// #################################################### IMPORTANT #####################################################
+
+// Before using this tool you must first convert whatever audio you're using to a 16-bit PCM mono wave file with a 4096 Hz sample
+// frequency (see AudioFileConverter.py for instructions on doing this with Audacity). Wave files sampled at an integer multiple of 4096 Hz
+// are downsampled with the same windowed sinc filter design the trap uses for audio input (see Resampler.h).
+// Calibration sounds are compared against the recorded signal at full 12-bit resolution, prefer raw playback files for those.
+
+// #################################################### TO USE THIS UTILITY: #####################################################
+
+// 0. Make sure you read the text immediately above this procedure.
+// 1. Compile the program: g++ -O2 -o AudioFileConverter AudioFileConverter.cpp
+// 2. Run the program: ./AudioFileConverter "path_to_audio.wav" "path_to_output.PAD" [-adpcm]
+// 3. Copy the output file to the PBAUD directory of the SD card.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "../Dependencies/PiedPiper/src/Other/AdpcmCodec.h"
+#include "../Dependencies/PiedPiper/src/DataProcessing/Resampler.h"
+#include "WaveFile.h"
+
+#define DAC_RESOLUTION 12
+#define PLAYBACK_SAMPLE_RATE 4096       // SAMPLE_RATE
+#define RESAMPLE_ZERO_X 5               // SINC_FILTER_DOWNSAMPLE_ZERO_X
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: ./AudioFileConverter \"path_to_audio.wav\" \"path_to_output.PAD\" [-adpcm]\n");
+        return 1;
+    }
+
+    bool adpcm = argc > 3 && strcmp(argv[3], "-adpcm") == 0;
+
+    std::vector<int16_t> samples;
+    uint32_t sampleRate = 0;
+
+    if (!readWave(argv[1], samples, sampleRate) || samples.size() == 0) {
+        printf("Could not read %s, make sure it is a 16-bit PCM mono wave file\n", argv[1]);
+        return 1;
+    }
+
+    if (sampleRate > PLAYBACK_SAMPLE_RATE && sampleRate % PLAYBACK_SAMPLE_RATE == 0 && sampleRate / PLAYBACK_SAMPLE_RATE <= 255) {
+        uint8_t ratio = sampleRate / PLAYBACK_SAMPLE_RATE;
+
+        // sinc table of any ratio, the trap only uses tables generated at compile time
+        std::vector<float> table(2 * RESAMPLE_ZERO_X * ratio + 1);
+        for (size_t i = 0; i < table.size(); i++) {
+            table[i] = sincFilterValue(ratio, RESAMPLE_ZERO_X, ratio, i);
+        }
+
+        std::vector<int16_t> buffer(table.size() - 1 + 4096);
+        Resampler<int16_t> downsampler(RESAMPLER_MODE::RESAMPLER_DOWNSAMPLE, table.data(), table.size(), ratio, buffer.data(), buffer.size(),
+            -32768, 32767);
+
+        std::vector<int16_t> resampled(samples.size() / ratio);
+        uint32_t count = 0;
+        for (size_t i = 0; i < samples.size(); i += 0x8000) {
+            uint16_t blockSize = std::min(samples.size() - i, size_t(0x8000));
+            // space is limited to what fits in uint16_t, blocks of 0x8000 input samples never produce more than that
+            uint16_t space = std::min<size_t>(resampled.size() - count, 0xFFFF);
+            count += downsampler.process(samples.data() + i, blockSize, resampled.data() + count, space);
+        }
+
+        if (count != resampled.size()) {
+            printf("Downsampling produced %u samples instead of %zu\n", count, resampled.size());
+            return 1;
+        }
+
+        printf("Downsampled from %u Hz to %u Hz\n", sampleRate, PLAYBACK_SAMPLE_RATE);
+        samples.swap(resampled);
+        sampleRate = PLAYBACK_SAMPLE_RATE;
+    }
+
+    if (sampleRate != PLAYBACK_SAMPLE_RATE) printf("Warning: sample rate is %u Hz, the trap plays sounds at %u Hz\n", sampleRate, PLAYBACK_SAMPLE_RATE);
+
+    FILE *outFile = fopen(argv[2], "wb");
+    if (outFile == NULL) {
+        printf("Could not open %s\n", argv[2]);
+        return 1;
+    }
+
+    if (!adpcm) {
+        // same conversion as AudioFileConverter.py (including rounding half to even), values are written as is to DAC by the trap
+        double ratio = double(1 << DAC_RESOLUTION) / (1 << 16);
+        double offset = (1 << DAC_RESOLUTION) / 2;
+        int32_t maxVal = (1 << DAC_RESOLUTION) - 1;
+
+        for (size_t i = 0; i < samples.size(); i++) {
+            int32_t s = nearbyint(samples[i] * ratio + offset);
+            uint16_t value = s < 0 ? 0 : (s > maxVal ? maxVal : s);
+            fwrite(&value, 2, 1, outFile);
+        }
+    } else {
+        adpcmSoundHeader header;
+        header.magic = ADPCM_SOUND_MAGIC;
+        header.version = ADPCM_SOUND_VERSION;
+        header.headerSize = sizeof(header);
+        header.sampleCount = samples.size();
+        header.predictor = samples[0];
+        header.stepIndex = 0;
+        header.reserved = 0;
+
+        fwrite(&header, sizeof(header), 1, outFile);
+
+        adpcmState state = { header.predictor, header.stepIndex };
+        adpcmState decoder = state;
+        double errorSumSq = 0;
+
+        // two codes are stored per byte, first sample in low nibble
+        for (size_t i = 0; i < samples.size(); i += 2) {
+            uint8_t codes = adpcmEncode(state, samples[i]);
+            if (i + 1 < samples.size()) codes |= adpcmEncode(state, samples[i + 1]) << 4;
+            fwrite(&codes, 1, 1, outFile);
+
+            // decoding to report error in DAC values
+            for (size_t j = i; j < i + 2 && j < samples.size(); j++) {
+                int32_t expected = nearbyint(samples[j] * double(1 << DAC_RESOLUTION) / (1 << 16) + (1 << (DAC_RESOLUTION - 1)));
+                int32_t decoded = adpcmSampleToDAC(adpcmDecode(decoder, j == i ? codes & 0xF : codes >> 4), DAC_RESOLUTION);
+                errorSumSq += double(decoded - expected) * (decoded - expected);
+            }
+        }
+
+        printf("IMA-ADPCM RMS error: %.2f DAC values\n", sqrt(errorSumSq / samples.size()));
+    }
+
+    fclose(outFile);
+
+    printf("%zu samples (%.2f s) written to %s\n", samples.size(), double(samples.size()) / sampleRate, argv[2]);
+
+    return 0;
+}
@@ -15,8 +15,9 @@
     # 5. In the "Encoding" dropdown at the bottom of the export window, select "Signed 16-bit PCM"
     # 6. Save the exported audio.
     
-# Additionally, make sure that the audio file is no longer than eight seconds, because only (4096 Hz) x (8 s) = 32 kB of RAM is
-# allocated for storing playback audio.
+# Additionally, note that only (4096 Hz) x (PLAYBACK_FILE_LENGTH = 2 s) = 8192 samples of RAM are allocated for storing playback audio.
+# Longer audio files are streamed from the SD card during playback, which requires the SD card to stay powered while the sound plays.
+# Calibration sounds are played while audio input is sampled and must fit in RAM.
 
 #################################################### TO USE THIS UTILITY: #####################################################
 
@@ -0,0 +1,146 @@
+// This is a C++ program used for checking the host simulator backend of AudioStream (Other/AudioStream.cpp), which host utilities and
+// tests of code using AudioStream rely on. A known ramp is pushed through the simulated ADC and a known sequence is generated by the
+// output callback, then the program checks that:
+//   input   - input blocks arrive in order and hold the ramp without gaps or repeats (ADC mid scale once the ramp is exhausted)
+//   output  - the simulated DAC plays the generated sequence in order, without gaps or repeats
+//   lead    - output is generated exactly two blocks ahead of being played, as documented in AudioStream.h
+// Every block size in blockSizes is checked, as the simulator is started anew for each.
+
+// #################################################### IMPORTANT #####################################################
+
+// Only the host backend is checked, the target backend (TC2, EVSYS, DMA) has to be checked on the trap.
+
+// #################################################### TO USE THIS UTILITY: #####################################################
+
+// 1. Compile the program (from the Utilities directory):
+//    g++ -O2 -pthread -IHostShim -I../Dependencies/PiedPiper/src -o AudioStreamCheck AudioStreamCheck.cpp
+//        ../Dependencies/PiedPiper/src/Other/AudioStream.cpp
+// 2. Run the program: ./AudioStreamCheck   (exit code is 1 on failure)
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "Other/AudioStream.h"
+
+#define CHECK_SAMPLE_RATE 4096      // sample rate of audio stream on the trap (SAMPLE_RATE)
+#define CHECK_RAMP_BLOCKS 16        // number of blocks of ramp input
+#define CHECK_EXTRA_BLOCKS 4        // number of blocks streamed after the ramp is exhausted
+#define CHECK_OUTPUT_LEAD 2         // number of blocks output is generated ahead of being played
+
+const uint16_t blockSizes[] = { 1, 32, 64, AUDIO_STREAM_MAX_BLOCK_SIZE };
+
+// state shared with the callbacks, which run on the simulator thread
+std::vector<uint16_t> received;
+uint32_t receivedCapacity = 0;
+uint32_t generated = 0;
+uint32_t outputCalls = 0;
+uint32_t leadErrors = 0;
+uint16_t currentBlockSize = 0;
+std::atomic<uint32_t> inputCalls(0);
+
+void inputCallback(uint16_t *block, uint16_t count) {
+    for (uint16_t i = 0; i < count && received.size() < receivedCapacity; i++) {
+        received.push_back(block[i]);
+    }
+    inputCalls += 1;
+}
+
+void outputCallback(uint16_t *block, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        block[i] = generated++ & 0xFFFF;
+    }
+    outputCalls += 1;
+
+    // first two blocks are generated by start() before anything is played, simulated DAC stops recording once its buffer is full
+    uint32_t _leadSamples = uint32_t(CHECK_OUTPUT_LEAD) * currentBlockSize;
+    if (outputCalls > CHECK_OUTPUT_LEAD && generated <= receivedCapacity + _leadSamples && generated - AudioStream::getSimulatedOutputCount() != _leadSamples) {
+        leadErrors += 1;
+    }
+}
+
+bool checkBlockSize(uint16_t blockSize) {
+    uint32_t _rampLength = uint32_t(CHECK_RAMP_BLOCKS) * blockSize;
+    uint32_t _totalLength = _rampLength + uint32_t(CHECK_EXTRA_BLOCKS) * blockSize;
+    uint16_t _adcMid = 1 << (ADC_RESOLUTION - 1);
+
+    std::vector<uint16_t> _ramp(_rampLength);
+    for (uint32_t i = 0; i < _rampLength; i++) _ramp[i] = i % (1 << ADC_RESOLUTION);
+
+    std::vector<uint16_t> _played(_totalLength);
+
+    received.clear();
+    received.reserve(_totalLength);
+    receivedCapacity = _totalLength;
+    generated = 0;
+    outputCalls = 0;
+    leadErrors = 0;
+    currentBlockSize = blockSize;
+    inputCalls = 0;
+
+    AudioStream::setSimulatedInput(_ramp.data(), _rampLength, false);
+    AudioStream::setSimulatedOutput(_played.data(), _totalLength);
+    AudioStream::setSimulatedRealTime(false);
+
+    if (!AudioStream::start(CHECK_SAMPLE_RATE, blockSize, inputCallback, outputCallback)) {
+        printf("block size %d: start() failed\n", blockSize);
+        return false;
+    }
+
+    // simulator runs as fast as possible, blocks beyond the capacities are streamed but not recorded
+    while (inputCalls < CHECK_RAMP_BLOCKS + CHECK_EXTRA_BLOCKS) std::this_thread::yield();
+    AudioStream::stop();
+
+    bool _passed = true;
+
+    if (received.size() != _totalLength || AudioStream::getSimulatedOutputCount() != _totalLength) {
+        printf("block size %d: %zu input, %u output samples streamed, expected %u\n", blockSize, received.size(),
+            AudioStream::getSimulatedOutputCount(), _totalLength);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < _totalLength; i++) {
+        uint16_t _expected = i < _rampLength ? _ramp[i] : _adcMid;
+        if (received[i] != _expected) {
+            printf("block size %d: input sample %u is %d, expected %d\n", blockSize, i, received[i], _expected);
+            _passed = false;
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < _totalLength; i++) {
+        if (_played[i] != (i & 0xFFFF)) {
+            printf("block size %d: output sample %u is %d, expected %d\n", blockSize, i, _played[i], int(i & 0xFFFF));
+            _passed = false;
+            break;
+        }
+    }
+
+    if (leadErrors > 0) {
+        printf("block size %d: output was not generated %d blocks ahead of being played %u times\n", blockSize, CHECK_OUTPUT_LEAD, leadErrors);
+        _passed = false;
+    }
+
+    return _passed;
+}
+
+int main() {
+    bool passed = true;
+
+    for (uint16_t blockSize : blockSizes) {
+        passed = checkBlockSize(blockSize) && passed;
+    }
+
+    if (AudioStream::start(CHECK_SAMPLE_RATE, 0, inputCallback, outputCallback) ||
+        AudioStream::start(CHECK_SAMPLE_RATE, AUDIO_STREAM_MAX_BLOCK_SIZE + 1, inputCallback, outputCallback) ||
+        AudioStream::start(CHECK_SAMPLE_RATE, 64, NULL, NULL)) {
+        printf("start() accepted an invalid configuration\n");
+        AudioStream::stop();
+        passed = false;
+    }
+
+    printf(passed ? "audio stream passed\n" : "audio stream FAILED\n");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+# Compares two kernel benchmark result files (written by KernelBenchmark.cpp or copied from the output of the PiedPiperBenchmark sketch)
+# and prints the change in time per call of every kernel, input and window size found in both files.
+#
+# usage: python3 CompareBenchmarks.py "before.csv" "after.csv" [threshold]
+# Rows which got slower by more than threshold (default 0.1, 10%) are marked, and the exit code is 1 if there are any.
+
+import csv, sys
+
+def loadResults(filename):
+    results = {}
+    with open(filename) as file:
+        for row in csv.DictReader(line for line in file if "," in line):
+            key = (row["kernel"], row["input"], int(row["window_size"]))
+            results[key] = (float(row["ticks_per_call"]), row["unit"])
+    return results
+
+if len(sys.argv) < 3:
+    print("usage: python3 CompareBenchmarks.py \"before.csv\" \"after.csv\" [threshold]")
+    sys.exit(1)
+
+before = loadResults(sys.argv[1])
+after = loadResults(sys.argv[2])
+threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 0.1
+
+regressions = 0
+print("%-40s %-24s %6s %12s %12s %8s" % ("kernel", "input", "window", "before", "after", "change"))
+for key in sorted(set(before) & set(after)):
+    ticksBefore, unit = before[key]
+    ticksAfter, _ = after[key]
+    change = (ticksAfter - ticksBefore) / ticksBefore if ticksBefore > 0 else 0.0
+    marker = ""
+    if change > threshold:
+        marker = " <-- slower"
+        regressions += 1
+    print("%-40s %-24s %6d %9d %-2s %9d %-2s %+7.1f%%%s" % (key[0], key[1], key[2], ticksBefore, unit[:2], ticksAfter, unit[:2], change * 100, marker))
+
+sys.exit(1 if regressions > 0 else 0)
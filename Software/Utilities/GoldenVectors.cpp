@@ -0,0 +1,545 @@
+// This is a C++ program used for generating and checking golden vectors of the detection signal chain (PiedPiper.ino loop()), so that
+// optimizations of DataProcessing kernels (faster FFT, fixed-point, sliding window smoothing...) can be shown not to change detection
+// behavior. For every input (recordings in Utilities and a synthetic signal) the outputs of each stage are stored per window:
+//   decimation   - downsampled input samples (same Resampler as RecordBlock())
+//   magnitudes   - FFT magnitudes scaled by FREQ_WIDTH (DCRemovalWindow(), Fast4::FFT(), ComplexToMagnitude())
+//   noise        - NoiseRemoval_ATM() output
+//   smoothing    - TimeSmoothing() and FrequencySmoothing() output
+//   correlation  - correlation coefficient against the BMSB template (LogQuantize() history, CrossCorrelation::correlate())
+// When checking, every stage is run on the stored output of the previous stage, so differences are attributed to the kernel which
+// caused them, and compared against a per-stage tolerance (see stageTolerances). The whole chain is then run end to end and positive
+// correlation decisions (coefficient >= threshold) must match the stored ones for every threshold in decisionThresholds.
+// Note: at the default threshold (GOLDEN_CORRELATION_THRESHOLD) only the synthetic input has positive windows, none of the real
+// recordings reach it (BMSB.wav peaks at 0.735, the trial26 recordings at 0.67), so at the default threshold real recordings currently
+// only test "no false positives". Lower thresholds (a valid correlation_thresh setting) are swept so that decisions on real recordings
+// with positive windows are gated as well (BMSB.wav has 6 positive windows at 0.7, both trial26 recordings have some at 0.6).
+
+// #################################################### IMPORTANT #####################################################
+
+// The signal chain below is a copy of processChannel() of PiedPiper.ino (with default detection settings: rectangular window, ATM noise
+// removal, no echo cancelling or degradation) and recordBlock() in AudioInputOutput.cpp, and must be kept in sync with them. Only regenerate
+// golden vectors when a change of detection behavior is intended (and say so in the commit), otherwise optimizations can't be checked.
+
+// #################################################### TO USE THIS UTILITY: #####################################################
+
+// 1. Compile the program (from the Utilities directory):
+//    g++ -O2 -IHostShim -I../Dependencies/Fast4ier -I../Dependencies/PiedPiper/src -o GoldenVectors GoldenVectors.cpp
+//        ../Dependencies/Fast4ier/Fast4ier.cpp ../Dependencies/Fast4ier/complex.cpp ../Dependencies/PiedPiper/src/DataProcessing/*.cpp
+// 2. Check the current kernels: ./GoldenVectors check [directory]   (directory defaults to GoldenVectors, exit code is 1 on failure)
+// 3. Regenerate golden vectors: ./GoldenVectors generate [directory]
+// 4. Measure accuracy and detection impact of each MAGNITUDE_MODE against golden vectors: ./GoldenVectors modes [directory]
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "DataProcessing/DataProcessing.h"
+#include "DataProcessing/SincFilter.h"
+#include "DataProcessing/Resampler.h"
+#include "Other/TemplateFile.h"
+#include "WaveFile.h"
+
+#define GOLDEN_FILE_MAGIC 0x56475050UL  // "PPGV" stored little-endian at the start of a golden vector file
+#define GOLDEN_FILE_VERSION 1
+
+// constants of PiedPiperSettings.h / PiedPiper.h
+#define GOLDEN_RAW_SAMPLE_RATE 4096     // SAMPLE_RATE
+#define GOLDEN_DOWNSAMPLE_RATIO 2       // AUD_IN_DOWNSAMPLE_RATIO
+#define GOLDEN_DOWNSAMPLE_ZERO_X 5      // SINC_FILTER_DOWNSAMPLE_ZERO_X
+#define GOLDEN_ADC_MAX 4095             // ADC_MAX
+#define GOLDEN_WINDOW_SIZE 128          // FFT_WINDOW_SIZE
+#define GOLDEN_NUM_BINS 64              // FFT_WINDOW_SIZE_BY2
+#define GOLDEN_SAMPLE_RATE 2048         // FFT_SAMPLE_RATE
+
+// defaults of detectionSettings (PiedPiper.h), stored in the header of each golden vector file
+#define GOLDEN_NOISE_SIZE 4
+#define GOLDEN_NOISE_THRESHOLD 2.75
+#define GOLDEN_TIME_SMOOTHING 2
+#define GOLDEN_FREQ_SMOOTHING 1
+#define GOLDEN_HISTORY_WINDOWS 128      // rec_time * FFT_SAMPLE_RATE / FFT_WINDOW_SIZE
+#define GOLDEN_FREQUENCY_RANGE_LOW 50
+#define GOLDEN_FREQUENCY_RANGE_HIGH 110
+#define GOLDEN_CORRELATION_THRESHOLD 0.8
+
+// thresholds at which end to end correlation decisions are compared, real recordings only have positive windows below the default one
+const float decisionThresholds[] = { 0.5, 0.6, 0.7, GOLDEN_CORRELATION_THRESHOLD };
+
+#define GOLDEN_SYNTHETIC_LENGTH 16384   // length of synthetic input (raw samples, 4 seconds)
+
+const char *templateFilename = "../SD Template/TEMPS/BMSB.BIN";
+const char *recordings[] = { "BMSB.wav", "BMSB_CAL.wav", "trial26_resampled1.wav", "trial26_resampled2.wav" };
+
+/**
+ * header of a golden vector file (i.e. "GoldenVectors/BMSB.GV"). The header is followed by numRawSamples uint16_t raw ADC samples (input of
+ * the signal chain) and numWindows goldenWindow records
+ */
+struct goldenFileHeader {
+    uint32_t magic;                 ///< must be equal to GOLDEN_FILE_MAGIC
+    uint16_t version;               ///< must be equal to GOLDEN_FILE_VERSION
+    uint16_t headerSize;            ///< size of this header in bytes
+    uint32_t numRawSamples;         ///< number of raw ADC samples (at GOLDEN_RAW_SAMPLE_RATE)
+    uint16_t numWindows;            ///< number of windows
+    uint16_t windowSize;            ///< window size (GOLDEN_WINDOW_SIZE)
+    uint8_t noiseRemovalSize;       ///< detection settings used for generating the file
+    uint8_t timeSmoothing;
+    uint8_t freqSmoothing;
+    uint8_t reserved;
+    float noiseRemovalThreshold;
+    uint32_t templateChecksum;      ///< checksum of correlation template used for generating the file
+};
+
+/**
+ * outputs of every stage of the signal chain for a single window
+ */
+struct goldenWindow {
+    uint16_t decimation[GOLDEN_WINDOW_SIZE];
+    float magnitudes[GOLDEN_NUM_BINS];
+    float noise[GOLDEN_NUM_BINS];
+    uint16_t smoothing[GOLDEN_NUM_BINS];
+    float correlation;
+};
+
+enum GOLDEN_STAGE {
+    STAGE_DECIMATION = 0,
+    STAGE_MAGNITUDES,
+    STAGE_NOISE,
+    STAGE_SMOOTHING,
+    STAGE_CORRELATION,
+    NUM_STAGES
+};
+
+/**
+ * tolerance of a stage, a value is within tolerance if |value - reference| <= absolute + relative * |reference|, a stage passes if the
+ * fraction of values outside tolerance is at most maxOutliers (thresholding kernels may flip values close to their threshold)
+ */
+struct stageTolerance {
+    const char *name;
+    double absolute;
+    double relative;
+    double maxOutliers;
+};
+
+const stageTolerance stageTolerances[NUM_STAGES] = {
+    { "decimation", 1.0, 0.0, 0.0 },
+    { "magnitudes", 0.05, 1e-4, 0.0 },
+    { "noise", 0.05, 1e-4, 0.002 },
+    { "smoothing", 1.0, 0.0, 0.002 },
+    { "correlation", 0.005, 0.0, 0.01 }
+};
+
+/**
+ * signal chain of PiedPiper.ino loop(), each stage can be fed with the output of the previous stage or with a stored golden output
+ */
+class SignalChain
+{
+    private:
+        float noiseRemovalThreshold;
+        uint8_t noiseRemovalSize, timeSmoothing, freqSmoothing;
+
+        typedef SincFilterTable<GOLDEN_DOWNSAMPLE_RATIO, GOLDEN_DOWNSAMPLE_ZERO_X, GOLDEN_DOWNSAMPLE_RATIO> DownsampleSincFilter;
+
+        uint16_t downsampleFilterInput[DownsampleSincFilter::SIZE - 1 + GOLDEN_WINDOW_SIZE];
+        Resampler<uint16_t> downsampler;
+
+        std::vector<uint16_t> rawFreqs;
+        std::vector<uint8_t> processedFreqs;
+        CircularBuffer<uint16_t> rawFreqsBuffer;
+        CircularBuffer<uint8_t> processedFreqsBuffer;
+        uint16_t processedFreqsFirstRow, processedFreqsNumRows;
+
+        CrossCorrelation correlation;
+
+        MAGNITUDE_MODE magnitudeMode;
+        std::vector<uint16_t> modeTemplate;
+
+    public:
+        SignalChain(const goldenFileHeader &header, uint16_t *correlationTemplate, const templateFileHeader &templateHeader,
+            MAGNITUDE_MODE magnitudeMode = MAGNITUDE_MODE::MAGNITUDE_EXACT)
+            : downsampler(RESAMPLER_MODE::RESAMPLER_DOWNSAMPLE, DownsampleSincFilter::values, DownsampleSincFilter::SIZE, GOLDEN_DOWNSAMPLE_RATIO,
+                this->downsampleFilterInput, sizeof(this->downsampleFilterInput) / sizeof(uint16_t), 0, GOLDEN_ADC_MAX),
+              correlation(GOLDEN_SAMPLE_RATE, GOLDEN_WINDOW_SIZE) {
+            this->noiseRemovalThreshold = header.noiseRemovalThreshold;
+            this->noiseRemovalSize = header.noiseRemovalSize;
+            this->timeSmoothing = header.timeSmoothing;
+            this->freqSmoothing = header.freqSmoothing;
+
+            // same as PiedPiperBase::loadTemplate() for a binary template file
+            this->correlation.setTemplate(correlationTemplate, GOLDEN_NUM_BINS, templateHeader.numCols, GOLDEN_FREQUENCY_RANGE_LOW,
+                GOLDEN_FREQUENCY_RANGE_HIGH, templateHeader.templateSqrtSumSq);
+
+            // same conversion of template as setup() of PiedPiper.ino
+            this->magnitudeMode = magnitudeMode;
+            if (magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_POWER || magnitudeMode == MAGNITUDE_MODE::MAGNITUDE_LOG2) {
+                this->modeTemplate.resize(uint32_t(GOLDEN_NUM_BINS) * templateHeader.numCols);
+                for (size_t i = 0; i < this->modeTemplate.size(); i++) {
+                    this->modeTemplate[i] = round(fmin(MagnitudeToMode(correlationTemplate[i], magnitudeMode), 65535.0f));
+                }
+                this->correlation.setTemplate(this->modeTemplate.data(), GOLDEN_NUM_BINS, templateHeader.numCols, GOLDEN_FREQUENCY_RANGE_LOW,
+                    GOLDEN_FREQUENCY_RANGE_HIGH);
+            }
+
+            // processed history only stores bins used for correlation
+            this->processedFreqsFirstRow = this->correlation.getFrequencyIndexLow();
+            this->processedFreqsNumRows = this->correlation.getFrequencyIndexHigh() - this->processedFreqsFirstRow;
+
+            this->rawFreqs.assign(GOLDEN_NUM_BINS * this->timeSmoothing, 0);
+            this->processedFreqs.assign(CircularBuffer<uint8_t>::elementsRequired(this->processedFreqsNumRows, GOLDEN_HISTORY_WINDOWS, true), 0);
+            this->rawFreqsBuffer.setBuffer(this->rawFreqs.data(), GOLDEN_NUM_BINS, this->timeSmoothing);
+            this->processedFreqsBuffer.setBuffer(this->processedFreqs.data(), this->processedFreqsNumRows, GOLDEN_HISTORY_WINDOWS, true);
+        }
+
+        // same resampler as PiedPiperBase::recordBlock(), returns true if a downsampled sample was written to output
+        bool decimate(uint16_t sample, uint16_t &output) {
+            return this->downsampler.process(&sample, 1, &output, 1) > 0;
+        }
+
+        void magnitudes(const uint16_t *samples, float *freqs) {
+            complex _complexSamples[GOLDEN_WINDOW_SIZE];
+            DCRemovalWindow(samples, _complexSamples, NULL, GOLDEN_WINDOW_SIZE);
+            Fast4::FFT(_complexSamples, GOLDEN_WINDOW_SIZE);
+            ComplexToMagnitude(_complexSamples, freqs, GOLDEN_NUM_BINS, this->magnitudeMode, float(GOLDEN_WINDOW_SIZE) / GOLDEN_SAMPLE_RATE);
+        }
+
+        void noiseRemoval(const float *freqs, float *output) {
+            float _freqs[GOLDEN_NUM_BINS];
+            memcpy(_freqs, freqs, sizeof(_freqs));
+            NoiseRemoval_ATM<float>(_freqs, output, GOLDEN_NUM_BINS, this->noiseRemovalSize, this->noiseRemovalThreshold);
+        }
+
+        void smoothing(const float *noise, uint16_t *output) {
+            uint16_t _scratch[GOLDEN_NUM_BINS];
+            for (int i = 0; i < GOLDEN_NUM_BINS; i++) {
+                _scratch[i] = round(fmin(noise[i], 65535.0f));
+            }
+
+            this->rawFreqsBuffer.pushData(_scratch);
+            TimeSmoothing<uint16_t>(this->rawFreqs.data(), _scratch, GOLDEN_NUM_BINS, this->timeSmoothing);
+            FrequencySmoothing<uint16_t>(_scratch, output, GOLDEN_NUM_BINS, this->freqSmoothing);
+        }
+
+        float correlate(const uint16_t *smoothed) {
+            uint8_t _quantized[GOLDEN_NUM_BINS];
+            for (int i = 0; i < this->processedFreqsNumRows; i++) {
+                _quantized[i] = LogQuantize(smoothed[this->processedFreqsFirstRow + i]);
+            }
+            this->processedFreqsBuffer.pushData(_quantized);
+
+            return this->correlation.correlate(this->processedFreqsBuffer.getLatest(GOLDEN_HISTORY_WINDOWS), this->processedFreqsFirstRow);
+        }
+
+        // runs whole chain on raw samples, one goldenWindow per complete window
+        void run(const std::vector<uint16_t> &rawSamples, std::vector<goldenWindow> &windows) {
+            goldenWindow _window;
+            uint16_t _count = 0;
+
+            windows.clear();
+            for (size_t i = 0; i < rawSamples.size(); i++) {
+                if (!this->decimate(rawSamples[i], _window.decimation[_count])) continue;
+                if (++_count < GOLDEN_WINDOW_SIZE) continue;
+                _count = 0;
+
+                this->magnitudes(_window.decimation, _window.magnitudes);
+                this->noiseRemoval(_window.magnitudes, _window.noise);
+                this->smoothing(_window.noise, _window.smoothing);
+                _window.correlation = this->correlate(_window.smoothing);
+                windows.push_back(_window);
+            }
+        }
+};
+
+/**
+ * accumulates differences of a stage against golden outputs
+ */
+struct stageResult {
+    uint32_t count = 0;
+    uint32_t outliers = 0;
+    double maxError = 0.0;
+
+    void compare(const stageTolerance &tolerance, double value, double reference) {
+        double _error = fabs(value - reference);
+        if (_error > this->maxError) this->maxError = _error;
+        if (_error > tolerance.absolute + tolerance.relative * fabs(reference)) this->outliers += 1;
+        this->count += 1;
+    }
+
+    bool passed(const stageTolerance &tolerance) const {
+        return this->outliers <= tolerance.maxOutliers * this->count;
+    }
+};
+
+// converts 16-bit samples to 12-bit ADC values (same conversion as AudioFileConverter)
+void recordingToAdcSamples(const std::vector<int16_t> &recording, std::vector<uint16_t> &samples) {
+    samples.resize(recording.size());
+    for (size_t i = 0; i < recording.size(); i++) {
+        int32_t _value = nearbyint(recording[i] * (4096.0 / 65536.0) + 2048);
+        samples[i] = _value < 0 ? 0 : (_value > 4095 ? 4095 : _value);
+    }
+}
+
+// synthetic input: 75 Hz tone within correlation band with a slowly rising amplitude, 300 Hz tone and noise (linear congruential generator)
+void generateSynthetic(std::vector<uint16_t> &samples) {
+    uint32_t _noise = 12345;
+    samples.resize(GOLDEN_SYNTHETIC_LENGTH);
+    for (uint32_t i = 0; i < GOLDEN_SYNTHETIC_LENGTH; i++) {
+        double _t = double(i) / GOLDEN_RAW_SAMPLE_RATE;
+        double _value = 600.0 * _t / 4.0 * sin(2.0 * PI * 75.0 * _t) + 200.0 * sin(2.0 * PI * 300.0 * _t);
+        _noise = _noise * 1664525UL + 1013904223UL;
+        _value += int32_t(_noise >> 23) - 256;
+        int32_t _rounded = nearbyint(_value + 2048);
+        samples[i] = _rounded < 0 ? 0 : (_rounded > 4095 ? 4095 : _rounded);
+    }
+}
+
+bool loadTemplate(std::vector<uint16_t> &values, templateFileHeader &header) {
+    FILE *file = fopen(templateFilename, "rb");
+    if (file == NULL) return false;
+
+    bool _valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == TEMPLATE_FILE_MAGIC && header.numRows == GOLDEN_NUM_BINS;
+    if (_valid) {
+        values.resize(uint32_t(header.numRows) * header.numCols);
+        _valid = fread(values.data(), sizeof(uint16_t), values.size(), file) == values.size();
+    }
+    fclose(file);
+
+    return _valid && fnv1aHash(values.data(), values.size() * sizeof(uint16_t)) == header.checksum;
+}
+
+bool writeGoldenFile(const std::string &filename, const goldenFileHeader &header, const std::vector<uint16_t> &rawSamples, const std::vector<goldenWindow> &windows) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == NULL) return false;
+
+    bool _success = fwrite(&header, sizeof(header), 1, file) == 1;
+    _success = _success && fwrite(rawSamples.data(), sizeof(uint16_t), rawSamples.size(), file) == rawSamples.size();
+    _success = _success && fwrite(windows.data(), sizeof(goldenWindow), windows.size(), file) == windows.size();
+    fclose(file);
+
+    return _success;
+}
+
+bool readGoldenFile(const std::string &filename, goldenFileHeader &header, std::vector<uint16_t> &rawSamples, std::vector<goldenWindow> &windows) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == NULL) return false;
+
+    bool _valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == GOLDEN_FILE_MAGIC &&
+        header.version == GOLDEN_FILE_VERSION && header.headerSize == sizeof(header) && header.windowSize == GOLDEN_WINDOW_SIZE;
+    if (_valid) {
+        rawSamples.resize(header.numRawSamples);
+        windows.resize(header.numWindows);
+        _valid = fread(rawSamples.data(), sizeof(uint16_t), rawSamples.size(), file) == rawSamples.size() &&
+            fread(windows.data(), sizeof(goldenWindow), windows.size(), file) == windows.size();
+    }
+    fclose(file);
+
+    return _valid;
+}
+
+// checks one golden vector file, prints result of every stage, returns false if any stage or detection decision differs
+bool checkGoldenFile(const std::string &filename, std::vector<uint16_t> &correlationTemplate, const templateFileHeader &templateHeader) {
+    goldenFileHeader header;
+    std::vector<uint16_t> rawSamples;
+    std::vector<goldenWindow> golden;
+
+    if (!readGoldenFile(filename, header, rawSamples, golden)) {
+        printf("%s: could not read golden vector file\n", filename.c_str());
+        return false;
+    }
+    if (header.templateChecksum != templateHeader.checksum) {
+        printf("%s: generated with a different correlation template\n", filename.c_str());
+        return false;
+    }
+
+    stageResult results[NUM_STAGES];
+
+    // stages in isolation, each stage gets golden output of previous stage
+    SignalChain isolated = SignalChain(header, correlationTemplate.data(), templateHeader);
+    uint16_t _decimated[GOLDEN_WINDOW_SIZE];
+    uint16_t _count = 0;
+    uint32_t _window = 0;
+    for (size_t i = 0; i < rawSamples.size() && _window < golden.size(); i++) {
+        if (!isolated.decimate(rawSamples[i], _decimated[_count])) continue;
+        if (++_count < GOLDEN_WINDOW_SIZE) continue;
+        _count = 0;
+
+        const goldenWindow &_golden = golden[_window++];
+        goldenWindow _output;
+
+        isolated.magnitudes(_golden.decimation, _output.magnitudes);
+        isolated.noiseRemoval(_golden.magnitudes, _output.noise);
+        isolated.smoothing(_golden.noise, _output.smoothing);
+        _output.correlation = isolated.correlate(_golden.smoothing);
+
+        for (int s = 0; s < GOLDEN_WINDOW_SIZE; s++) results[STAGE_DECIMATION].compare(stageTolerances[STAGE_DECIMATION], _decimated[s], _golden.decimation[s]);
+        for (int f = 0; f < GOLDEN_NUM_BINS; f++) {
+            results[STAGE_MAGNITUDES].compare(stageTolerances[STAGE_MAGNITUDES], _output.magnitudes[f], _golden.magnitudes[f]);
+            results[STAGE_NOISE].compare(stageTolerances[STAGE_NOISE], _output.noise[f], _golden.noise[f]);
+            results[STAGE_SMOOTHING].compare(stageTolerances[STAGE_SMOOTHING], _output.smoothing[f], _golden.smoothing[f]);
+        }
+        results[STAGE_CORRELATION].compare(stageTolerances[STAGE_CORRELATION], _output.correlation, _golden.correlation);
+    }
+
+    bool _passed = _window == golden.size();
+
+    printf("%s (%d windows)\n", filename.c_str(), int(golden.size()));
+    for (int s = 0; s < NUM_STAGES; s++) {
+        bool _stagePassed = results[s].passed(stageTolerances[s]);
+        printf("  %-12s max error %10.6f, %5d / %6d outside tolerance  %s\n", stageTolerances[s].name, results[s].maxError,
+            int(results[s].outliers), int(results[s].count), _stagePassed ? "ok" : "FAILED");
+        _passed = _passed && _stagePassed;
+    }
+
+    // whole chain, positive correlations must match unless golden coefficient is within tolerance of threshold
+    SignalChain chain = SignalChain(header, correlationTemplate.data(), templateHeader);
+    std::vector<goldenWindow> output;
+    chain.run(rawSamples, output);
+
+    for (float _threshold : decisionThresholds) {
+        uint32_t _decisions = 0, _mismatches = 0;
+        for (size_t w = 0; w < output.size() && w < golden.size(); w++) {
+            bool _positive = output[w].correlation >= _threshold;
+            bool _goldenPositive = golden[w].correlation >= _threshold;
+            if (_goldenPositive) _decisions += 1;
+            if (_positive != _goldenPositive && fabs(golden[w].correlation - _threshold) > stageTolerances[STAGE_CORRELATION].absolute) _mismatches += 1;
+        }
+        bool _chainPassed = output.size() == golden.size() && _mismatches == 0;
+        printf("  %-12s threshold %.2f: %3d positive correlations, %d mismatched  %s\n", "end to end", _threshold, int(_decisions),
+            int(_mismatches), _chainPassed ? "ok" : "FAILED");
+        _passed = _passed && _chainPassed;
+    }
+
+    return _passed;
+}
+
+const char *magnitudeModeNames[] = { "exact", "alpha_max_beta_min", "power", "log2" };
+
+// converts output of a MAGNITUDE_MODE back to exact magnitude (inverse of MagnitudeToMode())
+double modeToMagnitude(double value, MAGNITUDE_MODE mode) {
+    if (mode == MAGNITUDE_MODE::MAGNITUDE_POWER) return sqrt(value * MAGNITUDE_POWER_SCALE);
+    if (mode == MAGNITUDE_MODE::MAGNITUDE_LOG2) return value > 0 ? pow(2.0, value / LOG2_MAGNITUDE_SCALE) : 1.0;
+    return value;
+}
+
+// runs whole chain with every MAGNITUDE_MODE on inputs of one golden vector file and prints error of magnitudes (relative to golden
+// magnitudes above 1, as MAGNITUDE_LOG2 limits smaller magnitudes) and how many positive correlation decisions differ from golden ones
+bool compareMagnitudeModes(const std::string &filename, std::vector<uint16_t> &correlationTemplate, const templateFileHeader &templateHeader) {
+    goldenFileHeader header;
+    std::vector<uint16_t> rawSamples;
+    std::vector<goldenWindow> golden;
+
+    if (!readGoldenFile(filename, header, rawSamples, golden) || header.templateChecksum != templateHeader.checksum) {
+        printf("%s: could not read golden vector file or generated with a different correlation template\n", filename.c_str());
+        return false;
+    }
+
+    uint32_t _goldenPositives = 0;
+    for (size_t w = 0; w < golden.size(); w++) {
+        if (golden[w].correlation >= GOLDEN_CORRELATION_THRESHOLD) _goldenPositives += 1;
+    }
+
+    printf("%s (%d windows, %d positive correlations)\n", filename.c_str(), int(golden.size()), int(_goldenPositives));
+    for (int m = MAGNITUDE_MODE::MAGNITUDE_EXACT; m <= MAGNITUDE_MODE::MAGNITUDE_LOG2; m++) {
+        SignalChain chain = SignalChain(header, correlationTemplate.data(), templateHeader, MAGNITUDE_MODE(m));
+        std::vector<goldenWindow> output;
+        chain.run(rawSamples, output);
+
+        double _maxError = 0.0, _sumError = 0.0, _maxCorrelationError = 0.0;
+        uint32_t _count = 0, _positives = 0, _flips = 0;
+        for (size_t w = 0; w < output.size() && w < golden.size(); w++) {
+            for (int f = 0; f < GOLDEN_NUM_BINS; f++) {
+                if (golden[w].magnitudes[f] <= 1.0) continue;
+                double _error = fabs(modeToMagnitude(output[w].magnitudes[f], MAGNITUDE_MODE(m)) - golden[w].magnitudes[f]) / golden[w].magnitudes[f];
+                if (_error > _maxError) _maxError = _error;
+                _sumError += _error;
+                _count += 1;
+            }
+
+            bool _positive = output[w].correlation >= GOLDEN_CORRELATION_THRESHOLD;
+            if (_positive) _positives += 1;
+            if (_positive != (golden[w].correlation >= GOLDEN_CORRELATION_THRESHOLD)) _flips += 1;
+            _maxCorrelationError = fmax(_maxCorrelationError, fabs(output[w].correlation - golden[w].correlation));
+        }
+
+        printf("  %-20s magnitude error max %8.5f mean %8.5f, correlation error max %6.3f, %4d positive correlations, %4d decisions differ\n",
+            magnitudeModeNames[m], _maxError, _count > 0 ? _sumError / _count : 0.0, _maxCorrelationError, int(_positives), int(_flips));
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || (strcmp(argv[1], "generate") != 0 && strcmp(argv[1], "check") != 0 && strcmp(argv[1], "modes") != 0)) {
+        printf("usage: ./GoldenVectors check|generate|modes [directory]\n");
+        return 1;
+    }
+
+    bool generate = strcmp(argv[1], "generate") == 0;
+    bool modes = strcmp(argv[1], "modes") == 0;
+    std::string directory = argc > 2 ? argv[2] : "GoldenVectors";
+
+    std::vector<uint16_t> correlationTemplate;
+    templateFileHeader templateHeader;
+    if (!loadTemplate(correlationTemplate, templateHeader)) {
+        printf("Could not read %s\n", templateFilename);
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < sizeof(recordings) / sizeof(recordings[0]); i++) {
+        names.push_back(std::string(recordings[i]).substr(0, std::string(recordings[i]).rfind('.')));
+    }
+    names.push_back("synthetic");
+
+    bool passed = true;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string filename = directory + "/" + names[i] + ".GV";
+
+        if (modes) {
+            passed = compareMagnitudeModes(filename, correlationTemplate, templateHeader) && passed;
+            continue;
+        }
+        if (!generate) {
+            passed = checkGoldenFile(filename, correlationTemplate, templateHeader) && passed;
+            continue;
+        }
+
+        std::vector<uint16_t> rawSamples;
+        if (i < sizeof(recordings) / sizeof(recordings[0])) {
+            std::vector<int16_t> recording;
+            uint32_t sampleRate = 0;
+            if (!readWave(recordings[i], recording, sampleRate) || sampleRate != GOLDEN_RAW_SAMPLE_RATE) {
+                printf("Could not read %s, make sure it is a 16-bit PCM mono wave file sampled at %d Hz\n", recordings[i], GOLDEN_RAW_SAMPLE_RATE);
+                return 1;
+            }
+            recordingToAdcSamples(recording, rawSamples);
+        } else generateSynthetic(rawSamples);
+
+        goldenFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = GOLDEN_FILE_MAGIC;
+        header.version = GOLDEN_FILE_VERSION;
+        header.headerSize = sizeof(header);
+        header.numRawSamples = rawSamples.size();
+        header.windowSize = GOLDEN_WINDOW_SIZE;
+        header.noiseRemovalSize = GOLDEN_NOISE_SIZE;
+        header.noiseRemovalThreshold = GOLDEN_NOISE_THRESHOLD;
+        header.timeSmoothing = GOLDEN_TIME_SMOOTHING;
+        header.freqSmoothing = GOLDEN_FREQ_SMOOTHING;
+        header.templateChecksum = templateHeader.checksum;
+
+        SignalChain chain = SignalChain(header, correlationTemplate.data(), templateHeader);
+        std::vector<goldenWindow> windows;
+        chain.run(rawSamples, windows);
+        header.numWindows = windows.size();
+
+        if (!writeGoldenFile(filename, header, rawSamples, windows)) {
+            printf("Could not write %s\n", filename.c_str());
+            return 1;
+        }
+        printf("%s: %d windows\n", filename.c_str(), int(windows.size()));
+    }
+
+    if (!generate && !modes) printf(passed ? "golden vectors passed\n" : "golden vectors FAILED\n");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#ifndef HOST_SHIM_ARDUINO_h
+#define HOST_SHIM_ARDUINO_h
+
+// Minimal stand-in for Arduino.h used for compiling the hardware independent parts of the PiedPiper library (DataProcessing, Fast4ier)
+// on a host machine, i.e. for the kernel benchmarks and golden vector conformance suite in Utilities. Only the parts of the Arduino API
+// used by those sources are provided, add to it rather than including hardware dependent headers in host utilities.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEC 10
+
+// Arduino defines min(), max() and sq() as macros, templates are used here so standard library headers can still be included
+template <typename T, typename U> auto min(const T &a, const U &b) -> decltype(b < a ? b : a) { return b < a ? b : a; }
+template <typename T, typename U> auto max(const T &a, const U &b) -> decltype(b < a ? b : a) { return a < b ? b : a; }
+template <typename T> T sq(const T &x) { return x * x; }
+
+/**
+ * printf based replacement for Arduino's Print class (Serial, File), prints to a C file (stdout by default)
+ */
+class Print
+{
+    private:
+        FILE *file;     ///< file printed to
+
+    public:
+        /**
+         * constructor for Print
+         * @param file open file to print to
+         */
+        Print(FILE *file = stdout) { this->file = file; };
+
+        int printf(const char *format, ...) {
+            va_list _args;
+            va_start(_args, format);
+            int _n = vfprintf(this->file, format, _args);
+            va_end(_args);
+            return _n;
+        }
+};
+
+#endif
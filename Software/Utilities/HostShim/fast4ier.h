@@ -0,0 +1,2 @@
+// Fast4ier.cpp includes its own header in lower case, which only resolves on case insensitive file systems
+#include <Fast4ier.h>
@@ -0,0 +1,94 @@
+// This is a C++ program used for benchmarking the DataProcessing kernels of the detection loop (FFT, DC removal, magnitudes, noise removal,
+// smoothing, circular buffers, quantization and cross correlation) on a host machine. The benchmarks themselves are in
+// PiedPiperBenchmark/KernelBenchmarks.h, the PiedPiperBenchmark sketch runs the same benchmarks on the trap and reports CPU cycles instead
+// of nanoseconds.
+
+// #################################################### IMPORTANT #####################################################
+
+// Host timings are only comparable with host timings of the same machine and compiler flags, use the sketch for on target numbers.
+// Recordings are resampled to 2048 Hz (FFT_SAMPLE_RATE) by averaging pairs of samples, which is good enough for timing (kernel run times
+// barely depend on input values), but not for checking outputs of kernels (see GoldenVectors.cpp for that).
+
+// #################################################### TO USE THIS UTILITY: #####################################################
+
+// 1. Compile the program (from the Utilities directory):
+//    g++ -O2 -IHostShim -I../Dependencies/Fast4ier -I../Dependencies/PiedPiper/src -I../PiedPiperBenchmark -o KernelBenchmark KernelBenchmark.cpp
+//        ../Dependencies/Fast4ier/Fast4ier.cpp ../Dependencies/Fast4ier/complex.cpp ../Dependencies/PiedPiper/src/DataProcessing/*.cpp
+// 2. Run the program: ./KernelBenchmark "output.csv" [label] [recordings.wav ...]
+//    (label defaults to "host", use i.e. the commit hash; BMSB.wav, BMSB_CAL.wav and trial26_resampled*.wav are used if no recordings are given)
+// 3. Compare two result files: python3 CompareBenchmarks.py "before.csv" "after.csv"
+
+#include <cstdio>
+#include <vector>
+
+#include "KernelBenchmarks.h"
+#include "WaveFile.h"
+
+#define BENCHMARK_SAMPLE_RATE 2048  // sample rate kernels run at on the trap (FFT_SAMPLE_RATE)
+#define BENCHMARK_TONES_LENGTH 4096 // number of generated samples, same as PiedPiperBenchmark sketch
+
+const uint16_t windowSizes[] = { 64, 128, 256 };
+const char *defaultRecordings[] = { "BMSB.wav", "BMSB_CAL.wav", "trial26_resampled1.wav", "trial26_resampled2.wav" };
+
+// converts 16-bit samples recorded at 4096 Hz to 12-bit ADC values at 2048 Hz
+void recordingToAdcSamples(const std::vector<int16_t> &recording, std::vector<uint16_t> &samples) {
+    samples.resize(recording.size() / 2);
+    for (size_t i = 0; i < samples.size(); i++) {
+        int32_t _value = ((int32_t(recording[2 * i]) + recording[2 * i + 1]) >> 5) + 2048;
+        samples[i] = _value < 0 ? 0 : (_value > 4095 ? 4095 : _value);
+    }
+}
+
+void runAllWindowSizes(Print &output, kernelBenchmarkBuffers &buffers, const char *label, const char *inputName, const std::vector<uint16_t> &input) {
+    for (size_t i = 0; i < sizeof(windowSizes) / sizeof(windowSizes[0]); i++) {
+        if (input.size() < windowSizes[i]) continue;
+        runKernelBenchmarks(output, buffers, label, inputName, input.data(), input.size(), BENCHMARK_SAMPLE_RATE, windowSizes[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: ./KernelBenchmark \"output.csv\" [label] [recordings.wav ...]\n");
+        return 1;
+    }
+
+    const char *label = argc > 2 ? argv[2] : "host";
+
+    FILE *outFile = fopen(argv[1], "w");
+    if (outFile == NULL) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    Print output = Print(outFile);
+    static kernelBenchmarkBuffers buffers;
+
+    printKernelBenchmarkHeader(output);
+
+    std::vector<uint16_t> input(BENCHMARK_TONES_LENGTH);
+    generateBenchmarkTones(input.data(), input.size(), BENCHMARK_SAMPLE_RATE);
+    runAllWindowSizes(output, buffers, label, "tones", input);
+
+    std::vector<const char *> recordings;
+    for (int i = 3; i < argc; i++) recordings.push_back(argv[i]);
+    if (recordings.empty()) recordings.assign(defaultRecordings, defaultRecordings + sizeof(defaultRecordings) / sizeof(defaultRecordings[0]));
+
+    for (size_t i = 0; i < recordings.size(); i++) {
+        std::vector<int16_t> recording;
+        uint32_t sampleRate = 0;
+        if (!readWave(recordings[i], recording, sampleRate)) {
+            printf("Could not read %s, skipping\n", recordings[i]);
+            continue;
+        }
+        if (sampleRate != 4096) printf("Warning: sample rate of %s is %u Hz, recordings are expected at 4096 Hz\n", recordings[i], sampleRate);
+
+        recordingToAdcSamples(recording, input);
+        runAllWindowSizes(output, buffers, label, recordings[i], input);
+    }
+
+    fclose(outFile);
+
+    printf("results written to %s\n", argv[1]);
+
+    return 0;
+}
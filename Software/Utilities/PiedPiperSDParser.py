@@ -109,6 +109,8 @@ if __name__ == "__main__":
                 _time = time.parts[-1]
                 _sampleRate = None
                 _windowSize = None
+                _firstRow = 0
+                _numRows = None
                 
                 # open and process detection details
                 if details.exists():
@@ -119,6 +121,13 @@ if __name__ == "__main__":
 
                     _sampleRate = int(_details2[0])
                     _windowSize = int(_details2[1])
+                    _numRows = _windowSize >> 1
+
+                    # first bin and number of bins stored per window in PFD.TXT (only the correlation band if band_only is set), missing
+                    # in DETS.TXT of older firmware which always stored all bins
+                    if len(_details2) > 7:
+                        _firstRow = int(_details2[6])
+                        _numRows = int(_details2[7])
                 
                 # open and process raw samples data 
                 if rawSamples.exists():
@@ -133,7 +142,14 @@ if __name__ == "__main__":
                     file = open(processedFreqs)
                     processedFreqs = list(map(int, file.readlines()))
                     file.close()
-                    processedFreqs = np.split(np.array(processedFreqs), int(len(processedFreqs) / (_windowSize >> 1)), axis=0)
+                    processedFreqs = np.split(np.array(processedFreqs), int(len(processedFreqs) / _numRows), axis=0)
+                    # bins outside of stored band are padded with zeros, so frequency axis matches the full spectrum
+                    _padded = []
+                    for column in processedFreqs:
+                        _column = np.zeros(_windowSize >> 1, dtype=column.dtype)
+                        _column[_firstRow:_firstRow + _numRows] = column
+                        _padded.append(_column)
+                    processedFreqs = _padded
                     _title = _details1[0] + "    Noise Removal: (" + _details2[2] + "/" + _details2[3] + ")    Time/Freq Smoothing: " + "(" + _details2[4] + "/" + _details2[5] + ")\nConfidence: " + _details1[1] + "    Temp/Humidity: "
                     sp.printSpecgram(processedFreqs, _sampleRate, _windowSize, title=_title, show=False, save=True, fname=outFile.joinpath(_time + "_" + "PROCESSED.png"))
 
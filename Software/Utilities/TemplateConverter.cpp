@@ -0,0 +1,114 @@
+// This is a C++ program used for converting correlation templates (TEMPS/*.txt) to the binary template format loaded by the Pied Piper traps.
+// Text templates store one magnitude per line (FFT_WINDOW_SIZE / 2 magnitudes per window, window after window). On every boot the trap
+// would otherwise parse each value as a String, scale it by FREQ_WIDTH and compute the square root of the sum squared of the template.
+// The binary template stores the already scaled values along with a header holding the template configuration and the precomputed
+// square root of the sum squared, so the trap can load it with a single block read.
+
+// #################################################### IMPORTANT #####################################################
+
+// The sample rate, window size and frequency range passed to this program must match the ones used by the trap (FFT_SAMPLE_RATE,
+// FFT_WINDOW_SIZE, and the frequency range passed to loadTemplate() in PiedPiper.ino), otherwise the trap will consider the binary
+// template stale and fall back to the text template. The trap also compares the hash of the text template stored on the SD card with
+// the hash recorded in the binary template, so always copy both files to the SD card together.
+// Note: the trap generates the binary template itself the first time it loads a text template, using this program is only needed for
+// preparing SD cards ahead of time.
+
+// #################################################### TO USE THIS UTILITY: #####################################################
+
+// 0. Make sure you read the text immediately above this procedure.
+// 1. Compile the program: g++ -O2 -o TemplateConverter TemplateConverter.cpp
+// 2. Run the program: ./TemplateConverter "path_to_template.txt" "path_to_output.BIN" [frequencyLow frequencyHigh sampleRate windowSize]
+//    (defaults are 50 110 2048 128)
+// 3. Copy the output file to the TEMPS directory of the SD card, next to the text template (i.e. TEMPS/BMSB.txt and TEMPS/BMSB.BIN)
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../Dependencies/PiedPiper/src/Other/TemplateFile.h"
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: ./TemplateConverter \"path_to_template.txt\" \"path_to_output.BIN\" [frequencyLow frequencyHigh sampleRate windowSize]\n");
+        return 1;
+    }
+
+    uint16_t frequencyRangeLow = argc > 3 ? atoi(argv[3]) : 50;
+    uint16_t frequencyRangeHigh = argc > 4 ? atoi(argv[4]) : 110;
+    uint16_t sampleRate = argc > 5 ? atoi(argv[5]) : 2048;
+    uint16_t windowSize = argc > 6 ? atoi(argv[6]) : 128;
+
+    uint16_t numRows = windowSize >> 1;
+    float frequencyWidth = float(windowSize) / sampleRate;
+
+    FILE *inFile = fopen(argv[1], "rb");
+    if (inFile == NULL) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    // hash of the text template is stored in the header so the trap can detect a stale binary template
+    uint8_t chunk[512];
+    size_t bytesRead;
+    uint32_t sourceHash = fnv1aHash(NULL, 0);
+    while ((bytesRead = fread(chunk, 1, sizeof(chunk), inFile)) > 0) {
+        sourceHash = fnv1aHash(chunk, bytesRead, sourceHash);
+    }
+    fseek(inFile, 0, SEEK_SET);
+
+    // values are rounded when loaded, then rounded again after scaling, same as loading a text template on the trap
+    std::vector<uint16_t> values;
+    float sample;
+    while (fscanf(inFile, "%f", &sample) == 1) {
+        values.push_back(uint16_t(round(uint16_t(round(sample)) * frequencyWidth)));
+    }
+    fclose(inFile);
+
+    if (values.size() == 0 || values.size() % numRows != 0) {
+        printf("Template contains %zu values, which is not a multiple of %d\n", values.size(), numRows);
+        return 1;
+    }
+
+    uint16_t numCols = values.size() / numRows;
+
+    // computing square root of the squared sum of the template spectrogram within frequency range, see CrossCorrelation::computeTemplate()
+    uint16_t frequencyIndexLow = floor(frequencyRangeLow * frequencyWidth);
+    uint16_t frequencyIndexHigh = ceil(frequencyRangeHigh * frequencyWidth);
+
+    uint32_t sumSq = 0;
+    for (uint16_t t = 0; t < numCols; t++) {
+        for (uint16_t f = frequencyIndexLow; f < frequencyIndexHigh; f++) {
+            uint16_t templateValue = values[f + t * numRows];
+            sumSq += templateValue * templateValue;
+        }
+    }
+
+    templateFileHeader header;
+    header.magic = TEMPLATE_FILE_MAGIC;
+    header.version = TEMPLATE_FILE_VERSION;
+    header.headerSize = sizeof(header);
+    header.sampleRate = sampleRate;
+    header.windowSize = windowSize;
+    header.numRows = numRows;
+    header.numCols = numCols;
+    header.frequencyRangeLow = frequencyRangeLow;
+    header.frequencyRangeHigh = frequencyRangeHigh;
+    header.sourceHash = sourceHash;
+    header.templateSqrtSumSq = sqrtl(sumSq);
+    header.checksum = fnv1aHash(values.data(), values.size() * sizeof(uint16_t));
+
+    // trap (SAMD51) is little-endian, values are written as is
+    FILE *outFile = fopen(argv[2], "wb");
+    if (outFile == NULL) {
+        printf("Could not open %s\n", argv[2]);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, outFile);
+    fwrite(values.data(), sizeof(uint16_t), values.size(), outFile);
+    fclose(outFile);
+
+    printf("%d windows x %d bins, sqrt sum squared: %u\n", numCols, numRows, header.templateSqrtSumSq);
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef WAVE_FILE_h
+#define WAVE_FILE_h
+
+// Wave file reading shared by the host utilities (i.e. AudioFileConverter, KernelBenchmark, GoldenVectors)
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// reads samples of a 16-bit PCM mono wave file, returns false if file can't be read or has an unsupported format
+inline bool readWave(const char *filename, std::vector<int16_t> &samples, uint32_t &sampleRate) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return false;
+
+    char chunkId[4];
+    uint32_t chunkSize;
+    char format[4];
+
+    if (fread(chunkId, 1, 4, file) != 4 || memcmp(chunkId, "RIFF", 4) != 0 ||
+        fread(&chunkSize, 4, 1, file) != 1 ||
+        fread(format, 1, 4, file) != 4 || memcmp(format, "WAVE", 4) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    uint16_t audioFormat = 0, numChannels = 0, bitsPerSample = 0;
+    bool foundData = false;
+
+    // walking through chunks until data chunk is found
+    while (!foundData && fread(chunkId, 1, 4, file) == 4 && fread(&chunkSize, 4, 1, file) == 1) {
+        if (memcmp(chunkId, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (chunkSize < 16 || fread(fmt, 1, 16, file) != 16) break;
+            memcpy(&audioFormat, fmt, 2);
+            memcpy(&numChannels, fmt + 2, 2);
+            memcpy(&sampleRate, fmt + 4, 4);
+            memcpy(&bitsPerSample, fmt + 14, 2);
+            fseek(file, chunkSize - 16 + (chunkSize & 1), SEEK_CUR);
+        } else if (memcmp(chunkId, "data", 4) == 0) {
+            if (audioFormat != 1 || numChannels != 1 || bitsPerSample != 16) break;
+            samples.resize(chunkSize / 2);
+            foundData = fread(samples.data(), 2, samples.size(), file) == samples.size();
+        } else {
+            fseek(file, chunkSize + (chunkSize & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(file);
+    return foundData;
+}
+
+#endif